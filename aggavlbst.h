@@ -0,0 +1,481 @@
+#ifndef AGGAVLBST_H
+#define AGGAVLBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <limits>
+#include "avlbst.h"
+
+/**
+* Aggregate policies for AggregateAVLTree. A policy is a monoid over Value:
+* an identity element and an associative combine. combine is always applied
+* in key order, so it does not need to be commutative.
+*/
+template <typename Value>
+struct SumAggregate
+{
+    static Value identity() { return Value(); }
+    static Value combine(const Value& a, const Value& b) { return a + b; }
+};
+
+template <typename Value>
+struct MinAggregate
+{
+    static Value identity() { return std::numeric_limits<Value>::max(); }
+    static Value combine(const Value& a, const Value& b) { return (b < a) ? b : a; }
+};
+
+template <typename Value>
+struct MaxAggregate
+{
+    static Value identity() { return std::numeric_limits<Value>::lowest(); }
+    static Value combine(const Value& a, const Value& b) { return (a < b) ? b : a; }
+};
+
+/**
+* An AVLNode that also stores the aggregate of all values in its subtree.
+*/
+template <typename Key, typename Value>
+class AggregateNode : public AVLNode<Key, Value>
+{
+public:
+    // Constructor/destructor.
+    AggregateNode(const Key& key, const Value& value, AggregateNode<Key, Value>* parent);
+    virtual ~AggregateNode();
+
+    // Getter/setter for the subtree aggregate.
+    const Value& getAggregate() const;
+    void setAggregate(const Value& aggregate);
+
+    // Getters for parent, left, and right, returning AggregateNodes.
+    virtual AggregateNode<Key, Value>* getParent() const override;
+    virtual AggregateNode<Key, Value>* getLeft() const override;
+    virtual AggregateNode<Key, Value>* getRight() const override;
+
+protected:
+    Value aggregate_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the AggregateNode class.
+  -------------------------------------------------
+*/
+
+/**
+* A new node is a leaf, so its aggregate is just its own value.
+*/
+template<class Key, class Value>
+AggregateNode<Key, Value>::AggregateNode(const Key& key, const Value& value, AggregateNode<Key, Value> *parent) :
+    AVLNode<Key, Value>(key, value, parent), aggregate_(value)
+{
+
+}
+
+/**
+* A destructor which does nothing.
+*/
+template<class Key, class Value>
+AggregateNode<Key, Value>::~AggregateNode()
+{
+
+}
+
+/**
+* A getter for the aggregate of the subtree rooted at this node.
+*/
+template<class Key, class Value>
+const Value& AggregateNode<Key, Value>::getAggregate() const
+{
+    return aggregate_;
+}
+
+/**
+* A setter for the aggregate of the subtree rooted at this node.
+*/
+template<class Key, class Value>
+void AggregateNode<Key, Value>::setAggregate(const Value& aggregate)
+{
+    aggregate_ = aggregate;
+}
+
+/**
+* An overridden function for getting the parent since a static_cast is necessary to make sure
+* that our node is a AggregateNode.
+*/
+template<class Key, class Value>
+AggregateNode<Key, Value> *AggregateNode<Key, Value>::getParent() const
+{
+    return static_cast<AggregateNode<Key, Value>*>(this->parent_);
+}
+
+/**
+* Overridden for the same reasons as above.
+*/
+template<class Key, class Value>
+AggregateNode<Key, Value> *AggregateNode<Key, Value>::getLeft() const
+{
+    return static_cast<AggregateNode<Key, Value>*>(this->left_);
+}
+
+/**
+* Overridden for the same reasons as above.
+*/
+template<class Key, class Value>
+AggregateNode<Key, Value> *AggregateNode<Key, Value>::getRight() const
+{
+    return static_cast<AggregateNode<Key, Value>*>(this->right_);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the AggregateNode class.
+  -----------------------------------------------
+*/
+
+
+/**
+* An AVLTree that keeps a monoid aggregate (see SumAggregate etc.) of the
+* values in every subtree, maintained through rotations, inserts, removes
+* and setValue. rangeAggregate(lo, hi) then combines the values of all keys
+* in [lo, hi] in O(log n) rather than visiting each of them.
+*
+* Values must be changed through insert or setValue. Everything that would
+* hand out a writable value is hidden: begin, end, find and lowerBound return
+* a const_iterator, parallelForEach and parallelReduce pass items as const,
+* and the non-const operator[] and finger() are not available. Writing
+* through a reference to the AVLTree base still bypasses the aggregates, so
+* use such references only for structural operations like splitAt and concat.
+*/
+template <class Key, class Value, class Aggregate = SumAggregate<Value> >
+class AggregateAVLTree : public AVLTree<Key, Value>
+{
+public:
+    explicit AggregateAVLTree(std::pmr::memory_resource* resource = NULL);
+    void setValue(const Key& key, const Value& value);
+    Value const & operator[](const Key& key) const;
+    Value rangeAggregate(const Key& lo, const Key& hi) const;
+
+    /**
+    * An iterator over the items that only gives read access to them.
+    */
+    class const_iterator
+    {
+    public:
+        const_iterator();
+
+        const std::pair<const Key, Value>& operator*() const;
+        const std::pair<const Key, Value>* operator->() const;
+
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
+
+        const_iterator& operator++();
+
+    protected:
+        friend class AggregateAVLTree<Key, Value, Aggregate>;
+        const_iterator(const typename BinarySearchTree<Key, Value>::iterator& it);
+        typename BinarySearchTree<Key, Value>::iterator it_;
+    };
+
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator find(const Key& key) const;
+    const_iterator lowerBound(const Key& key) const;
+    const_iterator erase(const_iterator pos);
+    const_iterator erase(const_iterator first, const_iterator last);
+
+    template<typename F>
+    void parallelForEach(F fn, size_t grain = 4096,
+        WorkStealingPool& pool = WorkStealingPool::shared()) const;
+    template<typename T, typename Map, typename Combine>
+    T parallelReduce(T init, Map map, Combine combine, size_t grain = 4096,
+        WorkStealingPool& pool = WorkStealingPool::shared()) const;
+private:
+    using BinarySearchTree<Key, Value>::finger;
+protected:
+    virtual AVLNode<Key, Value>* createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent) override;
+    virtual size_t nodeBytes() const override;
+    virtual AVLNode<Key, Value>* constructNode(void* where, const Key& key, const Value& value,
+        AVLNode<Key, Value>* parent) override;
+    virtual void updateNode(AVLNode<Key, Value>* node) override;
+    virtual void updatePath(AVLNode<Key, Value>* node) override;
+    static Value aggregateOf(AggregateNode<Key, Value>* node);
+    static Value ownValue(AggregateNode<Key, Value>* node);
+};
+
+template<class Key, class Value, class Aggregate>
+AggregateAVLTree<Key, Value, Aggregate>::AggregateAVLTree(std::pmr::memory_resource* resource) :
+    AVLTree<Key, Value>(resource)
+{
+
+}
+
+/**
+ * @precondition The key exists in the map
+ * Replaces the value associated with the key and refreshes the aggregates above it
+ */
+template<class Key, class Value, class Aggregate>
+void AggregateAVLTree<Key, Value, Aggregate>::setValue(const Key& key, const Value& value)
+{
+    AVLNode<Key, Value>* node = static_cast<AVLNode<Key, Value>*>(this->internalFind(key));
+    if(node == NULL) throw std::out_of_range("Invalid key");
+    node->setValue(value);
+    updatePath(node);
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value, class Aggregate>
+Value const & AggregateAVLTree<Key, Value, Aggregate>::operator[](const Key& key) const
+{
+    return BinarySearchTree<Key, Value>::operator[](key);
+}
+
+/*
+  ---------------------------------------------------------------
+  Begin implementations for the AggregateAVLTree::const_iterator class.
+  ---------------------------------------------------------------
+*/
+
+template<class Key, class Value, class Aggregate>
+AggregateAVLTree<Key, Value, Aggregate>::const_iterator::const_iterator()
+{
+
+}
+
+template<class Key, class Value, class Aggregate>
+AggregateAVLTree<Key, Value, Aggregate>::const_iterator::const_iterator(
+    const typename BinarySearchTree<Key, Value>::iterator& it) :
+    it_(it)
+{
+
+}
+
+template<class Key, class Value, class Aggregate>
+const std::pair<const Key, Value>&
+AggregateAVLTree<Key, Value, Aggregate>::const_iterator::operator*() const
+{
+    return *it_;
+}
+
+template<class Key, class Value, class Aggregate>
+const std::pair<const Key, Value>*
+AggregateAVLTree<Key, Value, Aggregate>::const_iterator::operator->() const
+{
+    return it_.operator->();
+}
+
+template<class Key, class Value, class Aggregate>
+bool AggregateAVLTree<Key, Value, Aggregate>::const_iterator::operator==(const const_iterator& rhs) const
+{
+    return it_ == rhs.it_;
+}
+
+template<class Key, class Value, class Aggregate>
+bool AggregateAVLTree<Key, Value, Aggregate>::const_iterator::operator!=(const const_iterator& rhs) const
+{
+    return it_ != rhs.it_;
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::const_iterator&
+AggregateAVLTree<Key, Value, Aggregate>::const_iterator::operator++()
+{
+    ++it_;
+    return *this;
+}
+
+/*
+  -------------------------------------------------------------
+  End implementations for the AggregateAVLTree::const_iterator class.
+  -------------------------------------------------------------
+*/
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::const_iterator
+AggregateAVLTree<Key, Value, Aggregate>::begin() const
+{
+    return const_iterator(BinarySearchTree<Key, Value>::begin());
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::const_iterator
+AggregateAVLTree<Key, Value, Aggregate>::end() const
+{
+    return const_iterator(BinarySearchTree<Key, Value>::end());
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::const_iterator
+AggregateAVLTree<Key, Value, Aggregate>::find(const Key& key) const
+{
+    return const_iterator(BinarySearchTree<Key, Value>::find(key));
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::const_iterator
+AggregateAVLTree<Key, Value, Aggregate>::lowerBound(const Key& key) const
+{
+    return const_iterator(BinarySearchTree<Key, Value>::lowerBound(key));
+}
+
+/**
+* Erasing goes through removeNode, which already keeps the aggregates.
+*/
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::const_iterator
+AggregateAVLTree<Key, Value, Aggregate>::erase(const_iterator pos)
+{
+    return const_iterator(BinarySearchTree<Key, Value>::erase(pos.it_));
+}
+
+template<class Key, class Value, class Aggregate>
+typename AggregateAVLTree<Key, Value, Aggregate>::const_iterator
+AggregateAVLTree<Key, Value, Aggregate>::erase(const_iterator first, const_iterator last)
+{
+    return const_iterator(BinarySearchTree<Key, Value>::erase(first.it_, last.it_));
+}
+
+/**
+* As BinarySearchTree::parallelForEach, but fn only sees const items.
+*/
+template<class Key, class Value, class Aggregate>
+template<typename F>
+void AggregateAVLTree<Key, Value, Aggregate>::parallelForEach(F fn, size_t grain, WorkStealingPool& pool) const
+{
+    auto visit = [&fn](const std::pair<const Key, Value>& item) { fn(item); };
+    BinarySearchTree<Key, Value>::parallelForEach(visit, grain, pool);
+}
+
+/**
+* As BinarySearchTree::parallelReduce, but map only sees const items.
+*/
+template<class Key, class Value, class Aggregate>
+template<typename T, typename Map, typename Combine>
+T AggregateAVLTree<Key, Value, Aggregate>::parallelReduce(T init, Map map, Combine combine, size_t grain,
+    WorkStealingPool& pool) const
+{
+    auto read = [&map](const std::pair<const Key, Value>& item) { return map(item); };
+    return BinarySearchTree<Key, Value>::parallelReduce(init, read, combine, grain, pool);
+}
+
+/**
+* Combines the values of every key in [lo, hi], in key order. Finds the
+* highest node inside the range, then walks each boundary path below it,
+* taking whole-subtree aggregates for the parts known to be inside.
+*/
+template<class Key, class Value, class Aggregate>
+Value AggregateAVLTree<Key, Value, Aggregate>::rangeAggregate(const Key& lo, const Key& hi) const
+{
+    AggregateNode<Key, Value>* split = static_cast<AggregateNode<Key, Value>*>(this->root_);
+    while(split != NULL && (split->getKey() < lo || hi < split->getKey())) {
+        if(split->getKey() < lo) {
+            split = split->getRight();
+        }
+        else {
+            split = split->getLeft();
+        }
+    }
+    if(split == NULL) {
+        return Aggregate::identity();
+    }
+
+    //left boundary: everything at or right of a node >= lo is in range
+    Value left = Aggregate::identity();
+    AggregateNode<Key, Value>* temp = split->getLeft();
+    while(temp != NULL) {
+        if(temp->getKey() < lo) {
+            temp = temp->getRight();
+        }
+        else {
+            left = Aggregate::combine(Aggregate::combine(ownValue(temp), aggregateOf(temp->getRight())), left);
+            temp = temp->getLeft();
+        }
+    }
+
+    //right boundary: everything at or left of a node <= hi is in range
+    Value right = Aggregate::identity();
+    temp = split->getRight();
+    while(temp != NULL) {
+        if(hi < temp->getKey()) {
+            temp = temp->getLeft();
+        }
+        else {
+            right = Aggregate::combine(right, Aggregate::combine(aggregateOf(temp->getLeft()), ownValue(temp)));
+            temp = temp->getRight();
+        }
+    }
+
+    return Aggregate::combine(Aggregate::combine(left, ownValue(split)), right);
+}
+
+template<class Key, class Value, class Aggregate>
+AVLNode<Key, Value>* AggregateAVLTree<Key, Value, Aggregate>::createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent)
+{
+    return new (this->allocateNode(sizeof(AggregateNode<Key, Value>)))
+        AggregateNode<Key, Value>(key, value, static_cast<AggregateNode<Key, Value>*>(parent));
+}
+
+template<class Key, class Value, class Aggregate>
+size_t AggregateAVLTree<Key, Value, Aggregate>::nodeBytes() const
+{
+    return sizeof(AggregateNode<Key, Value>);
+}
+
+template<class Key, class Value, class Aggregate>
+AVLNode<Key, Value>* AggregateAVLTree<Key, Value, Aggregate>::constructNode(void* where, const Key& key,
+    const Value& value, AVLNode<Key, Value>* parent)
+{
+    return new (where) AggregateNode<Key, Value>(key, value, static_cast<AggregateNode<Key, Value>*>(parent));
+}
+
+/**
+* A node's aggregate is left aggregate, own value, right aggregate, combined in order.
+*/
+template<class Key, class Value, class Aggregate>
+void AggregateAVLTree<Key, Value, Aggregate>::updateNode(AVLNode<Key, Value>* node)
+{
+    AggregateNode<Key, Value>* n = static_cast<AggregateNode<Key, Value>*>(node);
+    n->setAggregate(Aggregate::combine(Aggregate::combine(aggregateOf(n->getLeft()), ownValue(n)),
+        aggregateOf(n->getRight())));
+}
+
+template<class Key, class Value, class Aggregate>
+void AggregateAVLTree<Key, Value, Aggregate>::updatePath(AVLNode<Key, Value>* node)
+{
+    while(node != NULL) {
+        updateNode(node);
+        node = node->getParent();
+    }
+}
+
+/**
+* The aggregate of a possibly empty subtree.
+*/
+template<class Key, class Value, class Aggregate>
+Value AggregateAVLTree<Key, Value, Aggregate>::aggregateOf(AggregateNode<Key, Value>* node)
+{
+    if(node == NULL) {
+        return Aggregate::identity();
+    }
+    return node->getAggregate();
+}
+
+/**
+* A node's own contribution, which is nothing once it is a tombstone.
+*/
+template<class Key, class Value, class Aggregate>
+Value AggregateAVLTree<Key, Value, Aggregate>::ownValue(AggregateNode<Key, Value>* node)
+{
+    if(node->isDeleted()) {
+        return Aggregate::identity();
+    }
+    return node->getValue();
+}
+
+
+#endif
@@ -1,10 +1,17 @@
-#ifndef RBBST_H
-#define RBBST_H
+#ifndef AVLBST_H
+#define AVLBST_H
 
 #include <iostream>
 #include <exception>
 #include <cstdlib>
 #include <algorithm>
+#include <atomic>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <typeinfo>
+#include <vector>
+#include "bloomfilter.h"
 #include "bst.h"
 
 struct KeyError { };
@@ -27,6 +34,10 @@ public:
     void setBalance (int8_t balance);
     void updateBalance(int8_t diff);
 
+    // Getter/setter for the tombstone flag.
+    virtual bool isDeleted() const override;
+    void setDeleted(bool deleted);
+
     // Getters for parent, left, and right. These need to be redefined since they
     // return pointers to AVLNodes - not plain Nodes. See the Node class in bst.h
     // for more information.
@@ -36,6 +47,7 @@ public:
 
 protected:
     int8_t balance_;
+    bool deleted_;
 };
 
 /*
@@ -50,7 +62,7 @@ protected:
 */
 template<class Key, class Value>
 AVLNode<Key, Value>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Value> *parent) :
-    Node<Key, Value>(key, value, parent), balance_(0)
+    Node<Key, Value>(key, value, parent), balance_(0), deleted_(false)
 {
 
 }
@@ -91,6 +103,24 @@ void AVLNode<Key, Value>::updateBalance(int8_t diff)
     balance_ += diff;
 }
 
+/**
+* True if the node was removed lazily and only stays in place as a tombstone.
+*/
+template<class Key, class Value>
+bool AVLNode<Key, Value>::isDeleted() const
+{
+    return deleted_;
+}
+
+/**
+* A setter for the tombstone flag.
+*/
+template<class Key, class Value>
+void AVLNode<Key, Value>::setDeleted(bool deleted)
+{
+    deleted_ = deleted;
+}
+
 /**
 * An overridden function for getting the parent since a static_cast is necessary to make sure
 * that our node is a AVLNode.
@@ -127,15 +157,121 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
 */
 
 
+/**
+* An AVL tree. By default remove unlinks the node and rebalances on the
+* spot. With setTombstones(true) it instead only marks the node deleted,
+* in O(log n) and without rotations, and find, iteration, size() and
+* stats() all skip such tombstones. Inserting a key that is a tombstone
+* revives the node in place. Once tombstones make up more than
+* maxDeadRatio of the nodes, compact() rebuilds the tree from the live
+* nodes in one linear pass, so a burst of removes costs one rebuild
+* instead of a cascade of rotations per remove.
+*
+* With setFilter(true) the tree also keeps a blocked Bloom filter of its
+* keys, so most lookups of absent keys return without touching a node.
+*
+* extract unlinks an entry and hands over its node in a NodeHandle, and
+* insert links such a node into another tree of the same type, so an
+* entry can move between trees without being freed, reallocated or
+* copied. merge moves every entry of another tree this way.
+*/
 template <class Key, class Value>
 class AVLTree : public BinarySearchTree<Key, Value>
 {
 public:
+    explicit AVLTree(std::pmr::memory_resource* resource = NULL);
     virtual void insert (const std::pair<const Key, Value> &new_item);
-    virtual void remove(const Key& key);
+    virtual void clear() override;
+    virtual void release() override;
+    virtual int height() const override;
+    virtual size_t eraseRange(const Key& lo, const Key& hi) override;
+
+    template<typename InputIt>
+    void buildFrom(InputIt first, InputIt last, size_t threads = 0);
+    virtual size_t splitAt(const Key& key, AVLTree<Key, Value>& upper);
+    virtual void concat(AVLTree<Key, Value>& upper);
+
+    void setTombstones(bool enabled, double maxDeadRatio = 0.5);
+    virtual void compact();
+    size_t deadCount() const;
+    double deadRatio() const;
+
+    virtual void rebuildOptimal() override;
+
+    /**
+    * Owns a node taken out of a tree by extract, with its key and value,
+    * until it is inserted into a tree or the handle is destroyed. Only
+    * a tree of the same type that allocates from the same memory
+    * resource can take the node.
+    */
+    class NodeHandle
+    {
+    public:
+        NodeHandle();
+        NodeHandle(NodeHandle&& other);
+        NodeHandle& operator=(NodeHandle&& other);
+        NodeHandle(const NodeHandle& other) = delete;
+        NodeHandle& operator=(const NodeHandle& other) = delete;
+        ~NodeHandle();
+
+        bool empty() const;
+        explicit operator bool() const;
+        const Key& key() const;
+        Value& value() const;
+
+    protected:
+        friend class AVLTree<Key, Value>;
+        void reset();
+
+        AVLNode<Key, Value>* node_; //NULL for an empty handle
+        typename BinarySearchTree<Key, Value>::NodeBlock* block_; //the bulk-built block holding node_, or NULL
+        std::pmr::memory_resource* resource_;
+        size_t bytes_;
+        const std::type_info* tree_; //the type of the tree node_ came from
+    };
+    NodeHandle extract(const Key& key);
+    NodeHandle extract(typename BinarySearchTree<Key, Value>::iterator pos);
+    bool insert(NodeHandle&& node);
+    void merge(AVLTree<Key, Value>& other);
+
+    /**
+    * What the filter has done since it was attached. rejected lookups
+    * were answered by the filter alone. falsePositives passed it and then
+    * missed in the tree, so falsePositiveRate is their share of all
+    * lookups for absent keys.
+    */
+    struct FilterStats
+    {
+        size_t bytes;
+        size_t keys; //keys in the filter, stale ones included
+        size_t rejected;
+        size_t falsePositives;
+        double falsePositiveRate;
+    };
+    template<class Hash = std::hash<Key> >
+    void setFilter(bool enabled, double bitsPerKey = 10.0);
+    FilterStats filterStats() const;
 protected:
+    virtual Node<Key, Value>* internalFind(const Key& key) const override;
+    virtual void removeNode(Node<Key, Value>* n) override;
     virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
 
+    // Hooks for trees that keep extra per-node data (see aggavlbst.h).
+    // The defaults allocate a plain AVLNode and maintain nothing.
+    virtual AVLNode<Key, Value>* createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    virtual AVLNode<Key, Value>* adoptNode(AVLNode<Key, Value>* node);
+    virtual void updateNode(AVLNode<Key, Value>* node);
+    virtual void updatePath(AVLNode<Key, Value>* node);
+    virtual void nodeLinked(AVLNode<Key, Value>* node);
+
+    // Hooks for buildFrom, which places nodes in one block instead of
+    // calling createNode. Trees with their own node type override the
+    // first two; bulkLoaded runs once the whole tree is linked.
+    virtual size_t nodeBytes() const;
+    virtual AVLNode<Key, Value>* constructNode(void* where, const Key& key, const Value& value,
+        AVLNode<Key, Value>* parent);
+    virtual void bulkLoaded();
+
     // Add helper functions here
     void insertFix( AVLNode<Key, Value>* p, AVLNode<Key, Value>* n);
     void removeFix(AVLNode<Key, Value>* n, int8_t diff);
@@ -144,36 +280,191 @@ protected:
     bool zigzig( AVLNode<Key, Value>* g, AVLNode<Key, Value>* p, AVLNode<Key, Value>* n);
     bool zigzag( AVLNode<Key, Value>* g, AVLNode<Key, Value>* p, AVLNode<Key, Value>* n);
 
+    // Split/join on detached subtrees with known heights, used for bulk operations.
+    // Returned roots have an unspecified parent that the caller must set.
+    AVLNode<Key, Value>* join(AVLNode<Key, Value>* l, int hl, AVLNode<Key, Value>* k,
+        AVLNode<Key, Value>* r, int hr, int& h);
+    AVLNode<Key, Value>* join(AVLNode<Key, Value>* l, int hl, AVLNode<Key, Value>* r, int hr, int& h);
+    void split(AVLNode<Key, Value>* t, int ht, const Key& key, bool inclusive,
+        AVLNode<Key, Value>*& l, int& hl, AVLNode<Key, Value>*& r, int& hr);
+    AVLNode<Key, Value>* splitLast(AVLNode<Key, Value>* t, int ht, AVLNode<Key, Value>*& rest, int& hrest);
+    AVLNode<Key, Value>* link(AVLNode<Key, Value>* l, int hl, AVLNode<Key, Value>* k,
+        AVLNode<Key, Value>* r, int hr, int& h);
+    AVLNode<Key, Value>* rebalance(AVLNode<Key, Value>* n, int hl, int hr, int& h);
+    static void childHeights(AVLNode<Key, Value>* n, int h, int& hl, int& hr);
+    int fixBalances(AVLNode<Key, Value>* node);
+    AVLNode<Key, Value>* buildRange(const std::vector<std::pair<Key, Value> >& items, size_t lo, size_t hi,
+        AVLNode<Key, Value>* parent, char* block, size_t bytes, std::vector<char>& built,
+        WorkStealingPool& pool, int& height);
+    AVLNode<Key, Value>* place(const Key& key, const Value& value, AVLNode<Key, Value>* adopted);
+    NodeHandle extractNode(AVLNode<Key, Value>* node);
+    void revive(AVLNode<Key, Value>* node);
+    static size_t countDeleted(Node<Key, Value>* node);
+    bool filterRejects(const Key& key) const;
+    void filterChecked(Node<Key, Value>* found) const;
+    void filterAdd(const Key& key);
+    void filterRemoved();
+    void rebuildFilter();
+    template<class Hash>
+    static uint64_t filterHash(const Key& key);
+
+protected:
+    bool tombstones_;
+    double maxDeadRatio_;
+    size_t deadCount_; //tombstones still linked into the tree
+    AVLNode<Key, Value>* extracting_; //the node removeNode unlinks for extract, which keeps it
+
+    uint64_t (*filterHash_)(const Key& key); //NULL while there is no filter
+    BlockedBloomFilter filter_;
+    double bitsPerKey_;
+    size_t filterKeys_; //keys added since the last rebuild, removed ones included
+    size_t filterCapacity_; //keys the filter was sized for
+    mutable std::atomic<size_t> filterRejected_;
+    mutable std::atomic<size_t> filterFalsePositives_;
 };
 
+/*
+  -------------------------------------------------
+  Begin implementations for the AVLTree::NodeHandle class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value>
+AVLTree<Key, Value>::NodeHandle::NodeHandle() :
+    node_(NULL), block_(NULL), resource_(NULL), bytes_(0), tree_(NULL)
+{
+
+}
+
+template<class Key, class Value>
+AVLTree<Key, Value>::NodeHandle::NodeHandle(NodeHandle&& other) :
+    node_(other.node_), block_(other.block_), resource_(other.resource_), bytes_(other.bytes_),
+    tree_(other.tree_)
+{
+    other.node_ = NULL;
+}
+
+template<class Key, class Value>
+typename AVLTree<Key, Value>::NodeHandle& AVLTree<Key, Value>::NodeHandle::operator=(NodeHandle&& other)
+{
+    if(this != &other) {
+        reset();
+        node_ = other.node_;
+        block_ = other.block_;
+        resource_ = other.resource_;
+        bytes_ = other.bytes_;
+        tree_ = other.tree_;
+        other.node_ = NULL;
+    }
+    return *this;
+}
+
+/**
+* Destroys the entry if no tree took it.
+*/
+template<class Key, class Value>
+AVLTree<Key, Value>::NodeHandle::~NodeHandle()
+{
+    reset();
+}
+
+template<class Key, class Value>
+bool AVLTree<Key, Value>::NodeHandle::empty() const
+{
+    return node_ == NULL;
+}
+
+template<class Key, class Value>
+AVLTree<Key, Value>::NodeHandle::operator bool() const
+{
+    return node_ != NULL;
+}
+
+template<class Key, class Value>
+const Key& AVLTree<Key, Value>::NodeHandle::key() const
+{
+    if(node_ == NULL) throw std::invalid_argument("Empty node handle");
+    return node_->getKey();
+}
+
+template<class Key, class Value>
+Value& AVLTree<Key, Value>::NodeHandle::value() const
+{
+    if(node_ == NULL) throw std::invalid_argument("Empty node handle");
+    return node_->getValue();
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::NodeHandle::reset()
+{
+    if(node_ == NULL) {
+        return;
+    }
+    node_->~AVLNode();
+    BinarySearchTree<Key, Value>::freeNode(node_, block_, resource_, bytes_);
+    node_ = NULL;
+}
+
+/*
+  -------------------------------------------------
+  End implementations for the AVLTree::NodeHandle class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value>
+AVLTree<Key, Value>::AVLTree(std::pmr::memory_resource* resource) :
+    BinarySearchTree<Key, Value>(resource), tombstones_(false), maxDeadRatio_(0.5), deadCount_(0),
+    extracting_(NULL), filterHash_(NULL), bitsPerKey_(10.0), filterKeys_(0), filterCapacity_(0),
+    filterRejected_(0), filterFalsePositives_(0)
+{
+
+}
+
 /*
  * Recall: If key is already in the tree, you should 
  * overwrite the current value with the updated value.
  */
 template<class Key, class Value>
 void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+{
+    place(new_item.first, new_item.second, NULL);
+}
+
+/**
+* The body of both inserts. Links a new node for key, created from value
+* or, if adopted is not NULL, adopted itself, which holds key and value.
+* If key is already linked, tombstone or not, an insert of a pair
+* overwrites its value while an adopted node is left alone. Returns the
+* node holding key.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::place(const Key& key, const Value& value, AVLNode<Key, Value>* adopted)
 {
 
     //this->printRoot(this->root_); //used for debugging
 
-    Key key = new_item.first;
-    Value value = new_item.second;
     AVLNode<Key, Value>* temp = static_cast<AVLNode<Key, Value>*>(this->root_);
-    AVLNode<Key, Value>* node = new AVLNode<Key, Value> (key, value, NULL); //create a new node
-    node->setBalance(0);
 
     //tree is empty (adding to root)
     if(temp == nullptr) {
+        AVLNode<Key, Value>* node = (adopted == NULL) ? createNode(key, value, NULL) : adoptNode(adopted);
         this->root_ = node;
-        return;
+        this->noteInsert(node);
+        filterAdd(key);
+        nodeLinked(node);
+        return node;
     }
  
     while(temp->getLeft() != NULL || temp->getRight() != NULL) {
-        Key this_key = temp->getKey();
+        const Key& this_key = temp->getKey();
         if(key == this_key) { //update value
+            if(adopted != NULL) {
+                return temp;
+            }
             temp->setValue(value);
-            delete node; 
-            return;
+            revive(temp);
+            updatePath(temp);
+            return temp;
         }
         else if(key < this_key) {
             if(temp->getLeft() == NULL) { //checker to see if you need to stop
@@ -190,12 +481,17 @@ void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
     }
 
     if(key == temp->getKey()) { //update value in the case that temp has no children
+            if(adopted != NULL) {
+                return temp;
+            }
             temp->setValue(value);
-            delete node; 
-            return;
+            revive(temp);
+            updatePath(temp);
+            return temp;
         }
 
     //temp is the parent
+    AVLNode<Key, Value>* node = (adopted == NULL) ? createNode(key, value, NULL) : adoptNode(adopted); //create a new node
     if(temp->getRight() == NULL && temp->getLeft() != NULL) { //fill in right child
         temp->setRight(node);
         node->setParent(temp);
@@ -216,6 +512,11 @@ void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
         }
     }
 
+    this->noteInsert(node);
+    filterAdd(key);
+    nodeLinked(node);
+    updatePath(node);
+
     //fix the balance of the parent
     if((temp->getBalance() == -1) || (temp->getBalance() == 1)) {
         temp->setBalance(0);
@@ -229,7 +530,7 @@ void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
         }
         insertFix(temp, node);
     }
-    
+    return node;
 }
 
 template<class Key, class Value>
@@ -327,23 +628,32 @@ void AVLTree<Key, Value>::insertFix(AVLNode<Key, Value>* p, AVLNode<Key, Value>*
  * should swap with the predecessor and then remove.
  */
 template<class Key, class Value>
-void AVLTree<Key, Value>:: remove(const Key& key)
+void AVLTree<Key, Value>::removeNode(Node<Key, Value>* n)
 {
     // this->printRoot(this->root_); //used fore debugging
 
 
-    AVLNode<Key, Value>* node = static_cast<AVLNode<Key, Value>*>(this->internalFind(key));
+    AVLNode<Key, Value>* node = static_cast<AVLNode<Key, Value>*>(n);
     int8_t diff = 0;
 
-    if(node == NULL) {
+    if(tombstones_) { //leave the node in place and only mark it
+        node->setDeleted(true);
+        --this->size_;
+        ++deadCount_;
+        this->skipDeletedBounds();
+        updatePath(node);
+        if(deadCount_ > maxDeadRatio_ * (this->size_ + deadCount_)) {
+            compact();
+        }
+        filterRemoved();
         return;
     }
 
-    AVLNode<Key, Value>* pred = static_cast<AVLNode<Key, Value>*>(this->predecessor(node));
+    this->noteRemove(node);
 
     //node has 2 children
     if(node->getLeft() != NULL && node->getRight() != NULL) {
-        nodeSwap(node, pred);
+        nodeSwap(node, static_cast<AVLNode<Key, Value>*>(this->predecessor(node)));
     }
 
     //get pred old child if there is one (would also be nodes child is there is no pred)
@@ -399,9 +709,677 @@ void AVLTree<Key, Value>:: remove(const Key& key)
         }
     }
 
-    delete node;
+    if(node == extracting_) { //extract keeps the node
+        this->detachNode(node);
+    }
+    else {
+        this->destroyNode(node);
+    }
 
+    updatePath(parent);
     removeFix(parent, diff);
+    filterRemoved();
+}
+
+/**
+* Replaces the contents of the tree with the pairs in [first, last), in
+* any order. When a key repeats, the last pair for it wins. The pairs are
+* sorted in parallel, then the tree is built top down with the two
+* halves of every large range built as separate tasks. All nodes are
+* constructed in place in one block, slot i holding the i-th smallest
+* key, so there is no per-node allocation and no rebalancing.
+* threads = 0 uses WorkStealingPool::shared(). If copying a key or value
+* throws, the nodes built so far are destroyed, the block is freed and
+* the tree is left empty.
+*/
+template<class Key, class Value>
+template<typename InputIt>
+void AVLTree<Key, Value>::buildFrom(InputIt first, InputIt last, size_t threads)
+{
+    this->clear();
+
+    std::vector<std::pair<Key, Value> > items(first, last);
+    WorkStealingPool* local = (threads == 0) ? NULL : new WorkStealingPool(threads);
+    WorkStealingPool& pool = (local == NULL) ? WorkStealingPool::shared() : *local;
+
+    try {
+        parallelStableSort(items.begin(), items.end(),
+            [](const std::pair<Key, Value>& a, const std::pair<Key, Value>& b) { return a.first < b.first; }, pool);
+
+        //stable order keeps each key's pairs in input order, so keep the last
+        size_t kept = 0;
+        for(size_t i = 0; i < items.size(); ++i) {
+            if(i + 1 < items.size() && !(items[i].first < items[i + 1].first)) {
+                continue;
+            }
+            if(kept != i) {
+                items[kept] = std::move(items[i]);
+            }
+            ++kept;
+        }
+        items.resize(kept);
+
+        if(!items.empty()) {
+            size_t bytes = nodeBytes();
+            char* block = static_cast<char*>(this->allocate(items.size() * bytes));
+            std::vector<char> built(items.size(), 0); //which slots hold a constructed node
+            int height;
+            try {
+                this->root_ = buildRange(items, 0, items.size(), NULL, block, bytes, built, pool, height);
+            }
+            catch(...) {
+                //every task has finished, since each TaskGroup waits for its own
+                for(size_t i = 0; i < built.size(); ++i) {
+                    if(built[i]) {
+                        reinterpret_cast<AVLNode<Key, Value>*>(block + i * bytes)->~AVLNode();
+                    }
+                }
+                this->deallocate(block, items.size() * bytes);
+                throw;
+            }
+            this->nodeSize_ = bytes;
+            this->adoptBlock(block, items.size(), bytes);
+            this->size_ = items.size();
+            this->resetBounds();
+        }
+    }
+    catch(...) {
+        delete local;
+        throw;
+    }
+    delete local;
+    bulkLoaded();
+    if(filterHash_ != NULL) {
+        rebuildFilter();
+    }
+}
+
+/**
+* Builds items[lo, hi) into a subtree under parent and returns its root,
+* with its height in height. The two halves go to separate tasks while
+* they are large enough to be worth it. Marks each slot it constructs in
+* built, so buildFrom can destroy them if a later one throws.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::buildRange(const std::vector<std::pair<Key, Value> >& items,
+    size_t lo, size_t hi, AVLNode<Key, Value>* parent, char* block, size_t bytes, std::vector<char>& built,
+    WorkStealingPool& pool, int& height)
+{
+    if(lo >= hi) {
+        height = 0;
+        return NULL;
+    }
+    size_t mid = lo + (hi - lo) / 2;
+    AVLNode<Key, Value>* node = constructNode(block + mid * bytes, items[mid].first, items[mid].second, parent);
+    built[mid] = 1;
+
+    AVLNode<Key, Value>* left;
+    AVLNode<Key, Value>* right;
+    int hleft, hright;
+    if(hi - lo > 4096) {
+        WorkStealingPool::TaskGroup group(pool);
+        group.run([&] { left = buildRange(items, lo, mid, node, block, bytes, built, pool, hleft); });
+        right = buildRange(items, mid + 1, hi, node, block, bytes, built, pool, hright);
+        group.wait();
+    }
+    else {
+        left = buildRange(items, lo, mid, node, block, bytes, built, pool, hleft);
+        right = buildRange(items, mid + 1, hi, node, block, bytes, built, pool, hright);
+    }
+
+    node->setLeft(left);
+    node->setRight(right);
+    node->setBalance(hright - hleft);
+    updateNode(node);
+    height = 1 + this->maxHeight(hleft, hright);
+    return node;
+}
+
+/**
+* Moves every key not less than key into upper, which must be empty, and
+* returns how many live keys moved. The tree itself is cut in O(log n),
+* but counting what moved walks the moved part. Both trees must be of the
+* same type and allocate from the same memory resource, since nodes
+* change hands.
+*/
+template<class Key, class Value>
+size_t AVLTree<Key, Value>::splitAt(const Key& key, AVLTree<Key, Value>& upper)
+{
+    if(typeid(upper) != typeid(*this)) {
+        throw std::invalid_argument("Different tree types");
+    }
+    if(upper.root_ != NULL || upper.deadCount_ != 0) {
+        throw std::invalid_argument("Tree not empty");
+    }
+    if(upper.resource_ != this->resource_) {
+        throw std::invalid_argument("Different memory resources");
+    }
+
+    AVLNode<Key, Value> *lower, *higher;
+    int hlower, hhigher;
+    split(static_cast<AVLNode<Key, Value>*>(this->root_), height(), key, false, lower, hlower, higher, hhigher);
+    if(lower != NULL) {
+        lower->setParent(NULL);
+    }
+    if(higher != NULL) {
+        higher->setParent(NULL);
+    }
+
+    size_t moved = this->subtreeSize(higher);
+    size_t dead = (deadCount_ > 0) ? countDeleted(higher) : 0;
+    this->moveBlockRefs(higher, upper);
+    upper.nodeSize_ = this->nodeSize_;
+    ++this->generation_;
+
+    this->root_ = lower;
+    upper.root_ = higher;
+    upper.size_ = moved - dead;
+    upper.deadCount_ = dead;
+    this->size_ -= upper.size_;
+    deadCount_ -= dead;
+    this->resetBounds();
+    upper.resetBounds();
+    filterRemoved();
+    if(upper.filterHash_ != NULL) {
+        upper.rebuildFilter();
+    }
+    return upper.size_;
+}
+
+/**
+* Appends every key of upper, which must all be larger than the keys
+* here, leaving upper empty. O(log n), plus one step per node block
+* upper got from buildFrom. Both trees must be of the same type and use
+* the same memory resource.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::concat(AVLTree<Key, Value>& upper)
+{
+    if(typeid(upper) != typeid(*this)) {
+        throw std::invalid_argument("Different tree types");
+    }
+    if(upper.root_ == NULL) {
+        return;
+    }
+    //compare the outermost nodes, tombstones included, since they stay linked
+    Node<Key, Value>* last = this->root_;
+    Node<Key, Value>* first = upper.root_;
+    while(last != NULL && last->getRight() != NULL) {
+        last = last->getRight();
+    }
+    while(first->getLeft() != NULL) {
+        first = first->getLeft();
+    }
+    if(last != NULL && !(last->getKey() < first->getKey())) {
+        throw std::invalid_argument("Keys overlap");
+    }
+    if(upper.resource_ != this->resource_) {
+        throw std::invalid_argument("Different memory resources");
+    }
+
+    int h;
+    AVLNode<Key, Value>* root = join(static_cast<AVLNode<Key, Value>*>(this->root_), height(),
+        static_cast<AVLNode<Key, Value>*>(upper.root_), upper.height(), h);
+    root->setParent(NULL);
+    this->root_ = root;
+    this->size_ += upper.size_;
+    deadCount_ += upper.deadCount_;
+    this->takeBlockRefs(upper);
+    this->nodeSize_ = upper.nodeSize_;
+    ++upper.generation_;
+    upper.root_ = NULL;
+    upper.size_ = 0;
+    upper.deadCount_ = 0;
+    this->resetBounds();
+    upper.resetBounds();
+
+    //the filters are OR-ed when they line up, otherwise this one is rebuilt
+    if(filterHash_ != NULL) {
+        if(upper.filterHash_ == filterHash_ && upper.filter_.blocks() == filter_.blocks()
+            && filterKeys_ + upper.filterKeys_ <= filterCapacity_) {
+            filter_.merge(upper.filter_);
+            filterKeys_ += upper.filterKeys_;
+        }
+        else {
+            rebuildFilter();
+        }
+    }
+    if(upper.filterHash_ != NULL) {
+        upper.filter_.clear();
+        upper.filterKeys_ = 0;
+    }
+}
+
+/**
+* Always throws std::logic_error: a weight-shaped tree would break the
+* height invariant.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::rebuildOptimal()
+{
+    throw std::logic_error("AVLTree cannot take a weighted shape");
+}
+
+/**
+* Unlinks the entry for key and returns its node, or an empty handle if
+* key is not here. The node is unlinked even if tombstones are on.
+* O(log n), with no allocation.
+*/
+template<class Key, class Value>
+typename AVLTree<Key, Value>::NodeHandle AVLTree<Key, Value>::extract(const Key& key)
+{
+    return extractNode(static_cast<AVLNode<Key, Value>*>(internalFind(key)));
+}
+
+/**
+* Like extract(key) for the entry at pos, with no search. pos and every
+* other iterator to the entry become invalid.
+*/
+template<class Key, class Value>
+typename AVLTree<Key, Value>::NodeHandle AVLTree<Key, Value>::extract(
+    typename BinarySearchTree<Key, Value>::iterator pos)
+{
+    return extractNode(static_cast<AVLNode<Key, Value>*>(this->nodeAt(pos)));
+}
+
+/**
+* Links the node node holds and returns true, leaving node empty. If key
+* is already here nothing changes, node keeps the entry and the result is
+* false. A tombstone of the key is revived with node's value instead,
+* which is moved and not copied. Throws std::invalid_argument if node
+* came from a tree of another type or memory resource. O(log n).
+*/
+template<class Key, class Value>
+bool AVLTree<Key, Value>::insert(NodeHandle&& node)
+{
+    if(node.node_ == NULL) {
+        return false;
+    }
+    if(*node.tree_ != typeid(*this)) {
+        throw std::invalid_argument("Different tree types");
+    }
+    if(node.resource_ != this->resource_) {
+        throw std::invalid_argument("Different memory resources");
+    }
+
+    AVLNode<Key, Value>* adopted = node.node_;
+    AVLNode<Key, Value>* found = place(adopted->getKey(), adopted->getValue(), adopted);
+    if(found == adopted) {
+        if(node.block_ != NULL) {
+            this->addBlockRef(node.block_);
+        }
+        else {
+            this->nodeSize_ = node.bytes_;
+        }
+        node.node_ = NULL;
+        return true;
+    }
+    if(!found->isDeleted()) {
+        return false;
+    }
+    found->getValue() = std::move(adopted->getValue());
+    revive(found);
+    updatePath(found);
+    node.reset();
+    return true;
+}
+
+/**
+* Moves every entry of other whose key is not here into this tree,
+* relinking its node. Entries with a key already here stay in other.
+* Throws std::invalid_argument if other is of another type or memory
+* resource. O(m log(n + m)) for m entries moved.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::merge(AVLTree<Key, Value>& other)
+{
+    if(&other == this || other.size_ == 0) {
+        return;
+    }
+    if(typeid(other) != typeid(*this)) {
+        throw std::invalid_argument("Different tree types");
+    }
+    if(other.resource_ != this->resource_) {
+        throw std::invalid_argument("Different memory resources");
+    }
+
+    std::vector<Node<Key, Value>*> moving;
+    moving.reserve(other.size_);
+    auto visit = [this, &moving](Node<Key, Value>* node) {
+        Node<Key, Value>* here = this->internalLowerBound(node->getKey());
+        if(here == NULL || node->getKey() < here->getKey() || here->isDeleted()) {
+            moving.push_back(node);
+        }
+    };
+    this->inOrder(other.root_, visit);
+    for(size_t i = 0; i < moving.size(); ++i) {
+        insert(other.extractNode(static_cast<AVLNode<Key, Value>*>(moving[i])));
+    }
+}
+
+/**
+* Unlinks node through removeNode, so trees that index their nodes drop
+* it as for a remove, but with tombstones off and without freeing it.
+*/
+template<class Key, class Value>
+typename AVLTree<Key, Value>::NodeHandle AVLTree<Key, Value>::extractNode(AVLNode<Key, Value>* node)
+{
+    NodeHandle handle;
+    if(node == NULL) {
+        return handle;
+    }
+    size_t i = this->findBlock(node);
+    handle.block_ = (i == this->blocks_.size()) ? NULL : this->blocks_[i].block;
+    handle.resource_ = this->resource_;
+    handle.bytes_ = this->nodeSize_;
+    handle.tree_ = &typeid(*this);
+
+    bool tombstones = tombstones_;
+    tombstones_ = false;
+    extracting_ = node;
+    removeNode(node);
+    extracting_ = NULL;
+    tombstones_ = tombstones;
+    this->skipDeletedBounds();
+
+    node->setParent(NULL);
+    node->setLeft(NULL);
+    node->setRight(NULL);
+    node->setBalance(0);
+    handle.node_ = node;
+    return handle;
+}
+
+/**
+* Turns lazy removal on or off. maxDeadRatio is the fraction of nodes
+* that may be tombstones before a remove compacts the tree. Turning it
+* off compacts right away, since eager removes assume no tombstones.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::setTombstones(bool enabled, double maxDeadRatio)
+{
+    if(maxDeadRatio <= 0.0 || maxDeadRatio >= 1.0) {
+        throw std::out_of_range("Invalid ratio");
+    }
+    tombstones_ = enabled;
+    maxDeadRatio_ = maxDeadRatio;
+    if(!enabled) {
+        compact();
+    }
+}
+
+/**
+* Frees every tombstone and rebuilds the live nodes into a perfectly
+* balanced tree, reusing the nodes. O(n).
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::compact()
+{
+    if(deadCount_ == 0) {
+        return;
+    }
+
+    std::vector<Node<Key, Value>*> nodes;
+    nodes.reserve(this->size_ + deadCount_);
+    this->flatten(this->root_, nodes);
+
+    size_t live = 0;
+    for(size_t i = 0; i < nodes.size(); ++i) {
+        if(nodes[i]->isDeleted()) {
+            this->destroyNode(nodes[i]);
+        }
+        else {
+            nodes[live++] = nodes[i];
+        }
+    }
+    nodes.resize(live);
+
+    this->root_ = this->buildBalanced(nodes, 0, nodes.size(), NULL);
+    fixBalances(static_cast<AVLNode<Key, Value>*>(this->root_));
+    deadCount_ = 0;
+    this->resetBounds();
+    if(filterHash_ != NULL) {
+        rebuildFilter();
+    }
+}
+
+template<class Key, class Value>
+size_t AVLTree<Key, Value>::deadCount() const
+{
+    return deadCount_;
+}
+
+/**
+* The fraction of linked nodes that are tombstones, 0 for an empty tree.
+*/
+template<class Key, class Value>
+double AVLTree<Key, Value>::deadRatio() const
+{
+    size_t total = this->size_ + deadCount_;
+    if(total == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(deadCount_) / total;
+}
+
+/**
+* Attaches a blocked Bloom filter of bitsPerKey bits per key, built from
+* the keys now in the tree, or detaches it. Hash hashes a Key; its output
+* is remixed, so an identity hash such as std::hash<int> is fine. The
+* filter grows with the tree and is rebuilt once removed keys make up a
+* third of it, so both cost amortized O(1) per insert or remove.
+*/
+template<class Key, class Value>
+template<class Hash>
+void AVLTree<Key, Value>::setFilter(bool enabled, double bitsPerKey)
+{
+    if(bitsPerKey <= 0.0) {
+        throw std::out_of_range("Invalid bits per key");
+    }
+    filterRejected_.store(0);
+    filterFalsePositives_.store(0);
+    if(!enabled) {
+        filterHash_ = NULL;
+        filter_ = BlockedBloomFilter();
+        filterKeys_ = 0;
+        filterCapacity_ = 0;
+        return;
+    }
+    filterHash_ = &AVLTree<Key, Value>::template filterHash<Hash>;
+    bitsPerKey_ = bitsPerKey;
+    rebuildFilter();
+}
+
+template<class Key, class Value>
+typename AVLTree<Key, Value>::FilterStats AVLTree<Key, Value>::filterStats() const
+{
+    FilterStats stats;
+    stats.bytes = filter_.bytes();
+    stats.keys = filterKeys_;
+    stats.rejected = filterRejected_.load(std::memory_order_relaxed);
+    stats.falsePositives = filterFalsePositives_.load(std::memory_order_relaxed);
+    size_t misses = stats.rejected + stats.falsePositives;
+    stats.falsePositiveRate = (misses == 0) ? 0.0 : static_cast<double>(stats.falsePositives) / misses;
+    return stats;
+}
+
+/**
+* True if the filter proves key absent. Always false without a filter.
+*/
+template<class Key, class Value>
+bool AVLTree<Key, Value>::filterRejects(const Key& key) const
+{
+    if(filterHash_ == NULL || filter_.mayContain(filterHash_(key))) {
+        return false;
+    }
+    filterRejected_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+/**
+* Called with the result of a lookup the filter let through, to count
+* the false positives.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::filterChecked(Node<Key, Value>* found) const
+{
+    if(found == NULL && filterHash_ != NULL) {
+        filterFalsePositives_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::filterAdd(const Key& key)
+{
+    if(filterHash_ == NULL) {
+        return;
+    }
+    if(++filterKeys_ > filterCapacity_) {
+        rebuildFilter(); //the key is already linked, so the rebuild picks it up
+        return;
+    }
+    filter_.add(filterHash_(key));
+}
+
+/**
+* Rebuilds once the keys that left the tree number half the live ones,
+* since every one of them is a false positive waiting to happen.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::filterRemoved()
+{
+    if(filterHash_ != NULL && filterKeys_ > this->size_ + this->size_ / 2 + 64) {
+        rebuildFilter();
+    }
+}
+
+/**
+* Sizes the filter for half again the live keys and adds each of them. O(n).
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::rebuildFilter()
+{
+    filterCapacity_ = this->size_ + this->size_ / 2 + 64;
+    filter_.reset(filterCapacity_, bitsPerKey_);
+    filterKeys_ = this->size_;
+    BlockedBloomFilter& filter = filter_;
+    uint64_t (*hash)(const Key& key) = filterHash_;
+    auto visit = [&filter, hash](Node<Key, Value>* node) { filter.add(hash(node->getKey())); };
+    this->inOrder(this->root_, visit);
+}
+
+/**
+* Hash's output run through the MurmurHash3 finalizer, so that every bit
+* of it depends on every bit of the key hash.
+*/
+template<class Key, class Value>
+template<class Hash>
+uint64_t AVLTree<Key, Value>::filterHash(const Key& key)
+{
+    uint64_t h = static_cast<uint64_t>(Hash()(key));
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::clear()
+{
+    BinarySearchTree<Key, Value>::clear();
+    deadCount_ = 0;
+    filter_.clear();
+    filterKeys_ = 0;
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::release()
+{
+    BinarySearchTree<Key, Value>::release();
+    deadCount_ = 0;
+    filter_.clear();
+    filterKeys_ = 0;
+}
+
+/**
+* A tombstone is found like any node but reported as absent. With a
+* filter attached, keys it rules out are not searched for at all.
+*/
+template<class Key, class Value>
+Node<Key, Value>* AVLTree<Key, Value>::internalFind(const Key& key) const
+{
+    if(filterRejects(key)) {
+        return NULL;
+    }
+    Node<Key, Value>* node = BinarySearchTree<Key, Value>::internalFind(key);
+    if(node != NULL && node->isDeleted()) {
+        node = NULL;
+    }
+    filterChecked(node);
+    return node;
+}
+
+/**
+* Sets balances bottom up after a rebuild and returns the subtree height.
+*/
+template<class Key, class Value>
+int AVLTree<Key, Value>::fixBalances(AVLNode<Key, Value>* node)
+{
+    if(node == NULL) {
+        return 0;
+    }
+    int left = fixBalances(node->getLeft());
+    int right = fixBalances(node->getRight());
+    node->setBalance(right - left);
+    updateNode(node);
+    return 1 + this->maxHeight(left, right);
+}
+
+/**
+* Brings a tombstone back when its key is inserted again.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::revive(AVLNode<Key, Value>* node)
+{
+    if(!node->isDeleted()) {
+        return;
+    }
+    node->setDeleted(false);
+    --deadCount_;
+    this->noteInsert(node);
+    filterAdd(node->getKey());
+}
+
+template<class Key, class Value>
+size_t AVLTree<Key, Value>::countDeleted(Node<Key, Value>* node)
+{
+    if(node == NULL) {
+        return 0;
+    }
+    return (node->isDeleted() ? 1 : 0) + countDeleted(node->getLeft()) + countDeleted(node->getRight());
+}
+
+/**
+* The height follows from the balance factors alone: the taller child is
+* always the one the balance leans towards, so one walk down is enough.
+*/
+template<class Key, class Value>
+int AVLTree<Key, Value>::height() const
+{
+    int result = 0;
+    AVLNode<Key, Value>* temp = static_cast<AVLNode<Key, Value>*>(this->root_);
+    while(temp != NULL) {
+        ++result;
+        if(temp->getBalance() > 0) {
+            temp = temp->getRight();
+        }
+        else {
+            temp = temp->getLeft();
+        }
+    }
+    return result;
 }
 
 template<class Key, class Value>
@@ -523,83 +1501,16 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* n, int8_t diff) {
 
 template<class Key, class Value>
 void AVLTree<Key, Value>::rotateLeft(AVLNode<Key, Value>* node) {
-    AVLNode<Key, Value>* parent = NULL;
-    AVLNode<Key, Value>* child = node ->getRight();
-
-     //node has a parent
-    if(node->getParent() != NULL) {
-        parent = node->getParent();
-    
-        bool isLeft = false;
-
-        if(parent->getLeft() == node) { 
-            isLeft = true;
-        }
-
-        if(isLeft) { //node is left child
-            parent->setLeft(child);
-        }
-        else if(!isLeft) { //node is right child
-            parent->setRight(child);
-        }    
-    }
-    else if(node->getParent() == NULL) { //child becomes root
-        this->root_ = child;
-    }
-
-    child->setParent(parent);
-
-    AVLNode<Key, Value>* left = NULL;
-    if(child->getLeft() != NULL) {
-        left = child->getLeft();
-        left->setParent(node);
-    }
-
-    child->setLeft(node);
-    node->setParent(child);
-
-    node->setRight(left);
+    BinarySearchTree<Key, Value>::rotateLeft(node);
+    updateNode(node);
+    updateNode(node->getParent());
 }
 
 template<class Key, class Value>
 void AVLTree<Key, Value>::rotateRight(AVLNode<Key, Value>* node) {
-    AVLNode<Key, Value>* parent = NULL;
-    AVLNode<Key, Value>* child = node ->getLeft();
-
-     //node has a parent
-    if(node->getParent() != NULL) {
-        parent = node->getParent();
-    
-        bool isLeft = false;
-
-        if(parent->getLeft() == node) { 
-            isLeft = true;
-        }
-
-        if(isLeft) { //node is left child
-            parent->setLeft(child);
-        }
-        else if(!isLeft) { //node is right child
-            parent->setRight(child);
-        }    
-    }
-    else if(node->getParent() == NULL) { //child becomes root
-        this->root_ = child;
-    }
-
-    child->setParent(parent);
-
-
-    AVLNode<Key, Value>* right = NULL;
-    if(child->getRight() != NULL) {
-        right = child->getRight();
-        right->setParent(node);
-    }
-
-    child->setRight(node);
-    node->setParent(child);
-
-    node->setLeft(right);
+    BinarySearchTree<Key, Value>::rotateRight(node);
+    updateNode(node);
+    updateNode(node->getParent());
 }
 
 template<class Key, class Value>
@@ -643,6 +1554,324 @@ bool AVLTree<Key, Value>::zigzag(AVLNode<Key, Value>* g, AVLNode<Key, Value>* p,
     return result;
 }
 
+/**
+* Allocates the node for a new key. Overridden by trees whose nodes carry more data.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent)
+{
+    return new (this->allocateNode(sizeof(AVLNode<Key, Value>))) AVLNode<Key, Value>(key, value, parent);
+}
+
+/**
+* Takes a node from another tree of the same type, with its key and
+* value, where insert would create one. Not linked yet, and its links
+* are NULL. Trees that keep data about their nodes outside the nodes
+* override it like createNode.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::adoptNode(AVLNode<Key, Value>* node)
+{
+    return node;
+}
+
+/**
+* Recomputes any data node derives from its children. Called bottom-up
+* on both nodes of every rotation. Nothing to do for a plain AVLTree.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::updateNode(AVLNode<Key, Value>* node)
+{
+
+}
+
+/**
+* Calls updateNode from node up to the root after a node was linked,
+* unlinked or had its value changed. A no-op for a plain AVLTree, so it
+* does not walk the path at all.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::updatePath(AVLNode<Key, Value>* node)
+{
+
+}
+
+/**
+* Called once insert has linked a new leaf, before rebalancing. Nothing
+* to do for a plain AVLTree.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::nodeLinked(AVLNode<Key, Value>* node)
+{
+
+}
+
+/**
+* The size of one node as constructNode builds it.
+*/
+template<class Key, class Value>
+size_t AVLTree<Key, Value>::nodeBytes() const
+{
+    return sizeof(AVLNode<Key, Value>);
+}
+
+/**
+* Constructs a node in place at where, which has room for nodeBytes().
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::constructNode(void* where, const Key& key, const Value& value,
+    AVLNode<Key, Value>* parent)
+{
+    return new (where) AVLNode<Key, Value>(key, value, parent);
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::bulkLoaded()
+{
+
+}
+
+/**
+* Removes every key in [lo, hi] by splitting the tree around the range,
+* freeing the middle piece in one pass and joining the two outer pieces.
+* Splits and joins work down the spines once, so this costs O(log^2 n + k)
+* instead of k removes that each rebalance on their own.
+*/
+template<class Key, class Value>
+size_t AVLTree<Key, Value>::eraseRange(const Key& lo, const Key& hi)
+{
+    if(this->root_ == NULL || hi < lo) {
+        return 0;
+    }
+
+    AVLNode<Key, Value> *left, *rest, *middle, *right;
+    int hleft, hrest, hmiddle, hright, h;
+    split(static_cast<AVLNode<Key, Value>*>(this->root_), height(), lo, false, left, hleft, rest, hrest);
+    split(rest, hrest, hi, true, middle, hmiddle, right, hright);
+
+    size_t dead = (deadCount_ > 0) ? countDeleted(middle) : 0;
+    size_t count = this->postOrder(middle) - dead;
+
+    AVLNode<Key, Value>* root = join(left, hleft, right, hright, h);
+    if(root != NULL) {
+        root->setParent(NULL);
+    }
+    this->root_ = root;
+    this->size_ -= count;
+    deadCount_ -= dead;
+    this->resetBounds();
+    filterRemoved();
+    return count;
+}
+
+/**
+* Heights of n's children, given n's height h and its balance.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::childHeights(AVLNode<Key, Value>* n, int h, int& hl, int& hr)
+{
+    hl = h - ((n->getBalance() > 0) ? 2 : 1);
+    hr = h - ((n->getBalance() < 0) ? 2 : 1);
+}
+
+/**
+* Makes k the root over l and r, whose heights differ by at most one.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::link(AVLNode<Key, Value>* l, int hl, AVLNode<Key, Value>* k,
+    AVLNode<Key, Value>* r, int hr, int& h)
+{
+    k->setLeft(l);
+    k->setRight(r);
+    if(l != NULL) {
+        l->setParent(k);
+    }
+    if(r != NULL) {
+        r->setParent(k);
+    }
+    k->setBalance(hr - hl);
+    h = 1 + this->maxHeight(hl, hr);
+    updateNode(k);
+    return k;
+}
+
+/**
+* n's children are already attached and have heights hl and hr, which may
+* differ by up to two. Sets the balances, rotating if needed, and returns
+* the root of the result with its height in h.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::rebalance(AVLNode<Key, Value>* n, int hl, int hr, int& h)
+{
+    if(hr - hl <= 1 && hl - hr <= 1) {
+        n->setBalance(hr - hl);
+        h = 1 + this->maxHeight(hl, hr);
+        updateNode(n);
+        return n;
+    }
+
+    if(hr - hl == 2) {
+        AVLNode<Key, Value>* c = n->getRight();
+        int hcl, hcr;
+        childHeights(c, hr, hcl, hcr);
+
+        if(c->getBalance() >= 0) { //single rotation
+            AVLNode<Key, Value>* cl = c->getLeft();
+            n->setRight(cl);
+            if(cl != NULL) {
+                cl->setParent(n);
+            }
+            int hn;
+            link(n->getLeft(), hl, n, cl, hcl, hn);
+            return link(n, hn, c, c->getRight(), hcr, h);
+        }
+
+        //double rotation through c's left child
+        AVLNode<Key, Value>* g = c->getLeft();
+        int hgl, hgr, hn, hc;
+        childHeights(g, hcl, hgl, hgr);
+        AVLNode<Key, Value>* gl = g->getLeft();
+        AVLNode<Key, Value>* gr = g->getRight();
+        link(n->getLeft(), hl, n, gl, hgl, hn);
+        link(gr, hgr, c, c->getRight(), hcr, hc);
+        return link(n, hn, g, c, hc, h);
+    }
+
+    //mirror image: left side two taller
+    AVLNode<Key, Value>* c = n->getLeft();
+    int hcl, hcr;
+    childHeights(c, hl, hcl, hcr);
+
+    if(c->getBalance() <= 0) { //single rotation
+        AVLNode<Key, Value>* cr = c->getRight();
+        n->setLeft(cr);
+        if(cr != NULL) {
+            cr->setParent(n);
+        }
+        int hn;
+        link(cr, hcr, n, n->getRight(), hr, hn);
+        return link(c->getLeft(), hcl, c, n, hn, h);
+    }
+
+    //double rotation through c's right child
+    AVLNode<Key, Value>* g = c->getRight();
+    int hgl, hgr, hn, hc;
+    childHeights(g, hcr, hgl, hgr);
+    AVLNode<Key, Value>* gl = g->getLeft();
+    AVLNode<Key, Value>* gr = g->getRight();
+    link(c->getLeft(), hcl, c, gl, hgl, hc);
+    link(gr, hgr, n, n->getRight(), hr, hn);
+    return link(c, hc, g, n, hn, h);
+}
+
+/**
+* Joins l, the single node k and r, where every key in l is smaller than
+* k and every key in r is larger. k is placed down the spine of the taller
+* side at the first node no more than one level taller than the other side,
+* and the path back up is rebalanced.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::join(AVLNode<Key, Value>* l, int hl, AVLNode<Key, Value>* k,
+    AVLNode<Key, Value>* r, int hr, int& h)
+{
+    if(hl > hr + 1) {
+        int hll, hlr, ht;
+        childHeights(l, hl, hll, hlr);
+        AVLNode<Key, Value>* t = join(l->getRight(), hlr, k, r, hr, ht);
+        l->setRight(t);
+        t->setParent(l);
+        return rebalance(l, hll, ht, h);
+    }
+    if(hr > hl + 1) {
+        int hrl, hrr, ht;
+        childHeights(r, hr, hrl, hrr);
+        AVLNode<Key, Value>* t = join(l, hl, k, r->getLeft(), hrl, ht);
+        r->setLeft(t);
+        t->setParent(r);
+        return rebalance(r, ht, hrr, h);
+    }
+    return link(l, hl, k, r, hr, h);
+}
+
+/**
+* Joins l and r without a middle node by taking the largest node out of l.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::join(AVLNode<Key, Value>* l, int hl, AVLNode<Key, Value>* r, int hr, int& h)
+{
+    if(l == NULL) {
+        h = hr;
+        return r;
+    }
+    if(r == NULL) {
+        h = hl;
+        return l;
+    }
+    AVLNode<Key, Value>* rest;
+    int hrest;
+    AVLNode<Key, Value>* k = splitLast(l, hl, rest, hrest);
+    return join(rest, hrest, k, r, hr, h);
+}
+
+/**
+* Detaches the largest node of t and returns it, leaving the rest of t in rest.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::splitLast(AVLNode<Key, Value>* t, int ht, AVLNode<Key, Value>*& rest, int& hrest)
+{
+    int htl, htr;
+    childHeights(t, ht, htl, htr);
+    if(t->getRight() == NULL) {
+        rest = t->getLeft();
+        hrest = htl;
+        return t;
+    }
+    AVLNode<Key, Value>* right;
+    int hright;
+    AVLNode<Key, Value>* last = splitLast(t->getRight(), htr, right, hright);
+    rest = join(t->getLeft(), htl, t, right, hright, hrest);
+    return last;
+}
+
+/**
+* Splits t into l, holding the keys before key, and r, holding the rest.
+* key itself goes to l when inclusive is set and to r otherwise.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::split(AVLNode<Key, Value>* t, int ht, const Key& key, bool inclusive,
+    AVLNode<Key, Value>*& l, int& hl, AVLNode<Key, Value>*& r, int& hr)
+{
+    if(t == NULL) {
+        l = NULL;
+        r = NULL;
+        hl = 0;
+        hr = 0;
+        return;
+    }
+
+    int htl, htr;
+    childHeights(t, ht, htl, htr);
+    AVLNode<Key, Value>* tl = t->getLeft();
+    AVLNode<Key, Value>* tr = t->getRight();
+    bool goesLeft = inclusive ? !(key < t->getKey()) : (t->getKey() < key);
+
+    AVLNode<Key, Value>* a;
+    AVLNode<Key, Value>* b;
+    int ha, hb;
+    if(goesLeft) { //t and its left subtree are all before key
+        split(tr, htr, key, inclusive, a, ha, b, hb);
+        l = join(tl, htl, t, a, ha, hl);
+        r = b;
+        hr = hb;
+    }
+    else {
+        split(tl, htl, key, inclusive, a, ha, b, hb);
+        l = a;
+        hl = ha;
+        r = join(b, hb, t, tr, htr, hr);
+    }
+}
+
 template<class Key, class Value>
 void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
 {
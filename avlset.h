@@ -0,0 +1,318 @@
+#ifndef AVLSET_H
+#define AVLSET_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <stdint.h>
+#include "bst.h"
+#include "avlbst.h"
+
+/**
+* The Value type used by the key-only sets. It holds no user data. An
+* AVLNode with this Value keeps its balance in here, inside the padding
+* that std::pair<const Key, Value> already has after the key, instead of
+* in a separate member. That is what makes a set node smaller than an
+* AVLTree<Key, bool> node.
+*
+* Assignment deliberately copies nothing: the tree overwrites the value
+* of an existing key on a duplicate insert, and that must not clobber
+* the balance stored in it. The tombstone flag lives here for the same
+* reason.
+*/
+struct KeyOnly
+{
+    KeyOnly() : balance(0), deleted(false) { }
+    KeyOnly(const KeyOnly& other) : balance(other.balance), deleted(other.deleted) { }
+    KeyOnly& operator=(const KeyOnly&) { return *this; }
+
+    int8_t balance;
+    bool deleted;
+};
+
+/**
+* AVLNode specialization for key-only trees. Same interface as the
+* general AVLNode, so all of AVLTree's balancing code is shared, but the
+* balance lives in the item rather than after the child pointers.
+*/
+template <typename Key>
+class AVLNode<Key, KeyOnly> : public Node<Key, KeyOnly>
+{
+public:
+    // Constructor/destructor.
+    AVLNode(const Key& key, const KeyOnly& value, AVLNode<Key, KeyOnly>* parent);
+    virtual ~AVLNode();
+
+    // Getter/setter for the node's height.
+    int8_t getBalance () const;
+    void setBalance (int8_t balance);
+    void updateBalance(int8_t diff);
+
+    // Getter/setter for the tombstone flag.
+    virtual bool isDeleted() const override;
+    void setDeleted(bool deleted);
+
+    // Getters for parent, left, and right.
+    virtual AVLNode<Key, KeyOnly>* getParent() const override;
+    virtual AVLNode<Key, KeyOnly>* getLeft() const override;
+    virtual AVLNode<Key, KeyOnly>* getRight() const override;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the AVLNode<Key, KeyOnly> class.
+  -------------------------------------------------
+*/
+
+template<class Key>
+AVLNode<Key, KeyOnly>::AVLNode(const Key& key, const KeyOnly& value, AVLNode<Key, KeyOnly> *parent) :
+    Node<Key, KeyOnly>(key, value, parent)
+{
+    this->item_.second.balance = 0;
+    this->item_.second.deleted = false;
+}
+
+template<class Key>
+AVLNode<Key, KeyOnly>::~AVLNode()
+{
+
+}
+
+template<class Key>
+int8_t AVLNode<Key, KeyOnly>::getBalance() const
+{
+    return this->item_.second.balance;
+}
+
+template<class Key>
+void AVLNode<Key, KeyOnly>::setBalance(int8_t balance)
+{
+    this->item_.second.balance = balance;
+}
+
+template<class Key>
+void AVLNode<Key, KeyOnly>::updateBalance(int8_t diff)
+{
+    this->item_.second.balance += diff;
+}
+
+template<class Key>
+bool AVLNode<Key, KeyOnly>::isDeleted() const
+{
+    return this->item_.second.deleted;
+}
+
+template<class Key>
+void AVLNode<Key, KeyOnly>::setDeleted(bool deleted)
+{
+    this->item_.second.deleted = deleted;
+}
+
+template<class Key>
+AVLNode<Key, KeyOnly> *AVLNode<Key, KeyOnly>::getParent() const
+{
+    return static_cast<AVLNode<Key, KeyOnly>*>(this->parent_);
+}
+
+template<class Key>
+AVLNode<Key, KeyOnly> *AVLNode<Key, KeyOnly>::getLeft() const
+{
+    return static_cast<AVLNode<Key, KeyOnly>*>(this->left_);
+}
+
+template<class Key>
+AVLNode<Key, KeyOnly> *AVLNode<Key, KeyOnly>::getRight() const
+{
+    return static_cast<AVLNode<Key, KeyOnly>*>(this->right_);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the AVLNode<Key, KeyOnly> class.
+  -----------------------------------------------
+*/
+
+
+/**
+* An ordered set of keys on top of one of the trees (with KeyOnly as its
+* Value). Use AVLSet or BSTSet rather than naming Tree directly.
+*/
+template <class Key, class Tree>
+class KeySet
+{
+public:
+    bool insert(const Key& key);
+    bool erase(const Key& key);
+    bool contains(const Key& key) const;
+    void clear();
+    bool empty() const;
+    size_t size() const;
+
+    /**
+    * Iterates over the keys in order.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        const Key& operator*() const;
+        const Key* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class KeySet<Key, Tree>;
+        iterator(const typename Tree::iterator& it);
+        typename Tree::iterator it_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+
+protected:
+    Tree tree_;
+};
+
+/**
+* A set of keys that uses AVLTree's balancing and stores no values.
+*/
+template <class Key>
+class AVLSet : public KeySet<Key, AVLTree<Key, KeyOnly> >
+{
+};
+
+/**
+* A set of keys on the plain, unbalanced BinarySearchTree.
+*/
+template <class Key>
+class BSTSet : public KeySet<Key, BinarySearchTree<Key, KeyOnly> >
+{
+};
+
+/*
+--------------------------------------------------
+Begin implementations for the KeySet::iterator class.
+--------------------------------------------------
+*/
+
+template<class Key, class Tree>
+KeySet<Key, Tree>::iterator::iterator()
+{
+
+}
+
+template<class Key, class Tree>
+KeySet<Key, Tree>::iterator::iterator(const typename Tree::iterator& it) :
+    it_(it)
+{
+
+}
+
+template<class Key, class Tree>
+const Key& KeySet<Key, Tree>::iterator::operator*() const
+{
+    return it_->first;
+}
+
+template<class Key, class Tree>
+const Key* KeySet<Key, Tree>::iterator::operator->() const
+{
+    return &(it_->first);
+}
+
+template<class Key, class Tree>
+bool KeySet<Key, Tree>::iterator::operator==(const iterator& rhs) const
+{
+    return it_ == rhs.it_;
+}
+
+template<class Key, class Tree>
+bool KeySet<Key, Tree>::iterator::operator!=(const iterator& rhs) const
+{
+    return it_ != rhs.it_;
+}
+
+template<class Key, class Tree>
+typename KeySet<Key, Tree>::iterator& KeySet<Key, Tree>::iterator::operator++()
+{
+    ++it_;
+    return *this;
+}
+
+/*
+--------------------------------------------------
+End implementations for the KeySet::iterator class.
+--------------------------------------------------
+*/
+
+/**
+* Adds key to the set. Returns true if it was not already there.
+*/
+template<class Key, class Tree>
+bool KeySet<Key, Tree>::insert(const Key& key)
+{
+    size_t before = tree_.size();
+    tree_.insert(std::pair<const Key, KeyOnly>(key, KeyOnly()));
+    return tree_.size() != before;
+}
+
+/**
+* Removes key from the set. Returns true if it was there.
+*/
+template<class Key, class Tree>
+bool KeySet<Key, Tree>::erase(const Key& key)
+{
+    size_t before = tree_.size();
+    tree_.remove(key);
+    return tree_.size() != before;
+}
+
+template<class Key, class Tree>
+bool KeySet<Key, Tree>::contains(const Key& key) const
+{
+    return tree_.find(key) != tree_.end();
+}
+
+template<class Key, class Tree>
+void KeySet<Key, Tree>::clear()
+{
+    tree_.clear();
+}
+
+template<class Key, class Tree>
+bool KeySet<Key, Tree>::empty() const
+{
+    return tree_.empty();
+}
+
+template<class Key, class Tree>
+size_t KeySet<Key, Tree>::size() const
+{
+    return tree_.size();
+}
+
+template<class Key, class Tree>
+typename KeySet<Key, Tree>::iterator KeySet<Key, Tree>::begin() const
+{
+    return iterator(tree_.begin());
+}
+
+template<class Key, class Tree>
+typename KeySet<Key, Tree>::iterator KeySet<Key, Tree>::end() const
+{
+    return iterator(tree_.end());
+}
+
+template<class Key, class Tree>
+typename KeySet<Key, Tree>::iterator KeySet<Key, Tree>::find(const Key& key) const
+{
+    return iterator(tree_.find(key));
+}
+
+
+#endif
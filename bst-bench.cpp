@@ -0,0 +1,486 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bst.h"
+#include "avlbst.h"
+#include "rbbst.h"
+#include "splaybst.h"
+#include "sgbst.h"
+#include "aggavlbst.h"
+#include "intervalbst.h"
+#include "strbst.h"
+#include "hashavlbst.h"
+#include "linkedavlbst.h"
+#include "staticmap.h"
+#include "shardedmap.h"
+#include "combiningmap.h"
+#include "pagedmap.h"
+#include "durablemap.h"
+
+/**
+* Times each tree and option against the plain structure it is meant to
+* beat, printing nanoseconds per operation. The optional argument scales
+* the number of keys (default 100000); run it from an optimized build,
+* as `make bench` does.
+*/
+
+static size_t n = 100000;
+static long sink = 0; //keeps results alive so lookups are not optimized away
+
+template<class F>
+double timeNs(size_t ops, F f)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / std::max<size_t>(ops, 1);
+}
+
+void report(const std::string& name, double ns)
+{
+    std::printf("  %-44s %10.1f ns/op\n", name.c_str(), ns);
+}
+
+std::vector<int> shuffledKeys(size_t count, unsigned seed)
+{
+    std::vector<int> keys(count);
+    for(size_t i = 0; i < count; ++i) {
+        keys[i] = static_cast<int>(i);
+    }
+    std::mt19937 rng(seed);
+    std::shuffle(keys.begin(), keys.end(), rng);
+    return keys;
+}
+
+/**
+* Inserts shuffled keys, looks each one up, then removes them all.
+*/
+template<class Tree>
+void benchMix(const std::string& name)
+{
+    std::vector<int> keys = shuffledKeys(n, 1);
+    Tree t;
+    report(name + " insert", timeNs(n, [&] {
+        for(size_t i = 0; i < n; ++i) t.insert(std::make_pair(keys[i], keys[i]));
+    }));
+    report(name + " find", timeNs(n, [&] {
+        for(size_t i = 0; i < n; ++i) sink += t.find(keys[i])->second;
+    }));
+    report(name + " remove", timeNs(n, [&] {
+        for(size_t i = 0; i < n; ++i) t.remove(keys[i]);
+    }));
+}
+
+void benchTrees()
+{
+    std::cout << "balanced trees, shuffled keys" << std::endl;
+    benchMix<BinarySearchTree<int, int> >("BinarySearchTree");
+    benchMix<AVLTree<int, int> >("AVLTree");
+    benchMix<RedBlackTree<int, int> >("RedBlackTree");
+    benchMix<ScapegoatTree<int, int> >("ScapegoatTree");
+    benchMix<SplayTree<int, int> >("SplayTree");
+
+    std::vector<int> keys = shuffledKeys(n, 2);
+    std::map<int, int> m;
+    report("std::map insert", timeNs(n, [&] {
+        for(size_t i = 0; i < n; ++i) m[keys[i]] = keys[i];
+    }));
+    report("std::map find", timeNs(n, [&] {
+        for(size_t i = 0; i < n; ++i) sink += m.find(keys[i])->second;
+    }));
+
+    std::cout << "skewed lookups, 90% on 100 keys" << std::endl;
+    AVLTree<int, int> avl;
+    SplayTree<int, int> splay;
+    BinarySearchTree<int, int> optimal;
+    for(size_t i = 0; i < n; ++i) {
+        avl.insert(std::make_pair(keys[i], 0));
+        splay.insert(std::make_pair(keys[i], 0));
+        optimal.insert(std::make_pair(keys[i], 0));
+    }
+    std::mt19937 rng(3);
+    std::vector<int> hot(4 * n);
+    for(size_t i = 0; i < hot.size(); ++i) {
+        hot[i] = (rng() % 10) ? keys[rng() % 100] : keys[rng() % n];
+    }
+    report("AVLTree find", timeNs(hot.size(), [&] {
+        for(size_t i = 0; i < hot.size(); ++i) sink += avl.find(hot[i])->second;
+    }));
+    report("SplayTree find", timeNs(hot.size(), [&] {
+        for(size_t i = 0; i < hot.size(); ++i) sink += splay.find(hot[i])->second;
+    }));
+    optimal.setProfiling(1);
+    for(size_t i = 0; i < n; ++i) {
+        optimal.find(hot[i]);
+    }
+    optimal.setProfiling(0);
+    optimal.rebuildOptimal();
+    report("BinarySearchTree after rebuildOptimal find", timeNs(hot.size(), [&] {
+        for(size_t i = 0; i < hot.size(); ++i) sink += optimal.find(hot[i])->second;
+    }));
+}
+
+void benchStrings()
+{
+    std::cout << "URL keys with a shared prefix" << std::endl;
+    std::vector<int> ids = shuffledKeys(n, 4);
+    std::vector<std::string> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] = "https://example.com/items/" + std::to_string(ids[i]);
+    }
+    AVLTree<std::string, int> plain;
+    StringAVLTree<int> packed;
+    report("AVLTree<string> insert", timeNs(n, [&] {
+        for(size_t i = 0; i < n; ++i) plain.insert(std::make_pair(keys[i], 0));
+    }));
+    report("StringAVLTree insert", timeNs(n, [&] {
+        for(size_t i = 0; i < n; ++i) packed.insert(std::make_pair(keys[i], 0));
+    }));
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(5));
+    report("AVLTree<string> find", timeNs(n, [&] {
+        for(size_t i = 0; i < n; ++i) sink += plain.find(keys[i])->second;
+    }));
+    report("StringAVLTree find", timeNs(n, [&] {
+        for(size_t i = 0; i < n; ++i) sink += packed.find(keys[i])->second;
+    }));
+}
+
+void benchRemoval()
+{
+    std::cout << "removal: eager, tombstones, range erase" << std::endl;
+    std::vector<int> keys = shuffledKeys(n, 6);
+    const double ratios[] = { 0, 0.5, 0.95 };
+    for(int r = 0; r < 3; ++r) {
+        AVLTree<int, int> t;
+        for(size_t i = 0; i < n; ++i) {
+            t.insert(std::make_pair(keys[i], 0));
+        }
+        if(ratios[r] > 0) {
+            t.setTombstones(true, ratios[r]);
+        }
+        std::mt19937 rng(7);
+        std::deque<int> removed;
+        report("AVLTree churn, tombstones " + std::to_string(ratios[r]).substr(0, 4), timeNs(2 * n, [&] {
+            for(size_t i = 0; i < 2 * n; ++i) {
+                int k = rng() % n;
+                t.remove(k);
+                removed.push_back(k);
+                if(removed.size() > 1000) {
+                    t.insert(std::make_pair(removed.front(), 1));
+                    removed.pop_front();
+                }
+            }
+        }));
+    }
+
+    AVLTree<int, int> one, range;
+    for(size_t i = 0; i < n; ++i) {
+        one.insert(std::make_pair(keys[i], 0));
+        range.insert(std::make_pair(keys[i], 0));
+    }
+    int lo = static_cast<int>(n / 4), hi = static_cast<int>(3 * n / 4);
+    report("remove() each key of half the tree", timeNs(hi - lo, [&] {
+        for(int k = lo; k < hi; ++k) one.remove(k);
+    }));
+    report("eraseRange() over half the tree", timeNs(hi - lo, [&] {
+        range.eraseRange(lo, hi - 1);
+    }));
+}
+
+void benchBuild()
+{
+    std::cout << "bulk construction" << std::endl;
+    std::vector<int> keys = shuffledKeys(n, 8);
+    std::vector<std::pair<int, int> > items(n);
+    for(size_t i = 0; i < n; ++i) {
+        items[i] = std::make_pair(keys[i], keys[i]);
+    }
+    AVLTree<int, int> inserted;
+    report("AVLTree insert loop", timeNs(n, [&] {
+        for(size_t i = 0; i < n; ++i) inserted.insert(items[i]);
+    }));
+    for(size_t threads = 1; threads <= 4; threads *= 2) {
+        AVLTree<int, int> built;
+        report("AVLTree buildFrom, " + std::to_string(threads) + " threads", timeNs(n, [&] {
+            built.buildFrom(items.begin(), items.end(), threads);
+        }));
+    }
+
+    AVLTree<int, int>& t = inserted;
+    WorkStealingPool pool(4);
+    report("serial sum over iterators", timeNs(n, [&] {
+        for(AVLTree<int, int>::iterator it = t.begin(); it != t.end(); ++it) sink += it->second;
+    }));
+    report("parallelReduce sum, 4 workers", timeNs(n, [&] {
+        sink += t.parallelReduce(0L, [](const std::pair<const int, int>& item) { return static_cast<long>(item.second); },
+            [](long a, long b) { return a + b; }, 4096, pool);
+    }));
+}
+
+void benchLookups()
+{
+    std::cout << "point and nearby lookups" << std::endl;
+    std::vector<int> keys = shuffledKeys(n, 9);
+    AVLTree<int, int> avl, filtered;
+    HashedAVLTree<int, int> hashed;
+    for(size_t i = 0; i < n; ++i) {
+        avl.insert(std::make_pair(2 * keys[i], 0));
+        filtered.insert(std::make_pair(2 * keys[i], 0));
+        hashed.insert(std::make_pair(2 * keys[i], 0));
+    }
+    filtered.setFilter(true, 10.0);
+    report("AVLTree find, hits", timeNs(n, [&] {
+        for(size_t i = 0; i < n; ++i) sink += avl.find(2 * keys[i])->second;
+    }));
+    report("HashedAVLTree find, hits", timeNs(n, [&] {
+        for(size_t i = 0; i < n; ++i) sink += hashed.find(2 * keys[i])->second;
+    }));
+    report("AVLTree find, misses", timeNs(n, [&] {
+        for(size_t i = 0; i < n; ++i) sink += (avl.find(2 * keys[i] + 1) == avl.end());
+    }));
+    report("AVLTree with Bloom filter find, misses", timeNs(n, [&] {
+        for(size_t i = 0; i < n; ++i) sink += (filtered.find(2 * keys[i] + 1) == filtered.end());
+    }));
+
+    //each lookup is a few keys past the previous one
+    AVLTree<int, int>::Finger finger = avl.finger();
+    report("AVLTree find, ascending nearby keys", timeNs(n, [&] {
+        for(size_t i = 0; i < n; ++i) sink += avl.find(static_cast<int>(2 * i))->second;
+    }));
+    report("Finger find, ascending nearby keys", timeNs(n, [&] {
+        for(size_t i = 0; i < n; ++i) sink += finger.find(static_cast<int>(2 * i))->second;
+    }));
+
+    static const size_t staticSize = 4096;
+    static std::pair<int, int> items[staticSize];
+    AVLTree<int, int> small;
+    for(size_t i = 0; i < staticSize; ++i) {
+        items[i] = std::make_pair(keys[i], 0);
+        small.insert(items[i]);
+    }
+    StaticMap<int, int, staticSize> fixed(items);
+    report("AVLTree find, 4096 keys", timeNs(n, [&] {
+        for(size_t i = 0; i < n; ++i) sink += small.find(keys[i % staticSize])->second;
+    }));
+    report("StaticMap find, 4096 keys", timeNs(n, [&] {
+        for(size_t i = 0; i < n; ++i) sink += fixed.find(keys[i % staticSize])->second;
+    }));
+}
+
+void benchScans()
+{
+    std::cout << "ordered scans and range queries" << std::endl;
+    std::vector<int> keys = shuffledKeys(n, 10);
+    AVLTree<int, int> avl;
+    LinkedAVLTree<int, int> linked;
+    AggregateAVLTree<int, long> aggregate;
+    for(size_t i = 0; i < n; ++i) {
+        avl.insert(std::make_pair(keys[i], 1));
+        linked.insert(std::make_pair(keys[i], 1));
+        aggregate.insert(std::make_pair(keys[i], 1L));
+    }
+    report("AVLTree full scan, per item", timeNs(10 * n, [&] {
+        for(int r = 0; r < 10; ++r)
+            for(AVLTree<int, int>::iterator it = avl.begin(); it != avl.end(); ++it) sink += it->second;
+    }));
+    report("LinkedAVLTree full scan, per item", timeNs(10 * n, [&] {
+        for(int r = 0; r < 10; ++r)
+            for(LinkedAVLTree<int, int>::iterator it = linked.begin(); it != linked.end(); ++it) sink += it->second;
+    }));
+
+    const size_t queries = 1000;
+    std::mt19937 rng(11);
+    std::vector<int> starts(queries);
+    for(size_t i = 0; i < queries; ++i) {
+        starts[i] = rng() % n;
+    }
+    int width = static_cast<int>(n / 10);
+    report("sum over a 10% range by iterating, per query", timeNs(queries, [&] {
+        for(size_t i = 0; i < queries; ++i)
+            for(AVLTree<int, int>::iterator it = avl.lowerBound(starts[i]); it != avl.end() && it->first < starts[i] + width; ++it)
+                sink += it->second;
+    }));
+    report("AggregateAVLTree rangeAggregate, per query", timeNs(queries, [&] {
+        for(size_t i = 0; i < queries; ++i) sink += aggregate.rangeAggregate(starts[i], starts[i] + width - 1);
+    }));
+
+    IntervalTree<int, int> intervals;
+    std::vector<std::pair<int, int> > list;
+    for(size_t i = 0; i < n; ++i) {
+        int lo = rng() % (100 * n);
+        int hi = lo + rng() % 1000;
+        intervals.insert(lo, hi, 0);
+        list.push_back(std::make_pair(lo, hi));
+    }
+    std::vector<const IntervalTree<int, int>::Item*> found;
+    report("overlap query by scanning every interval", timeNs(queries / 10, [&] {
+        for(size_t i = 0; i < queries / 10; ++i)
+            for(size_t j = 0; j < list.size(); ++j)
+                sink += (list[j].second >= starts[i] * 100 && list[j].first <= starts[i] * 100 + 5000);
+    }));
+    report("IntervalTree overlapping", timeNs(queries, [&] {
+        for(size_t i = 0; i < queries; ++i) {
+            found.clear();
+            intervals.overlapping(starts[i] * 100, starts[i] * 100 + 5000, found);
+            sink += found.size();
+        }
+    }));
+}
+
+void benchNodeHandles()
+{
+    std::cout << "moving entries between trees" << std::endl;
+    std::vector<int> keys = shuffledKeys(n, 12);
+    AVLTree<int, std::string> a, b, c, d, e, f;
+    for(size_t i = 0; i < n; ++i) {
+        a.insert(std::make_pair(keys[i], std::string(40, 'v')));
+        c.insert(std::make_pair(keys[i], std::string(40, 'v')));
+        e.insert(std::make_pair(keys[i], std::string(40, 'v')));
+    }
+    report("find, copy, remove and insert", timeNs(n, [&] {
+        for(size_t i = 0; i < n; ++i) {
+            std::pair<const int, std::string> item(keys[i], a.find(keys[i])->second);
+            a.remove(keys[i]);
+            b.insert(item);
+        }
+    }));
+    report("extract and insert the node handle", timeNs(n, [&] {
+        for(size_t i = 0; i < n; ++i) d.insert(c.extract(keys[i]));
+    }));
+    report("merge", timeNs(n, [&] {
+        f.merge(e);
+    }));
+}
+
+void benchConcurrent()
+{
+    std::cout << "4 threads, 80% finds" << std::endl;
+    const int threads = 4;
+    size_t ops = 4 * n;
+    AVLTree<int, int> single;
+    std::shared_mutex lock;
+    ShardedAVLMap<int, int> sharded(4096);
+    CombiningAVLMap<int, int> combining(threads);
+    for(size_t i = 0; i < n; ++i) {
+        single.insert(std::make_pair(static_cast<int>(2 * i), 0));
+        sharded.insert(std::make_pair(static_cast<int>(2 * i), 0));
+        combining.insert(std::make_pair(static_cast<int>(2 * i), 0));
+    }
+    auto run = [&](auto op) {
+        return timeNs(ops, [&] {
+            std::vector<std::thread> workers;
+            for(int t = 0; t < threads; ++t) {
+                workers.push_back(std::thread([&op, t, ops, threads] {
+                    std::mt19937 rng(t);
+                    for(size_t i = 0; i < ops / threads; ++i) {
+                        op(static_cast<int>(rng() % (2 * n)), rng() % 10);
+                    }
+                }));
+            }
+            for(size_t t = 0; t < workers.size(); ++t) {
+                workers[t].join();
+            }
+        });
+    };
+    report("AVLTree behind one shared_mutex", run([&](int k, unsigned op) {
+        if(op < 8) {
+            std::shared_lock<std::shared_mutex> guard(lock);
+            sink += (single.find(k) != single.end());
+        }
+        else {
+            std::unique_lock<std::shared_mutex> guard(lock);
+            if(op == 8) single.insert(std::make_pair(k, k));
+            else single.remove(k);
+        }
+    }));
+    report("ShardedAVLMap", run([&](int k, unsigned op) {
+        int v;
+        if(op < 8) sink += sharded.find(k, v);
+        else if(op == 8) sharded.insert(std::make_pair(k, k));
+        else sharded.erase(k);
+    }));
+    report("CombiningAVLMap", run([&](int k, unsigned op) {
+        int v;
+        if(op < 8) sink += combining.find(k, v);
+        else if(op == 8) combining.insert(std::make_pair(k, k));
+        else combining.erase(k);
+    }));
+}
+
+void benchStorage()
+{
+    std::cout << "on-disk maps" << std::endl;
+    std::filesystem::path tmp = std::filesystem::temp_directory_path();
+    std::string path = (tmp / "bst-bench-paged.db").string();
+    std::filesystem::remove(path);
+    std::vector<int> keys = shuffledKeys(n, 13);
+    {
+        PagedBTree<int, long> paged(path, 1 << 20);
+        report("PagedBTree insert, 1 MB pool", timeNs(n, [&] {
+            for(size_t i = 0; i < n; ++i) paged.insert(std::make_pair(keys[i], static_cast<long>(i)));
+        }));
+        report("PagedBTree find, 1 MB pool", timeNs(n, [&] {
+            for(size_t i = 0; i < n; ++i) sink += paged.find(keys[i])->second;
+        }));
+        report("PagedBTree full scan, per item", timeNs(n, [&] {
+            for(PagedBTree<int, long>::iterator it = paged.begin(); it != paged.end(); ++it) sink += it->second;
+        }));
+    }
+    std::filesystem::remove(path);
+
+    //fsync dominates, so this uses far fewer records
+    std::string dir = (tmp / "bst-bench-durable").string();
+    const char* names[] = { "SYNC_EACH", "SYNC_GROUP", "SYNC_NONE" };
+    typedef DurableAVLMap<int, long> Map;
+    for(int mode = 0; mode < 3; ++mode) {
+        for(int threads = 1; threads <= 8; threads *= 8) {
+            std::filesystem::remove_all(dir);
+            Map::Options options;
+            options.sync = static_cast<Map::SyncMode>(mode);
+            Map m(dir, options);
+            size_t records = (mode == 2) ? n : std::max<size_t>(n / 100, 200);
+            report(std::string("DurableAVLMap insert, ") + names[mode] + ", " + std::to_string(threads) + " threads",
+                timeNs(records, [&] {
+                    std::vector<std::thread> writers;
+                    for(int t = 0; t < threads; ++t) {
+                        writers.push_back(std::thread([&m, t, threads, records] {
+                            for(size_t i = 0; i < records / threads; ++i) m.insert(std::make_pair(t * 1000000 + static_cast<int>(i), 0L));
+                        }));
+                    }
+                    for(size_t t = 0; t < writers.size(); ++t) {
+                        writers[t].join();
+                    }
+                }));
+        }
+    }
+    std::filesystem::remove_all(dir);
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc > 1) {
+        n = std::max(1000L, std::atol(argv[1]));
+    }
+    std::cout << n << " keys" << std::endl;
+    benchTrees();
+    benchStrings();
+    benchRemoval();
+    benchBuild();
+    benchLookups();
+    benchScans();
+    benchNodeHandles();
+    benchConcurrent();
+    benchStorage();
+    return sink == 42 ? 1 : 0;
+}
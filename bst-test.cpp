@@ -0,0 +1,1241 @@
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <limits>
+#include <map>
+#include <memory_resource>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "bst.h"
+#include "avlbst.h"
+#include "rbbst.h"
+#include "splaybst.h"
+#include "sgbst.h"
+#include "aggavlbst.h"
+#include "intervalbst.h"
+#include "strbst.h"
+#include "hashavlbst.h"
+#include "linkedavlbst.h"
+#include "avlset.h"
+#include "bloomfilter.h"
+#include "staticmap.h"
+#include "shardedmap.h"
+#include "combiningmap.h"
+#include "pagedmap.h"
+
+/**
+* Randomized checks of every tree and map in this directory against
+* std::map (or std::set), plus the structural invariants of each tree:
+* parent links and key order everywhere, and the balance rules of the
+* AVL and red-black trees. Prints each failed check and exits non-zero
+* if there was one.
+*/
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if(!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl; \
+            ++failures; \
+        } \
+    } while(0)
+
+#define CHECK_THROWS(expr, type) \
+    do { \
+        bool thrown = false; \
+        try { expr; } \
+        catch(type&) { thrown = true; } \
+        CHECK(thrown && #expr " throws " #type); \
+    } while(0)
+
+/**
+* Opens up the root of any of the trees for the invariant checks.
+*/
+template <class Tree>
+struct Open : public Tree
+{
+    using Tree::Tree;
+    using Tree::root_;
+};
+
+/**
+* Checks parent links and key order below node and returns the number of
+* nodes, tombstones included.
+*/
+template<class Key, class Value>
+size_t checkLinks(Node<Key, Value>* node, Node<Key, Value>* parent, const Key* lo, const Key* hi)
+{
+    if(node == NULL) {
+        return 0;
+    }
+    CHECK(node->getParent() == parent);
+    CHECK(lo == NULL || *lo < node->getKey());
+    CHECK(hi == NULL || node->getKey() < *hi);
+    return 1 + checkLinks(node->getLeft(), node, lo, &node->getKey()) +
+        checkLinks(node->getRight(), node, &node->getKey(), hi);
+}
+
+/**
+* Checks every stored balance factor and the AVL bound, returning the height.
+*/
+template<class Key, class Value>
+int checkAVL(AVLNode<Key, Value>* node)
+{
+    if(node == NULL) {
+        return 0;
+    }
+    int left = checkAVL(node->getLeft());
+    int right = checkAVL(node->getRight());
+    CHECK(node->getBalance() == right - left);
+    CHECK(right - left <= 1 && left - right <= 1);
+    return 1 + std::max(left, right);
+}
+
+/**
+* Checks that no red node has a red child and that every path has the
+* same number of black nodes, returning that number.
+*/
+template<class Key, class Value>
+int checkRB(RBNode<Key, Value>* node)
+{
+    if(node == NULL) {
+        return 1;
+    }
+    if(node->isRed()) {
+        CHECK(node->getLeft() == NULL || !node->getLeft()->isRed());
+        CHECK(node->getRight() == NULL || !node->getRight()->isRed());
+    }
+    int left = checkRB(node->getLeft());
+    int right = checkRB(node->getRight());
+    CHECK(left == right);
+    return left + (node->isRed() ? 0 : 1);
+}
+
+template<class Key, class Value>
+size_t checkLinks(Node<Key, Value>* root)
+{
+    return checkLinks(root, static_cast<Node<Key, Value>*>(NULL), static_cast<const Key*>(NULL), static_cast<const Key*>(NULL));
+}
+
+/**
+* Checks the links and order of any tree, and the balance rules of the
+* AVL and red-black trees and everything derived from them.
+*/
+template<class Tree, class Key, class Value>
+void checkShape(const Tree& t, Node<Key, Value>* root)
+{
+    checkLinks(root);
+    if constexpr(std::is_base_of<AVLTree<Key, Value>, Tree>::value) {
+        CHECK(checkAVL(static_cast<AVLNode<Key, Value>*>(root)) == t.height());
+    }
+    else if constexpr(std::is_base_of<RedBlackTree<Key, Value>, Tree>::value) {
+        RBNode<Key, Value>* rb = static_cast<RBNode<Key, Value>*>(root);
+        CHECK(rb == NULL || !rb->isRed());
+        checkRB(rb);
+    }
+}
+
+template<class Tree>
+void checkShape(Open<Tree>& t)
+{
+    checkShape(static_cast<const Tree&>(t), t.root_);
+}
+
+/**
+* Checks size, contents in key order and the cached smallest and
+* largest keys against ref.
+*/
+template<class Tree, class Key, class Value>
+void checkSame(const Tree& t, const std::map<Key, Value>& ref)
+{
+    CHECK(t.size() == ref.size());
+    CHECK(t.empty() == ref.empty());
+    auto it = t.begin();
+    for(typename std::map<Key, Value>::const_iterator r = ref.begin(); r != ref.end(); ++r) {
+        CHECK(it != t.end());
+        if(it == t.end()) {
+            return;
+        }
+        CHECK(it->first == r->first && it->second == r->second);
+        ++it;
+    }
+    CHECK(it == t.end());
+    auto stats = t.stats();
+    if(ref.empty()) {
+        CHECK(stats.minKey == NULL && stats.maxKey == NULL);
+    }
+    else {
+        CHECK(stats.minKey != NULL && *stats.minKey == ref.begin()->first);
+        CHECK(stats.maxKey != NULL && *stats.maxKey == ref.rbegin()->first);
+    }
+}
+
+/**
+* Runs a random mix of every point and range operation on t and ref,
+* comparing results as it goes and the whole tree every so often.
+*/
+template<class Tree>
+void randomOps(Open<Tree>& t, unsigned seed, int ops = 30000, int keys = 2000)
+{
+    std::mt19937 rng(seed);
+    std::map<int, int> ref;
+    const Tree& c = t;
+    for(int i = 0; i < ops; ++i) {
+        int k = rng() % keys;
+        switch(rng() % 10) {
+        case 0: case 1: case 2: case 3:
+            t.insert(std::make_pair(k, i));
+            ref[k] = i;
+            break;
+        case 4:
+            t.remove(k);
+            ref.erase(k);
+            break;
+        case 5: {
+            auto it = t.find(k);
+            CHECK((it == t.end()) == (ref.count(k) == 0));
+            if(ref.count(k) != 0) {
+                CHECK(it != t.end() && it->second == ref[k]);
+                CHECK(c[k] == ref[k]);
+            }
+            else {
+                CHECK_THROWS(c[k], std::out_of_range);
+            }
+            break;
+        }
+        case 6: {
+            auto it = t.find(k);
+            if(it != t.end()) {
+                auto next = t.erase(it);
+                std::map<int, int>::iterator r = ref.erase(ref.find(k));
+                CHECK((next == t.end()) == (r == ref.end()));
+                CHECK(r == ref.end() || next->first == r->first);
+            }
+            break;
+        }
+        case 7: {
+            int hi = k + rng() % 60;
+            size_t erased = t.eraseRange(k, hi);
+            size_t expected = 0;
+            std::map<int, int>::iterator r = ref.lower_bound(k);
+            while(r != ref.end() && r->first <= hi) {
+                r = ref.erase(r);
+                ++expected;
+            }
+            CHECK(erased == expected);
+            break;
+        }
+        case 8: {
+            auto first = t.lowerBound(k);
+            auto last = first;
+            for(int n = rng() % 20; n > 0 && last != t.end(); --n) {
+                ++last;
+            }
+            std::map<int, int>::iterator rfirst = ref.lower_bound(k);
+            std::map<int, int>::iterator rlast = (last == t.end()) ? ref.end() : ref.find(last->first);
+            auto next = t.erase(first, last);
+            ref.erase(rfirst, rlast);
+            CHECK(next == last);
+            break;
+        }
+        default: {
+            auto it = t.lowerBound(k);
+            std::map<int, int>::iterator r = ref.lower_bound(k);
+            CHECK((it == t.end()) == (r == ref.end()));
+            CHECK(r == ref.end() || (it != t.end() && it->first == r->first));
+            break;
+        }
+        }
+        if(i % 2000 == 0) {
+            checkSame(c, ref);
+            checkShape(t);
+        }
+    }
+    checkSame(c, ref);
+    checkShape(t);
+}
+
+void testTrees()
+{
+    { Open<BinarySearchTree<int, int> > t; randomOps(t, 1); }
+    { Open<AVLTree<int, int> > t; randomOps(t, 2); }
+    { Open<RedBlackTree<int, int> > t; randomOps(t, 3); }
+    { Open<SplayTree<int, int> > t; randomOps(t, 4); }
+    { Open<ScapegoatTree<int, int> > t; randomOps(t, 5); }
+    { Open<AggregateAVLTree<int, int> > t; randomOps(t, 6); }
+    { Open<HashedAVLTree<int, int> > t; randomOps(t, 7); }
+    { Open<LinkedAVLTree<int, int> > t; randomOps(t, 8); }
+    {
+        Open<AVLTree<int, int> > t;
+        t.setTombstones(true, 0.3);
+        randomOps(t, 9);
+        CHECK(t.deadRatio() <= 0.3 + 1e-9);
+        t.compact();
+        CHECK(t.deadCount() == 0);
+    }
+    {
+        Open<HashedAVLTree<int, int> > t;
+        t.setTombstones(true, 0.4);
+        randomOps(t, 10);
+    }
+    {
+        Open<LinkedAVLTree<int, int> > t;
+        t.setTombstones(true, 0.4);
+        randomOps(t, 11);
+    }
+    {
+        Open<AVLTree<int, int> > t;
+        t.setFilter(true, 8);
+        randomOps(t, 12);
+        CHECK(t.filterStats().keys >= t.size());
+    }
+    {
+        //sorted input is the worst case for the unbalanced and scapegoat trees
+        Open<ScapegoatTree<int, int> > t;
+        for(int i = 0; i < 20000; ++i) {
+            t.insert(std::make_pair(i, i));
+        }
+        CHECK(t.height() <= 2 + static_cast<int>(std::log(20001.0) / std::log(1 / 0.7)));
+        checkShape(t);
+    }
+}
+
+void testStrings()
+{
+    std::mt19937 rng(21);
+    Open<StringAVLTree<int> > t;
+    std::map<std::string, int> ref;
+    for(int i = 0; i < 30000; ++i) {
+        std::string k = (rng() % 5 ? "https://example.com/" : "") + std::to_string(rng() % 3000);
+        if(rng() % 50 == 0) {
+            k = std::string("https://example.com/\0x", 22);
+        }
+        if(rng() % 3) {
+            t.insert(std::make_pair(k, i));
+            ref[k] = i;
+        }
+        else {
+            t.remove(k);
+            ref.erase(k);
+        }
+        std::string q = "https://example.com/" + std::to_string(rng() % 3000);
+        CHECK((t.find(q) == t.end()) == (ref.count(q) == 0));
+    }
+    checkSame(static_cast<const StringAVLTree<int>&>(t), ref);
+    checkShape(t);
+}
+
+struct Concat
+{
+    static std::string identity() { return ""; }
+    static std::string combine(const std::string& a, const std::string& b) { return a + b; }
+};
+
+void testAggregates()
+{
+    std::mt19937 rng(31);
+    AggregateAVLTree<int, long> sum;
+    AggregateAVLTree<int, int, MinAggregate<int> > min;
+    AggregateAVLTree<int, std::string, Concat> concat;
+    sum.setTombstones(true, 0.5);
+    std::map<int, long> ref;
+    for(int i = 0; i < 40000; ++i) {
+        int k = rng() % 2000;
+        long v = rng() % 1000;
+        int op = rng() % 5;
+        if(op < 2) {
+            sum.insert(std::make_pair(k, v));
+            min.insert(std::make_pair(k, static_cast<int>(v)));
+            concat.insert(std::make_pair(k, std::to_string(v) + ","));
+            ref[k] = v;
+        }
+        else if(op == 2) {
+            sum.remove(k);
+            min.remove(k);
+            concat.remove(k);
+            ref.erase(k);
+        }
+        else if(op == 3 && ref.count(k) != 0) {
+            sum.setValue(k, v);
+            min.setValue(k, static_cast<int>(v));
+            concat.setValue(k, std::to_string(v) + ",");
+            ref[k] = v;
+        }
+        else if(op == 4) {
+            int hi = k + rng() % 40;
+            sum.eraseRange(k, hi);
+            min.eraseRange(k, hi);
+            concat.eraseRange(k, hi);
+            ref.erase(ref.lower_bound(k), ref.upper_bound(hi));
+        }
+        if(i % 500 == 0) {
+            int lo = static_cast<int>(rng() % 2100) - 50;
+            int hi = lo + rng() % 800;
+            long s = 0;
+            int m = std::numeric_limits<int>::max();
+            std::string cat;
+            for(std::map<int, long>::iterator r = ref.lower_bound(lo); r != ref.end() && r->first <= hi; ++r) {
+                s += r->second;
+                m = std::min(m, static_cast<int>(r->second));
+                cat += std::to_string(r->second) + ",";
+            }
+            CHECK(sum.rangeAggregate(lo, hi) == s);
+            CHECK(min.rangeAggregate(lo, hi) == m);
+            CHECK(concat.rangeAggregate(lo, hi) == cat);
+        }
+    }
+    CHECK_THROWS(sum.setValue(-1, 0), std::out_of_range);
+
+    //reads go through const iterators, and erase through them keeps the aggregates
+    long s = 0;
+    for(AggregateAVLTree<int, long>::const_iterator it = sum.begin(); it != sum.end(); ++it) {
+        s += it->second;
+    }
+    CHECK(s == sum.rangeAggregate(std::numeric_limits<int>::min(), std::numeric_limits<int>::max()));
+    if(!ref.empty()) {
+        int k = ref.begin()->first;
+        sum.erase(sum.find(k));
+        CHECK(sum.rangeAggregate(std::numeric_limits<int>::min(), std::numeric_limits<int>::max()) == s - ref[k]);
+    }
+}
+
+void testIntervals()
+{
+    typedef IntervalTree<int, int> Tree;
+    std::mt19937 rng(41);
+    Tree t;
+    std::map<std::pair<int, int>, int> ref;
+    for(int i = 0; i < 20000; ++i) {
+        int lo = rng() % 10000;
+        int hi = lo + rng() % 300;
+        if(rng() % 3) {
+            t.insert(lo, hi, i);
+            ref[std::make_pair(lo, hi)] = i;
+        }
+        else {
+            std::map<std::pair<int, int>, int>::iterator it = ref.lower_bound(std::make_pair(lo, 0));
+            if(it != ref.end()) {
+                t.remove(it->first);
+                ref.erase(it);
+            }
+        }
+        if(i % 500 != 0) {
+            continue;
+        }
+        int a = rng() % 10500;
+        int b = a + rng() % 200;
+        std::vector<const Tree::Item*> overlapping, stabbing, containing, within;
+        t.overlapping(a, b, overlapping);
+        t.stabbing(a, stabbing);
+        t.containing(a, b, containing);
+        t.within(a, b, within);
+        std::vector<std::pair<int, int> > eo, es, ec, ew;
+        for(std::map<std::pair<int, int>, int>::iterator it = ref.begin(); it != ref.end(); ++it) {
+            std::pair<int, int> k = it->first;
+            if(k.second >= a && k.first <= b) eo.push_back(k);
+            if(k.first <= a && k.second >= a) es.push_back(k);
+            if(k.first <= a && k.second >= b) ec.push_back(k);
+            if(k.first >= a && k.second <= b) ew.push_back(k);
+        }
+        const std::vector<const Tree::Item*>* got[] = { &overlapping, &stabbing, &containing, &within };
+        const std::vector<std::pair<int, int> >* expected[] = { &eo, &es, &ec, &ew };
+        for(int q = 0; q < 4; ++q) {
+            CHECK(got[q]->size() == expected[q]->size());
+            for(size_t j = 0; j < got[q]->size() && j < expected[q]->size(); ++j) {
+                CHECK((*got[q])[j]->first == (*expected[q])[j]);
+            }
+        }
+    }
+
+    //an inverted interval is rejected on every path in
+    size_t before = t.size();
+    CHECK_THROWS(t.insert(9, 2, 0), std::out_of_range);
+    CHECK_THROWS(t.insert(std::make_pair(std::make_pair(9, 2), 0)), std::out_of_range);
+    AVLTree<std::pair<int, int>, int>& base = t;
+    CHECK_THROWS(base.insert(std::make_pair(std::make_pair(9, 2), 0)), std::out_of_range);
+    CHECK(t.size() == before);
+    std::vector<std::pair<std::pair<int, int>, int> > items;
+    items.push_back(std::make_pair(std::make_pair(1, 5), 0));
+    items.push_back(std::make_pair(std::make_pair(9, 2), 0));
+    CHECK_THROWS(t.buildFrom(items.begin(), items.end()), std::out_of_range);
+    CHECK(t.empty());
+}
+
+/**
+* Cuts a random tree at a random key and glues it back, for each kind
+* of tree that overrides splitAt and concat.
+*/
+template<class Tree>
+void splitAndConcat(unsigned seed)
+{
+    std::mt19937 rng(seed);
+    for(int round = 0; round < 100; ++round) {
+        Open<Tree> a, b;
+        std::map<int, int> ref;
+        if(round % 2) {
+            a.setTombstones(true, 0.5);
+        }
+        for(int n = rng() % 500; n > 0; --n) {
+            int k = rng() % 1000;
+            a.insert(std::make_pair(k, k));
+            ref[k] = k;
+            if(rng() % 4 == 0) {
+                a.remove(k);
+                ref.erase(k);
+            }
+        }
+        int key = static_cast<int>(rng() % 1100) - 50;
+        size_t moved = a.splitAt(key, b);
+        std::map<int, int> upper(ref.lower_bound(key), ref.end());
+        ref.erase(ref.lower_bound(key), ref.end());
+        CHECK(moved == upper.size());
+        checkSame(static_cast<const Tree&>(a), ref);
+        checkSame(static_cast<const Tree&>(b), upper);
+        for(int k = -1; k < 1000; k += 7) {
+            CHECK((a.find(k) != a.end()) == (ref.count(k) != 0));
+            CHECK((b.find(k) != b.end()) == (upper.count(k) != 0));
+        }
+
+        AVLTree<int, int>& base = a;
+        base.concat(b);
+        ref.insert(upper.begin(), upper.end());
+        checkSame(static_cast<const Tree&>(a), ref);
+        CHECK(b.empty());
+        for(int k = -1; k < 1000; k += 7) {
+            CHECK((a.find(k) != a.end()) == (ref.count(k) != 0));
+        }
+        if(!ref.empty()) {
+            Tree c;
+            c.insert(std::make_pair(ref.begin()->first, 0));
+            CHECK_THROWS(a.concat(c), std::invalid_argument);
+        }
+    }
+}
+
+void testSplitConcat()
+{
+    splitAndConcat<AVLTree<int, int> >(51);
+    splitAndConcat<HashedAVLTree<int, int> >(52);
+    splitAndConcat<LinkedAVLTree<int, int> >(53);
+    splitAndConcat<AggregateAVLTree<int, int> >(54);
+
+    AVLTree<int, int> plain;
+    HashedAVLTree<int, int> hashed;
+    plain.insert(std::make_pair(1, 1));
+    CHECK_THROWS(plain.splitAt(0, hashed), std::invalid_argument);
+    CHECK_THROWS(hashed.concat(plain), std::invalid_argument);
+
+    StringAVLTree<int> s, upper;
+    std::map<std::string, int> ref;
+    for(int i = 0; i < 2000; ++i) {
+        std::string k = "https://example.com/" + std::to_string(i * 7919 % 3000);
+        s.insert(std::make_pair(k, i));
+        ref[k] = i;
+    }
+    s.splitAt("https://example.com/2", upper);
+    CHECK(s.size() + upper.size() == ref.size());
+    s.concat(upper);
+    checkSame(static_cast<const StringAVLTree<int>&>(s), ref);
+    for(std::map<std::string, int>::iterator it = ref.begin(); it != ref.end(); ++it) {
+        CHECK(s.find(it->first) != s.end());
+    }
+}
+
+void testBuildFrom()
+{
+    std::mt19937 rng(61);
+    for(int round = 0; round < 12; ++round) {
+        int n = (round == 0) ? 0 : rng() % 20000;
+        std::vector<std::pair<int, int> > items;
+        std::map<int, int> ref;
+        for(int i = 0; i < n; ++i) {
+            int k = rng() % (n / 2 + 1);
+            items.push_back(std::make_pair(k, i));
+            ref[k] = i;
+        }
+        Open<AVLTree<int, int> > t;
+        t.insert(std::make_pair(-5, 1));
+        t.buildFrom(items.begin(), items.end(), round % 3);
+        checkSame(static_cast<const AVLTree<int, int>&>(t), ref);
+        checkShape(t);
+
+        //nodes from the block are freed one by one as the tree changes
+        for(int i = 0; i < n; ++i) {
+            int k = rng() % (n + 1);
+            if(rng() % 2) {
+                t.remove(k);
+                ref.erase(k);
+            }
+            else {
+                t.insert(std::make_pair(k, i));
+                ref[k] = i;
+            }
+        }
+        t.eraseRange(n / 4, n / 2);
+        ref.erase(ref.lower_bound(n / 4), ref.upper_bound(n / 2));
+        checkSame(static_cast<const AVLTree<int, int>&>(t), ref);
+        checkShape(t);
+    }
+
+    AggregateAVLTree<int, long> a;
+    LinkedAVLTree<int, long> l;
+    HashedAVLTree<int, long> h;
+    std::vector<std::pair<int, long> > items;
+    std::map<int, long> ref;
+    for(int i = 0; i < 20000; ++i) {
+        int k = rng() % 10000;
+        items.push_back(std::make_pair(k, i));
+        ref[k] = i;
+    }
+    a.buildFrom(items.begin(), items.end(), 2);
+    l.buildFrom(items.begin(), items.end(), 2);
+    h.buildFrom(items.begin(), items.end(), 2);
+    checkSame(static_cast<const LinkedAVLTree<int, long>&>(l), ref);
+    long s = 0;
+    for(std::map<int, long>::iterator it = ref.begin(); it != ref.end(); ++it) {
+        s += it->second;
+        CHECK(h.find(it->first) != h.end());
+    }
+    CHECK(a.rangeAggregate(0, 10000) == s);
+}
+
+template<class Tree>
+void extractAndMerge(unsigned seed)
+{
+    std::mt19937 rng(seed);
+    Tree a, b;
+    std::map<int, int> ra, rb;
+    for(int i = 0; i < 20000; ++i) {
+        int k = rng() % 3000;
+        bool left = rng() % 2;
+        Tree& x = left ? a : b;
+        Tree& y = left ? b : a;
+        std::map<int, int>& rx = left ? ra : rb;
+        std::map<int, int>& ry = left ? rb : ra;
+        switch(rng() % 4) {
+        case 0: case 1:
+            x.insert(std::make_pair(k, i));
+            rx[k] = i;
+            break;
+        case 2: {
+            typename Tree::NodeHandle node = x.extract(k);
+            CHECK(node.empty() == (rx.count(k) == 0));
+            if(node.empty()) {
+                break;
+            }
+            CHECK(node.key() == k && node.value() == rx[k]);
+            rx.erase(k);
+            bool inserted = y.insert(std::move(node));
+            CHECK(inserted == node.empty());
+            CHECK(inserted == (ry.count(k) == 0));
+            if(inserted) {
+                ry[k] = node.empty() ? y.find(k)->second : 0;
+            }
+            break;
+        }
+        default: {
+            auto it = x.lowerBound(k);
+            if(it != x.end()) {
+                int key = it->first;
+                typename Tree::NodeHandle node = x.extract(it);
+                CHECK(node.key() == key);
+                rx.erase(key);
+            }
+            break;
+        }
+        }
+    }
+    checkSame(static_cast<const Tree&>(a), ra);
+    checkSame(static_cast<const Tree&>(b), rb);
+
+    a.merge(b);
+    for(std::map<int, int>::iterator it = rb.begin(); it != rb.end();) {
+        if(ra.count(it->first) == 0) {
+            ra.insert(*it);
+            it = rb.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    checkSame(static_cast<const Tree&>(a), ra);
+    checkSame(static_cast<const Tree&>(b), rb);
+}
+
+void testExtractMerge()
+{
+    extractAndMerge<AVLTree<int, int> >(71);
+    extractAndMerge<HashedAVLTree<int, int> >(72);
+    extractAndMerge<LinkedAVLTree<int, int> >(73);
+
+    AVLTree<int, int> a;
+    HashedAVLTree<int, int> h;
+    a.insert(std::make_pair(1, 1));
+    AVLTree<int, int>::NodeHandle node = a.extract(1);
+    CHECK_THROWS(h.insert(std::move(node)), std::invalid_argument);
+    CHECK(!node.empty());
+
+    std::pmr::unsynchronized_pool_resource pool;
+    AVLTree<int, int> other(&pool);
+    CHECK_THROWS(other.insert(std::move(node)), std::invalid_argument);
+    CHECK(a.insert(std::move(node)));
+    CHECK(a.find(1) != a.end());
+}
+
+void testFingers()
+{
+    std::mt19937 rng(81);
+    AVLTree<int, int> t;
+    std::map<int, int> ref;
+    AVLTree<int, int>::Finger f = t.finger();
+    for(int i = 0; i < 50000; ++i) {
+        int k = rng() % 5000;
+        int op = rng() % 10;
+        if(op < 3) {
+            t.insert(std::make_pair(k, i));
+            ref[k] = i;
+        }
+        else if(op < 4) {
+            t.remove(k);
+            ref.erase(k);
+        }
+        else if(op == 4 && i % 1000 == 0) {
+            t.eraseRange(k, k + 100);
+            ref.erase(ref.lower_bound(k), ref.upper_bound(k + 100));
+        }
+        else {
+            auto it = f.lowerBound(k);
+            std::map<int, int>::iterator r = ref.lower_bound(k);
+            CHECK((it == t.end()) == (r == ref.end()));
+            CHECK(r == ref.end() || (it != t.end() && it->first == r->first && it->second == r->second));
+            CHECK((f.find(k) != t.end()) == (ref.count(k) != 0));
+        }
+    }
+}
+
+void testParallel()
+{
+    std::mt19937 rng(91);
+    AVLTree<int, int> t;
+    std::map<int, int> ref;
+    for(int i = 0; i < 50000; ++i) {
+        int k = rng() % 200000;
+        t.insert(std::make_pair(k, k % 97));
+        ref[k] = k % 97;
+    }
+    WorkStealingPool pool(4);
+    std::string expected = ">";
+    long sum = 0;
+    for(std::map<int, int>::iterator it = ref.begin(); it != ref.end(); ++it) {
+        expected += static_cast<char>('0' + it->first % 10);
+        sum += it->second;
+    }
+    const size_t grains[] = { 1, 7, 100, 4096, 1000000 };
+    for(size_t g = 0; g < sizeof(grains) / sizeof(grains[0]); ++g) {
+        //combine is associative but not commutative, so order shows
+        std::string digits = t.parallelReduce(std::string(">"),
+            [](const std::pair<const int, int>& item) { return std::string(1, static_cast<char>('0' + item.first % 10)); },
+            [](const std::string& a, const std::string& b) { return a + b; }, grains[g], pool);
+        CHECK(digits == expected);
+        std::atomic<long> visited(0);
+        t.parallelForEach([&visited](const std::pair<const int, int>& item) { visited += item.second; }, grains[g], pool);
+        CHECK(visited == sum);
+    }
+    CHECK_THROWS(t.parallelForEach([](const std::pair<const int, int>& item) {
+        if(item.first % 1000 == 7) throw std::out_of_range("stop");
+    }, 16, pool), std::out_of_range);
+}
+
+/**
+* A memory resource that remembers every live block and its size, so
+* tests can tell a leak or a mismatched deallocate.
+*/
+struct CountingResource : public std::pmr::memory_resource
+{
+    std::map<void*, size_t> live;
+    size_t allocations = 0;
+    bool mismatched = false;
+
+    void* do_allocate(size_t bytes, size_t) override
+    {
+        void* p = ::operator new(bytes);
+        live[p] = bytes;
+        ++allocations;
+        return p;
+    }
+    void do_deallocate(void* p, size_t bytes, size_t) override
+    {
+        std::map<void*, size_t>::iterator it = live.find(p);
+        if(it == live.end() || it->second != bytes) {
+            mismatched = true;
+        }
+        else {
+            live.erase(it);
+        }
+        ::operator delete(p);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+template<class Tree>
+void churn(Tree& t, std::mt19937& rng)
+{
+    for(int i = 0; i < 5000; ++i) {
+        int k = rng() % 1000;
+        if(rng() % 3) {
+            t.insert(std::make_pair(k, i));
+        }
+        else {
+            t.remove(k);
+        }
+    }
+    t.eraseRange(100, 300);
+}
+
+void testMemoryResources()
+{
+    std::mt19937 rng(101);
+    CountingResource counting;
+    { AVLTree<int, int> t(&counting); churn(t, rng); }
+    { RedBlackTree<int, int> t(&counting); churn(t, rng); }
+    { SplayTree<int, int> t(&counting); churn(t, rng); }
+    { ScapegoatTree<int, int> t(0.7, &counting); churn(t, rng); }
+    { AggregateAVLTree<int, int> t(&counting); churn(t, rng); }
+    { HashedAVLTree<int, int> t(&counting); churn(t, rng); }
+    { LinkedAVLTree<int, int> t(&counting); churn(t, rng); }
+    { AVLTree<int, int> t(&counting); t.setTombstones(true, 0.3); churn(t, rng); }
+    {
+        std::vector<std::pair<int, int> > items;
+        for(int i = 0; i < 10000; ++i) {
+            items.push_back(std::make_pair(static_cast<int>(rng() % 8000), i));
+        }
+        AVLTree<int, int> t(&counting), u(&counting), elsewhere;
+        t.buildFrom(items.begin(), items.end(), 1);
+        t.splitAt(4000, u);
+        for(int i = 0; i < 2000; ++i) {
+            u.remove(4000 + i);
+            t.insert(std::make_pair(i, 1));
+        }
+        CHECK_THROWS(t.splitAt(2000, elsewhere), std::invalid_argument);
+        t.concat(u);
+        CHECK(u.empty());
+    }
+    CHECK(counting.allocations > 0);
+    CHECK(counting.live.empty());
+    CHECK(!counting.mismatched);
+
+    std::pmr::monotonic_buffer_resource mono;
+    AVLTree<int, int> t(&mono);
+    for(int i = 0; i < 1000; ++i) {
+        t.insert(std::make_pair(i, i));
+    }
+    t.release();
+    CHECK(t.empty());
+    t.insert(std::make_pair(1, 1));
+    CHECK(t.size() == 1);
+}
+
+void testOptimal()
+{
+    std::mt19937 rng(111);
+    Open<BinarySearchTree<int, int> > t;
+    std::map<int, int> ref;
+    for(int i = 0; i < 5000; ++i) {
+        int k = rng() % 10000;
+        t.insert(std::make_pair(k, i));
+        ref[k] = i;
+    }
+    t.setProfiling(1);
+    for(int i = 0; i < 50000; ++i) {
+        const BinarySearchTree<int, int>& c = t;
+        c.find(static_cast<int>(std::pow(rng() / 4294967296.0, 4) * 12000));
+    }
+    t.rebuildOptimal();
+    checkSame(static_cast<const BinarySearchTree<int, int>&>(t), ref);
+    checkShape(t);
+
+    Open<SplayTree<int, int> > s;
+    for(std::map<int, int>::iterator it = ref.begin(); it != ref.end(); ++it) {
+        s.insert(*it);
+    }
+    s.setProfiling(2);
+    for(int i = 0; i < 5000; ++i) {
+        s.find(rng() % 100);
+    }
+    s.rebuildOptimal();
+    checkSame(static_cast<const SplayTree<int, int>&>(s), ref);
+    checkShape(s);
+
+    AVLTree<int, int> a;
+    RedBlackTree<int, int> r;
+    CHECK_THROWS(a.rebuildOptimal(), std::logic_error);
+    CHECK_THROWS(r.rebuildOptimal(), std::logic_error);
+    BinarySearchTree<int, int>& base = a;
+    CHECK_THROWS(base.rebuildOptimal(), std::logic_error);
+}
+
+template<class Set>
+void setOps(unsigned seed)
+{
+    std::mt19937 rng(seed);
+    Set s;
+    std::set<int> ref;
+    for(int i = 0; i < 30000; ++i) {
+        int k = rng() % 3000;
+        if(rng() % 3) {
+            CHECK(s.insert(k) == ref.insert(k).second);
+        }
+        else {
+            CHECK(s.erase(k) == (ref.erase(k) > 0));
+        }
+        CHECK(s.contains(k) == (ref.count(k) > 0));
+    }
+    CHECK(s.size() == ref.size());
+    typename Set::iterator it = s.begin();
+    for(std::set<int>::iterator r = ref.begin(); r != ref.end(); ++r, ++it) {
+        CHECK(it != s.end() && *it == *r);
+    }
+    CHECK(it == s.end());
+    s.clear();
+    CHECK(s.empty());
+}
+
+void testSets()
+{
+    setOps<AVLSet<int> >(121);
+    setOps<BSTSet<int> >(122);
+    CHECK(sizeof(AVLNode<int, KeyOnly>) <= sizeof(AVLNode<int, bool>));
+}
+
+static constexpr auto codes = makeStaticMap<int, const char*>({
+    {404, "Not Found"}, {200, "OK"}, {500, "Internal Server Error"}, {301, "Moved"} });
+static_assert(codes[200][0] == 'O', "lookup at compile time");
+static_assert(codes.find(999) == codes.end(), "miss at compile time");
+static_assert(codes.lowerBound(402)->first == 404, "lowerBound at compile time");
+static_assert(codes.begin()->first == 200, "items are sorted");
+
+template<size_t N>
+void staticOps(std::mt19937& rng)
+{
+    std::pair<int, int> items[N];
+    std::map<int, int> ref;
+    for(size_t i = 0; i < N; ++i) {
+        int k;
+        do {
+            k = rng() % (4 * N);
+        } while(ref.count(k) != 0);
+        items[i] = std::make_pair(k, static_cast<int>(i));
+        ref[k] = static_cast<int>(i);
+    }
+    StaticMap<int, int, N> s(items);
+    std::map<int, int>::iterator r = ref.begin();
+    for(typename StaticMap<int, int, N>::iterator it = s.begin(); it != s.end(); ++it, ++r) {
+        CHECK(it->first == r->first && it->second == r->second);
+    }
+    for(int k = -1; k <= static_cast<int>(4 * N); ++k) {
+        CHECK((s.find(k) == s.end()) == (ref.count(k) == 0));
+        typename StaticMap<int, int, N>::iterator lb = s.lowerBound(k);
+        std::map<int, int>::iterator rb = ref.lower_bound(k);
+        CHECK((lb == s.end()) == (rb == ref.end()));
+        CHECK(rb == ref.end() || lb->first == rb->first);
+    }
+}
+
+void testStaticMaps()
+{
+    std::mt19937 rng(131);
+    staticOps<1>(rng);
+    staticOps<2>(rng);
+    staticOps<7>(rng);
+    staticOps<16>(rng);
+    staticOps<17>(rng);
+    staticOps<100>(rng);
+    staticOps<1000>(rng);
+    std::pair<int, int> duplicate[3] = { {1, 1}, {2, 2}, {1, 3} };
+    CHECK_THROWS((StaticMap<int, int, 3>(duplicate)), std::invalid_argument);
+    CHECK_THROWS(codes[1], std::out_of_range);
+}
+
+void testBloomFilter()
+{
+    std::mt19937_64 rng(141);
+    BlockedBloomFilter f;
+    f.reset(10000, 10.0);
+    std::set<uint64_t> added;
+    for(int i = 0; i < 10000; ++i) {
+        uint64_t h = rng();
+        f.add(h);
+        added.insert(h);
+    }
+    for(std::set<uint64_t>::iterator it = added.begin(); it != added.end(); ++it) {
+        CHECK(f.mayContain(*it));
+    }
+    size_t falsePositives = 0;
+    for(int i = 0; i < 100000; ++i) {
+        falsePositives += f.mayContain(rng()) ? 1 : 0;
+    }
+    CHECK(falsePositives < 5000);
+}
+
+void testSharded()
+{
+    std::mt19937 rng(151);
+    ShardedAVLMap<int, int> s(64);
+    std::map<int, int> ref;
+    for(int i = 0; i < 60000; ++i) {
+        int k = rng() % 20000;
+        int op = rng() % 10;
+        if(op < 5) {
+            s.insert(std::make_pair(k, i));
+            ref[k] = i;
+        }
+        else if(op < 8) {
+            CHECK(s.erase(k) == (ref.erase(k) > 0));
+        }
+        else if(op == 8) {
+            int v;
+            bool found = s.find(k, v);
+            CHECK(found == (ref.count(k) > 0));
+            CHECK(!found || v == ref[k]);
+        }
+        else {
+            int hi = k + rng() % 300;
+            std::vector<int> keys;
+            s.scan(k, hi, [&keys](const int& key, const int&) { keys.push_back(key); });
+            std::vector<int> expected;
+            for(std::map<int, int>::iterator it = ref.lower_bound(k); it != ref.end() && it->first <= hi; ++it) {
+                expected.push_back(it->first);
+            }
+            CHECK(keys == expected);
+        }
+        if(i % 10000 == 0) {
+            s.rebalance();
+            CHECK(s.size() == ref.size());
+            std::vector<size_t> sizes = s.shardSizes();
+            for(size_t j = 0; j < sizes.size(); ++j) {
+                CHECK(sizes[j] <= 64);
+            }
+        }
+    }
+    std::map<int, int> all;
+    s.forEach([&all](const int& key, const int& value) { all[key] = value; });
+    CHECK(all == ref);
+
+    //threads on disjoint keys, with splits, merges and rebalances under them
+    ShardedAVLMap<int, int> shared(256);
+    const int threads = 4;
+    std::vector<std::thread> workers;
+    for(int t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([&shared, t] {
+            std::mt19937 r(t);
+            for(int i = 0; i < 20000; ++i) {
+                int k = (r() % 5000) * threads + t;
+                if(r() % 3) {
+                    shared.insert(std::make_pair(k, k));
+                }
+                else {
+                    shared.erase(k);
+                }
+                int v;
+                if(shared.find(k, v) && v != k) {
+                    ++failures;
+                }
+                if(i % 5000 == 0) {
+                    shared.rebalance();
+                }
+            }
+            for(int k = t; k < 5000 * threads; k += threads) {
+                shared.insert(std::make_pair(k, k));
+            }
+        }));
+    }
+    for(size_t t = 0; t < workers.size(); ++t) {
+        workers[t].join();
+    }
+    CHECK(shared.size() == 5000u * threads);
+    int prev = -1;
+    bool ordered = true;
+    shared.forEach([&prev, &ordered](const int& key, const int& value) {
+        ordered = ordered && key == prev + 1 && value == key;
+        prev = key;
+    });
+    CHECK(ordered);
+}
+
+/**
+* A value whose copy constructor throws for 13, to make the combiner's
+* tree insert fail after the request has been published.
+*/
+struct Fragile
+{
+    Fragile() : v(0) { }
+    Fragile(int value) : v(value) { }
+    Fragile(const Fragile& other) : v(other.v) { if(v == 13) throw std::runtime_error("copy"); }
+    Fragile& operator=(const Fragile& other) { v = other.v; return *this; }
+    int v;
+};
+
+void testCombining()
+{
+    CombiningAVLMap<int, int> m(16);
+    const int threads = 4;
+    std::vector<std::map<int, int> > refs(threads);
+    std::vector<std::thread> workers;
+    for(int t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([&m, &refs, t] {
+            std::mt19937 r(t);
+            std::map<int, int>& ref = refs[t];
+            for(int i = 0; i < 20000; ++i) {
+                int k = (r() % 1000) * threads + t;
+                int op = r() % 3;
+                bool ok;
+                if(op == 0) {
+                    ok = m.insert(std::make_pair(k, i)) == ref.insert(std::make_pair(k, i)).second;
+                    ref[k] = i;
+                }
+                else if(op == 1) {
+                    ok = m.erase(k) == (ref.erase(k) > 0);
+                }
+                else {
+                    int v;
+                    bool found = m.find(k, v);
+                    ok = found == (ref.count(k) > 0) && (!found || v == ref[k]);
+                }
+                if(!ok) {
+                    ++failures;
+                }
+            }
+        }));
+    }
+    for(size_t t = 0; t < workers.size(); ++t) {
+        workers[t].join();
+    }
+    std::map<int, int> expected;
+    for(int t = 0; t < threads; ++t) {
+        expected.insert(refs[t].begin(), refs[t].end());
+    }
+    std::map<int, int> all;
+    m.forEach([&all](const int& key, const int& value) { all[key] = value; });
+    CHECK(all == expected);
+    CHECK(m.size() == expected.size());
+
+    //a failed request is rethrown to its owner and the map keeps working
+    CombiningAVLMap<int, Fragile> f(4);
+    CHECK(f.insert(std::make_pair(1, Fragile(1))));
+    CHECK_THROWS(f.insert(std::make_pair(2, Fragile(13))), std::runtime_error);
+    Fragile v;
+    CHECK(!f.find(2, v));
+    CHECK(f.find(1, v) && v.v == 1);
+    for(int i = 0; i < 8; ++i) {
+        CHECK(f.insert(std::make_pair(100 + i, Fragile(i))));
+    }
+    CHECK(f.size() == 9);
+}
+
+void testPaged()
+{
+    std::string path = (std::filesystem::temp_directory_path() / "bst-test-paged.db").string();
+    std::mt19937 rng(161);
+    const size_t pageSizes[] = { 256, 4096 };
+    for(size_t p = 0; p < 2; ++p) {
+        std::filesystem::remove(path);
+        std::map<int, long> ref;
+        {
+            PagedBTree<int, long> t(path, 1 << 20, pageSizes[p], 4);
+            for(int i = 0; i < 30000; ++i) {
+                int k = rng() % 10000;
+                int op = rng() % 5;
+                if(op < 3) {
+                    t.insert(std::make_pair(k, static_cast<long>(i)));
+                    ref[k] = i;
+                }
+                else if(op == 3) {
+                    t.remove(k);
+                    ref.erase(k);
+                }
+                else {
+                    PagedBTree<int, long>::iterator it = t.find(k);
+                    CHECK((it != t.end()) == (ref.count(k) > 0));
+                    CHECK(it == t.end() || it->second == ref[k]);
+                }
+            }
+            CHECK(t.size() == ref.size());
+            for(int q = 0; q < 500; ++q) {
+                int k = static_cast<int>(rng() % 10010) - 5;
+                PagedBTree<int, long>::iterator it = t.lowerBound(k);
+                std::map<int, long>::iterator r = ref.lower_bound(k);
+                CHECK((it == t.end()) == (r == ref.end()));
+                CHECK(r == ref.end() || it->first == r->first);
+            }
+            CHECK_THROWS(t[-100], std::out_of_range);
+        }
+        {
+            //reopened from disk
+            PagedBTree<int, long> t(path, 1 << 20, pageSizes[p]);
+            CHECK(t.size() == ref.size());
+            PagedBTree<int, long>::iterator it = t.begin();
+            PagedBTree<int, long>::iterator copy;
+            for(std::map<int, long>::iterator r = ref.begin(); r != ref.end(); ++r) {
+                CHECK(it != t.end() && it->first == r->first && it->second == r->second);
+                copy = it;
+                ++it;
+            }
+            CHECK(it == t.end());
+            CHECK(ref.empty() || copy->first == ref.rbegin()->first);
+            t.clear();
+            CHECK(t.empty() && t.begin() == t.end());
+        }
+    }
+    CHECK_THROWS((PagedBTree<long, long>(path)), std::invalid_argument);
+    std::filesystem::remove(path);
+}
+
+int main()
+{
+    struct Test
+    {
+        const char* name;
+        void (*run)();
+    };
+    const Test tests[] = {
+        { "trees", testTrees },
+        { "strings", testStrings },
+        { "aggregates", testAggregates },
+        { "intervals", testIntervals },
+        { "splitConcat", testSplitConcat },
+        { "buildFrom", testBuildFrom },
+        { "extractMerge", testExtractMerge },
+        { "fingers", testFingers },
+        { "parallel", testParallel },
+        { "memoryResources", testMemoryResources },
+        { "optimal", testOptimal },
+        { "sets", testSets },
+        { "staticMaps", testStaticMaps },
+        { "bloomFilter", testBloomFilter },
+        { "sharded", testSharded },
+        { "combining", testCombining },
+        { "paged", testPaged },
+    };
+    for(size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i) {
+        int before = failures;
+        tests[i].run();
+        std::cout << (failures == before ? "ok     " : "FAILED ") << tests[i].name << std::endl;
+    }
+    if(failures > 0) {
+        std::cout << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
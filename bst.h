@@ -4,7 +4,17 @@
 #include <iostream>
 #include <exception>
 #include <cstdlib>
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <memory_resource>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <type_traits>
 #include <utility>
+#include <vector>
+#include "workpool.h"
 
 /**
  * A templated class for a Node in a search tree.
@@ -29,6 +39,8 @@ public:
     virtual Node<Key, Value>* getParent() const;
     virtual Node<Key, Value>* getLeft() const;
     virtual Node<Key, Value>* getRight() const;
+    virtual bool isDeleted() const;
+    virtual Node<Key, Value>* getNext() const;
 
     void setParent(Node<Key, Value>* parent);
     void setLeft(Node<Key, Value>* left);
@@ -144,6 +156,42 @@ Node<Key, Value>* Node<Key, Value>::getRight() const
     return right_;
 }
 
+/**
+* Whether the node is a tombstone left in place by a lazy remove (see
+* AVLTree::setTombstones). Plain nodes never are.
+*/
+template<typename Key, typename Value>
+bool Node<Key, Value>::isDeleted() const
+{
+    return false;
+}
+
+/**
+* The node with the next larger key, or NULL for the largest: the
+* leftmost node of the right subtree if there is one, otherwise the first
+* ancestor this is in the left subtree of. Iterators advance with this,
+* so nodes that keep an in-order link can override it with one hop.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* Node<Key, Value>::getNext() const
+{
+    Node<Key, Value>* current = getRight();
+    if(current != NULL) {
+        while(current->getLeft() != NULL) {
+            current = current->getLeft();
+        }
+        return current;
+    }
+
+    const Node<Key, Value>* child = this;
+    Node<Key, Value>* parent = getParent();
+    while(parent != NULL && parent->getRight() == child) { //climb while coming from the right
+        child = parent;
+        parent = parent->getParent();
+    }
+    return parent;
+}
+
 /**
 * A setter for setting the parent of a node.
 */
@@ -186,6 +234,57 @@ void Node<Key, Value>::setValue(const Value& value)
   ---------------------------------------
 */
 
+/**
+* Heap memory a key or value owns beyond sizeof(T), for memoryUsage().
+* The default counts nothing, which is right for any type that keeps
+* everything inline. Specialize it for other heap-owning types.
+*/
+template <typename T>
+struct DeepSize
+{
+    static size_t of(const T&) { return 0; }
+};
+
+/**
+* Counts the buffer unless the string fits in its small-string storage.
+*/
+template <typename C, typename Traits, typename Alloc>
+struct DeepSize<std::basic_string<C, Traits, Alloc> >
+{
+    static size_t of(const std::basic_string<C, Traits, Alloc>& s)
+    {
+        const char* data = reinterpret_cast<const char*>(s.data());
+        const char* self = reinterpret_cast<const char*>(&s);
+        if(data >= self && data < self + sizeof(s)) {
+            return 0;
+        }
+        return (s.capacity() + 1) * sizeof(C);
+    }
+};
+
+template <typename T, typename Alloc>
+struct DeepSize<std::vector<T, Alloc> >
+{
+    static size_t of(const std::vector<T, Alloc>& v)
+    {
+        size_t bytes = v.capacity() * sizeof(T);
+        for(size_t i = 0; i < v.size(); ++i) {
+            bytes += DeepSize<T>::of(v[i]);
+        }
+        return bytes;
+    }
+};
+
+template <typename A, typename B>
+struct DeepSize<std::pair<A, B> >
+{
+    static size_t of(const std::pair<A, B>& p)
+    {
+        return DeepSize<typename std::remove_const<A>::type>::of(p.first) +
+            DeepSize<typename std::remove_const<B>::type>::of(p.second);
+    }
+};
+
 /**
 * A templated unbalanced binary search tree.
 */
@@ -193,14 +292,66 @@ template <typename Key, typename Value>
 class BinarySearchTree
 {
 public:
-    BinarySearchTree();
+    explicit BinarySearchTree(std::pmr::memory_resource* resource = NULL);
     virtual ~BinarySearchTree();
     virtual void insert(const std::pair<const Key, Value>& keyValuePair);
     virtual void remove(const Key& key);
-    void clear();
+    virtual void clear();
+    virtual void release();
+    std::pmr::memory_resource* resource() const;
     bool isBalanced() const;
     void print() const;
     bool empty() const;
+    size_t size() const;
+    virtual int height() const;
+
+    /**
+    * A cheap summary of the tree for monitoring. The key pointers refer to
+    * the smallest and largest keys and are NULL when the tree is empty.
+    */
+    struct Stats
+    {
+        size_t size;
+        const Key* minKey;
+        const Key* maxKey;
+    };
+    Stats stats() const;
+
+    /**
+    * Where the tree's memory goes, from memoryUsage(). Allocator
+    * overhead is an estimate: for the global heap it assumes a
+    * glibc-style malloc (an 8-byte header, 16-byte granules, 32-byte
+    * minimum chunks), for a memory resource only rounding to
+    * alignof(std::max_align_t). fragmentation is the share of
+    * totalBytes that holds no live item: allocator overhead, tombstones
+    * and slots of bulk-built blocks whose nodes were removed.
+    */
+    struct MemoryUsage
+    {
+        size_t nodes; //linked nodes, tombstones included
+        size_t deadNodes; //tombstones among them
+        size_t nodeBytes; //bytes per node: item, links, vptr and padding
+        size_t overheadBytes; //allocator headers and rounding
+        size_t deepBytes; //heap memory owned by keys and values, per DeepSize
+        size_t unusedBytes; //empty slots in bulk-built blocks
+        size_t totalBytes;
+        double fragmentation;
+    };
+    MemoryUsage memoryUsage() const;
+
+    // Sample every sampleEvery-th find (0 stops sampling), then reshape
+    // the tree for the sampled key frequencies. See rebuildOptimal.
+    void setProfiling(size_t sampleEvery);
+    virtual void rebuildOptimal();
+
+    // Visit every item on a WorkStealingPool, forking on subtrees until
+    // they hold about grain items. See the definitions for ordering.
+    template<typename F>
+    void parallelForEach(F fn, size_t grain = 4096,
+        WorkStealingPool& pool = WorkStealingPool::shared()) const;
+    template<typename T, typename Map, typename Combine>
+    T parallelReduce(T init, Map map, Combine combine, size_t grain = 4096,
+        WorkStealingPool& pool = WorkStealingPool::shared()) const;
 
     template<typename PPKey, typename PPValue>
     friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue> & tree);
@@ -227,16 +378,51 @@ public:
         Node<Key, Value> *current_;
     };
 
+    /**
+    * A lookup position that persists between calls, for queries that come
+    * in clusters of nearby keys. Each lookup starts where the previous one
+    * ended, climbs parent pointers only until the key must lie below, and
+    * descends from there. Like an iterator it belongs to one tree, but it
+    * survives changes to it: once nodes are freed it starts over from the
+    * root.
+    */
+    class Finger
+    {
+    public:
+        Finger();
+
+        iterator find(const Key& key);
+        iterator lowerBound(const Key& key);
+
+    protected:
+        friend class BinarySearchTree<Key, Value>;
+        Finger(const BinarySearchTree<Key, Value>* tree);
+
+        const BinarySearchTree<Key, Value>* tree_;
+        Node<Key, Value>* node_; //where the last lookup ended
+        size_t generation_; //the tree's generation when node_ was set
+    };
+
 public:
     iterator begin() const;
     iterator end() const;
     iterator find(const Key& key) const;
+    iterator lowerBound(const Key& key) const;
+    Finger finger() const;
+    iterator erase(iterator pos);
+    iterator erase(iterator first, iterator last);
+    virtual size_t eraseRange(const Key& lo, const Key& hi);
     Value& operator[](const Key& key);
     Value const & operator[](const Key& key) const;
 
 protected:
+    struct NodeBlock;
+
     // Mandatory helper functions
-    Node<Key, Value>* internalFind(const Key& k) const;
+    virtual Node<Key, Value>* internalFind(const Key& k) const;
+    Node<Key, Value>* internalLowerBound(const Key& k) const;
+    Node<Key, Value>* fingerLowerBound(Node<Key, Value>* start, const Key& key) const;
+    virtual void removeNode(Node<Key, Value>* node);
     Node<Key, Value> *getSmallestNode() const;
     static Node<Key, Value>* predecessor(Node<Key, Value>* current);
     // Note:  static means these functions don't have a "this" pointer
@@ -248,14 +434,85 @@ protected:
 
     // Add helper functions here
     static Node<Key, Value>* successor(Node<Key, Value>* current);
-    void postOrder(Node<Key, Value>* node);
+    size_t postOrder(Node<Key, Value>* node);
     static int height(Node<Key, Value>* node, bool& balanced);
+    static int subtreeHeight(Node<Key, Value>* node);
+    static size_t subtreeSize(Node<Key, Value>* node);
     static int maxHeight(int left, int right);
+    void noteInsert(Node<Key, Value>* node);
+    void noteRemove(Node<Key, Value>* node);
+    void resetBounds();
+    void skipDeletedBounds();
+    void* allocateNode(size_t bytes);
+    void* allocate(size_t bytes);
+    void deallocate(void* storage, size_t bytes);
+    void destroyNode(Node<Key, Value>* node);
+    NodeBlock* detachNode(Node<Key, Value>* node);
+    static void freeNode(Node<Key, Value>* node, NodeBlock* block,
+        std::pmr::memory_resource* resource, size_t bytes);
+    static Node<Key, Value>* nodeAt(const iterator& it);
+    size_t chunkOverhead(size_t bytes) const;
+    void measure(Node<Key, Value>* node, MemoryUsage& usage) const;
+    void adoptBlock(void* storage, size_t count, size_t nodeBytes);
+    size_t findBlock(const Node<Key, Value>* node) const;
+    void addBlockRef(NodeBlock* block);
+    void moveBlockRefs(Node<Key, Value>* node, BinarySearchTree<Key, Value>& to);
+    void takeBlockRefs(BinarySearchTree<Key, Value>& from);
+    Node<Key, Value>* trim(Node<Key, Value>* node, const Key& lo, const Key& hi, size_t& count);
+    void rotateLeft(Node<Key, Value>* node);
+    void rotateRight(Node<Key, Value>* node);
+    static void flatten(Node<Key, Value>* node, std::vector<Node<Key, Value>*>& out);
+    static Node<Key, Value>* buildBalanced(std::vector<Node<Key, Value>*>& nodes,
+        size_t lo, size_t hi, Node<Key, Value>* parent);
+    void profileLookup(const Key& key, size_t every) const;
+    static Node<Key, Value>* buildWeighted(std::vector<Node<Key, Value>*>& nodes,
+        const std::vector<uint64_t>& prefix, const std::vector<uint64_t>& gaps,
+        size_t lo, size_t hi, Node<Key, Value>* parent);
+    template<typename F>
+    static void inOrder(Node<Key, Value>* node, F& visit);
+    template<typename F>
+    static void parallelForEach(Node<Key, Value>* node, size_t estimate, size_t grain,
+        WorkStealingPool& pool, F& fn);
+    template<typename T, typename Map, typename Combine>
+    static bool parallelReduce(Node<Key, Value>* node, size_t estimate, size_t grain,
+        WorkStealingPool& pool, Map& map, Combine& combine, T& result);
 
 
 protected:
     Node<Key, Value>* root_;
-    // You should not need other data members
+    // Maintained by insert/remove so size() and stats() never walk the tree
+    size_t size_;
+    Node<Key, Value>* min_;
+    Node<Key, Value>* max_;
+
+    /**
+    * A contiguous run of nodes placed by a bulk build. Its nodes are
+    * destroyed in place and the storage is freed with the last of them.
+    * Splitting a tree can spread one block's nodes over several trees,
+    * so the block counts all of its live nodes and each tree holds a
+    * reference counting its own.
+    */
+    struct NodeBlock
+    {
+        char* begin;
+        char* end;
+        std::atomic<size_t> live;
+    };
+    struct BlockRef
+    {
+        NodeBlock* block;
+        size_t live; //how many of the block's nodes are in this tree
+    };
+    std::vector<BlockRef> blocks_; //sorted by address, usually empty
+
+    std::pmr::memory_resource* resource_; //where nodes come from, NULL for the global heap
+    size_t nodeSize_; //bytes per node, which deallocate needs back
+    size_t generation_; //bumped whenever nodes are freed or leave the tree, for Finger
+
+    std::atomic<size_t> profileEvery_; //0 while find is not sampled
+    mutable std::atomic<size_t> profileTick_;
+    mutable std::mutex profileLock_;
+    mutable std::map<Key, uint64_t> profile_; //sampled finds per key, hits and misses alike
    
 };
 
@@ -281,7 +538,7 @@ BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value> *ptr)
 template<class Key, class Value>
 BinarySearchTree<Key, Value>::iterator::iterator() 
 {
-    current_(NULL);
+    current_ = NULL;
 }
 
 /**
@@ -336,13 +593,16 @@ BinarySearchTree<Key, Value>::iterator::operator!=(
 
 
 /**
-* Advances the iterator's location using an in-order sequencing
+* Advances the iterator's location using an in-order sequencing,
+* stepping over tombstones
 */
 template<class Key, class Value>
 typename BinarySearchTree<Key, Value>::iterator&
 BinarySearchTree<Key, Value>::iterator::operator++()
 {
-    current_ = successor(current_);
+    do {
+        current_ = (current_ == NULL) ? NULL : current_->getNext();
+    } while(current_ != NULL && current_->isDeleted());
     return *this;
 }
 
@@ -353,6 +613,69 @@ End implementations for the BinarySearchTree::iterator class.
 -------------------------------------------------------------
 */
 
+/*
+-----------------------------------------------------------
+Begin implementations for the BinarySearchTree::Finger class.
+-----------------------------------------------------------
+*/
+
+template<class Key, class Value>
+BinarySearchTree<Key, Value>::Finger::Finger() :
+    tree_(NULL), node_(NULL), generation_(0)
+{
+
+}
+
+template<class Key, class Value>
+BinarySearchTree<Key, Value>::Finger::Finger(const BinarySearchTree<Key, Value>* tree) :
+    tree_(tree), node_(NULL), generation_(tree->generation_)
+{
+
+}
+
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::Finger::find(const Key& key)
+{
+    iterator it = lowerBound(key);
+    if(it.current_ != NULL && !(key < it.current_->getKey())) {
+        return it;
+    }
+    return iterator(NULL);
+}
+
+/**
+* Like BinarySearchTree::lowerBound, and leaves the finger on the node
+* found so the next lookup starts there.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::Finger::lowerBound(const Key& key)
+{
+    if(node_ == NULL || generation_ != tree_->generation_) {
+        node_ = tree_->root_;
+        generation_ = tree_->generation_;
+    }
+    if(node_ == NULL) {
+        return iterator(NULL);
+    }
+    Node<Key, Value>* found = tree_->fingerLowerBound(node_, key);
+    if(found != NULL) {
+        node_ = found;
+    }
+    iterator it(found);
+    if(found != NULL && found->isDeleted()) {
+        ++it;
+    }
+    return it;
+}
+
+/*
+---------------------------------------------------------
+End implementations for the BinarySearchTree::Finger class.
+---------------------------------------------------------
+*/
+
 /*
 -----------------------------------------------------
 Begin implementations for the BinarySearchTree class.
@@ -361,11 +684,21 @@ Begin implementations for the BinarySearchTree class.
 
 /**
 * Default constructor for a BinarySearchTree, which sets the root to NULL.
+* Nodes are allocated from resource, or with the global operator new if
+* it is NULL. The resource must outlive the tree.
 */
 template<class Key, class Value>
-BinarySearchTree<Key, Value>::BinarySearchTree() 
+BinarySearchTree<Key, Value>::BinarySearchTree(std::pmr::memory_resource* resource) 
 {
     root_ = NULL;
+    size_ = 0;
+    min_ = NULL;
+    max_ = NULL;
+    resource_ = resource;
+    nodeSize_ = 0;
+    generation_ = 0;
+    profileEvery_ = 0;
+    profileTick_ = 0;
 }
 
 template<typename Key, typename Value>
@@ -383,6 +716,206 @@ bool BinarySearchTree<Key, Value>::empty() const
     return root_ == NULL;
 }
 
+/**
+ * Returns the number of items in the tree
+*/
+template<class Key, class Value>
+size_t BinarySearchTree<Key, Value>::size() const
+{
+    return size_;
+}
+
+/**
+ * Returns the min/max keys from the cached end nodes, in O(1)
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::Stats
+BinarySearchTree<Key, Value>::stats() const
+{
+    Stats result;
+    result.size = size_;
+    result.minKey = (min_ == NULL) ? NULL : &min_->getKey();
+    result.maxKey = (max_ == NULL) ? NULL : &max_->getKey();
+    return result;
+}
+
+/**
+* Walks every node to account for the tree's memory, so it is O(n) and
+* meant for capacity planning rather than hot paths. Bulk-built blocks
+* shared with other trees after a splitAt are charged to each tree in
+* proportion to the nodes it holds.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::MemoryUsage
+BinarySearchTree<Key, Value>::memoryUsage() const
+{
+    MemoryUsage usage;
+    usage.nodes = 0;
+    usage.deadNodes = 0;
+    usage.nodeBytes = nodeSize_;
+    usage.overheadBytes = 0;
+    usage.deepBytes = 0;
+    usage.unusedBytes = 0;
+    measure(root_, usage);
+
+    for(size_t i = 0; i < blocks_.size(); ++i) {
+        const NodeBlock* block = blocks_[i].block;
+        size_t bytes = block->end - block->begin;
+        size_t live = block->live.load();
+        size_t slots = bytes / nodeSize_;
+        double share = static_cast<double>(blocks_[i].live) / live;
+        usage.unusedBytes += static_cast<size_t>((slots - live) * nodeSize_ * share);
+        usage.overheadBytes += static_cast<size_t>(chunkOverhead(bytes) * share);
+    }
+
+    size_t solo = usage.nodes;
+    for(size_t i = 0; i < blocks_.size(); ++i) {
+        solo -= blocks_[i].live;
+    }
+    usage.overheadBytes += solo * chunkOverhead(nodeSize_);
+
+    usage.totalBytes = usage.nodes * nodeSize_ + usage.overheadBytes + usage.deepBytes + usage.unusedBytes;
+    size_t wasted = usage.overheadBytes + usage.unusedBytes + usage.deadNodes * nodeSize_;
+    usage.fragmentation = (usage.totalBytes == 0) ? 0.0 : static_cast<double>(wasted) / usage.totalBytes;
+    return usage;
+}
+
+/**
+* Calls fn(item) on every item, in parallel and in no particular order.
+* fn may change values but must not change the tree. Subtree sizes are
+* estimated by halving the size at each level, so a badly unbalanced
+* plain BST forks less than it could.
+*/
+template<class Key, class Value>
+template<typename F>
+void BinarySearchTree<Key, Value>::parallelForEach(F fn, size_t grain, WorkStealingPool& pool) const
+{
+    parallelForEach(root_, size_, (grain == 0) ? 1 : grain, pool, fn);
+}
+
+/**
+* Returns init combined with map(item) of every item, in key order:
+* combine(init, combine(map(first), combine(..., map(last)))). Subtrees
+* are reduced in parallel, but results are only ever combined with their
+* neighbours in key order, so combine must be associative and need not
+* be commutative.
+*/
+template<class Key, class Value>
+template<typename T, typename Map, typename Combine>
+T BinarySearchTree<Key, Value>::parallelReduce(T init, Map map, Combine combine, size_t grain,
+    WorkStealingPool& pool) const
+{
+    T result = init;
+    if(parallelReduce(root_, size_, (grain == 0) ? 1 : grain, pool, map, combine, result)) {
+        return combine(init, result);
+    }
+    return init;
+}
+
+/**
+* Calls visit(node) on every live node of a subtree in key order, with
+* an explicit stack so a degenerate tree cannot overflow the call stack.
+*/
+template<class Key, class Value>
+template<typename F>
+void BinarySearchTree<Key, Value>::inOrder(Node<Key, Value>* node, F& visit)
+{
+    std::vector<Node<Key, Value>*> stack;
+    while(node != NULL || !stack.empty()) {
+        while(node != NULL) {
+            stack.push_back(node);
+            node = node->getLeft();
+        }
+        node = stack.back();
+        stack.pop_back();
+        if(!node->isDeleted()) {
+            visit(node);
+        }
+        node = node->getRight();
+    }
+}
+
+/**
+* Runs the left subtree as a task and the right one here, down to
+* subtrees estimated at grain items or fewer.
+*/
+template<class Key, class Value>
+template<typename F>
+void BinarySearchTree<Key, Value>::parallelForEach(Node<Key, Value>* node, size_t estimate,
+    size_t grain, WorkStealingPool& pool, F& fn)
+{
+    if(node == NULL) {
+        return;
+    }
+    if(estimate <= grain) {
+        auto visit = [&fn](Node<Key, Value>* n) { fn(n->getItem()); };
+        inOrder(node, visit);
+        return;
+    }
+
+    WorkStealingPool::TaskGroup group(pool);
+    Node<Key, Value>* left = node->getLeft();
+    group.run([left, estimate, grain, &pool, &fn] { parallelForEach(left, estimate / 2, grain, pool, fn); });
+    if(!node->isDeleted()) {
+        fn(node->getItem());
+    }
+    parallelForEach(node->getRight(), estimate / 2, grain, pool, fn);
+    group.wait();
+}
+
+/**
+* Reduces a subtree into result. Returns false, leaving result alone, if
+* the subtree has no live items.
+*/
+template<class Key, class Value>
+template<typename T, typename Map, typename Combine>
+bool BinarySearchTree<Key, Value>::parallelReduce(Node<Key, Value>* node, size_t estimate,
+    size_t grain, WorkStealingPool& pool, Map& map, Combine& combine, T& result)
+{
+    if(node == NULL) {
+        return false;
+    }
+    if(estimate <= grain) {
+        bool found = false;
+        auto visit = [&](Node<Key, Value>* n) {
+            if(found) {
+                result = combine(result, map(n->getItem()));
+            }
+            else {
+                result = map(n->getItem());
+                found = true;
+            }
+        };
+        inOrder(node, visit);
+        return found;
+    }
+
+    WorkStealingPool::TaskGroup group(pool);
+    Node<Key, Value>* leftNode = node->getLeft();
+    T left = result;
+    bool hasLeft = false;
+    group.run([&, leftNode, estimate, grain] {
+        hasLeft = parallelReduce(leftNode, estimate / 2, grain, pool, map, combine, left);
+    });
+    T right = result;
+    bool hasRight = parallelReduce(node->getRight(), estimate / 2, grain, pool, map, combine, right);
+    group.wait();
+
+    bool found = hasLeft;
+    if(hasLeft) {
+        result = left;
+    }
+    if(!node->isDeleted()) {
+        result = found ? combine(result, map(node->getItem())) : map(node->getItem());
+        found = true;
+    }
+    if(hasRight) {
+        result = found ? combine(result, right) : right;
+        found = true;
+    }
+    return found;
+}
+
 template<typename Key, typename Value>
 void BinarySearchTree<Key, Value>::print() const
 {
@@ -421,10 +954,94 @@ typename BinarySearchTree<Key, Value>::iterator
 BinarySearchTree<Key, Value>::find(const Key & k) const
 {
     Node<Key, Value> *curr = internalFind(k);
+    size_t every = profileEvery_.load(std::memory_order_relaxed);
+    if(every != 0) {
+        profileLookup(k, every);
+    }
     BinarySearchTree<Key, Value>::iterator it(curr);
     return it;
 }
 
+/**
+* Returns an iterator to the first item whose key is not less than key,
+* or end() if there is none.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::lowerBound(const Key& key) const
+{
+    iterator it(internalLowerBound(key));
+    if(it.current_ != NULL && it.current_->isDeleted()) {
+        ++it;
+    }
+    return it;
+}
+
+/**
+* A Finger positioned at the root, to be kept and reused across lookups.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::Finger
+BinarySearchTree<Key, Value>::finger() const
+{
+    return Finger(this);
+}
+
+/**
+* Removes the item pos refers to without searching for it again and
+* returns an iterator to the item after it.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::erase(iterator pos)
+{
+    iterator next(pos);
+    ++next;
+    removeNode(pos.current_);
+    return next;
+}
+
+/**
+* Removes every item in [first, last) with a single eraseRange, so a
+* balanced tree restructures once instead of once per item. Returns last,
+* which stays valid.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::erase(iterator first, iterator last)
+{
+    if(first == last) {
+        return last;
+    }
+    Node<Key, Value>* hi = (last.current_ == NULL) ? max_ : predecessor(last.current_);
+    Key loKey = first->first;
+    Key hiKey = hi->getKey();
+    eraseRange(loKey, hiKey);
+    return last;
+}
+
+/**
+* Removes every key in [lo, hi] and returns how many were removed.
+* The plain BST cuts the range out in one pass: nodes outside the range
+* keep their places, and each node inside is freed as the walk reaches it,
+* so this costs O(depth + k) rather than k separate removes.
+*/
+template<class Key, class Value>
+size_t BinarySearchTree<Key, Value>::eraseRange(const Key& lo, const Key& hi)
+{
+    if(root_ == NULL || hi < lo) {
+        return 0;
+    }
+    size_t count = 0;
+    root_ = trim(root_, lo, hi, count);
+    if(root_ != NULL) {
+        root_->setParent(NULL);
+    }
+    size_ -= count;
+    resetBounds();
+    return count;
+}
+
 /**
  * @precondition The key exists in the map
  * Returns the value associated with the key
@@ -453,22 +1070,23 @@ Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
 template<class Key, class Value>
 void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &keyValuePair)
 {
-    Key key = keyValuePair.first;
-    Value value = keyValuePair.second;
+    const Key& key = keyValuePair.first;
+    const Value& value = keyValuePair.second;
     Node<Key, Value>* temp(root_);
-    Node<Key, Value>* node = new Node<Key, Value> (key, value, NULL); //create a new node
+    Node<Key, Value>* node = new (allocateNode(sizeof(Node<Key, Value>))) Node<Key, Value> (key, value, NULL); //create a new node
 
     //tree is empty (adding to root)
     if(root_ == nullptr) {
         root_ = node;  
+        noteInsert(node);
         return;
     }
 
     while(temp->getLeft() != NULL || temp->getRight() != NULL) {
-        Key this_key = temp->getKey();
+        const Key& this_key = temp->getKey();
         if(key == this_key) { //update value
             temp->setValue(value);
-            delete node; 
+            destroyNode(node); 
             return;
         }
         else if(key < this_key) {
@@ -488,46 +1106,63 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
     if(temp->getRight() == NULL && temp->getLeft() != NULL) { //fill in right child
         temp->setRight(node);
         node->setParent(temp);
+        noteInsert(node);
         return;
     }
     else if(temp->getRight() != NULL && temp->getLeft() == NULL) { //fill in left child
         temp->setLeft(node);
         node->setParent(temp);
+        noteInsert(node);
         return;
     }
     else if(temp->getRight() == NULL && temp->getLeft() == NULL) { //decide which one to fill
         if(key < temp->getKey()) { //left
             temp->setLeft(node);
             node->setParent(temp);
+            noteInsert(node);
             return;
         }
         else if(key > temp->getKey()) { //right
             temp->setRight(node);
             node->setParent(temp);
+            noteInsert(node);
             return;
         }
+        else { //update value held by a leaf
+            temp->setValue(value);
+        }
     }
-    delete node;    
+    destroyNode(node);    
 }
 
 
 /**
 * A remove method to remove a specific key from a Binary Search Tree.
-* Recall: The writeup specifies that if a node has 2 children you
-* should swap with the predecessor and then remove.
+* Finds the node and hands it to removeNode, which each kind of tree
+* overrides with its own unlinking and rebalancing.
 */
 template<typename Key, typename Value>
 void BinarySearchTree<Key, Value>::remove(const Key& key)
 {
-    //this->printRoot(this->root_); //used for debugging
-
-    //find predecessor 
     Node<Key, Value>* node = internalFind(key);
-    Node<Key, Value>* pred = predecessor(node);
 
     if(node == NULL) { //node isnt in tree
         return;
     }
+    removeNode(node);
+}
+
+/**
+* Unlinks and frees a node that is known to be in the tree.
+* Recall: The writeup specifies that if a node has 2 children you
+* should swap with the predecessor and then remove.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::removeNode(Node<Key, Value>* node)
+{
+    //this->printRoot(this->root_); //used for debugging
+
+    noteRemove(node);
 
     //no children
     if(node->getLeft() == NULL && node->getRight() == NULL) {
@@ -545,7 +1180,7 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
         else{
             root_ = NULL;
         }
-        delete node;
+        destroyNode(node);
         return;
     }
 
@@ -558,7 +1193,7 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
         if(node->getParent() == NULL) { //node is the root
             right->setParent(NULL);
             root_ = right;
-            delete node;
+            destroyNode(node);
             return;
         }
         else if(node->getParent() != NULL) { //get the parent
@@ -572,7 +1207,7 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
             parent->setLeft(right);
             right->setParent(parent);
         }
-        delete node;
+        destroyNode(node);
         return;
     }
 
@@ -584,7 +1219,7 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
         if(node->getParent() == NULL) { //node is the root
             left->setParent(NULL);
             root_ = left;
-            delete node;
+            destroyNode(node);
             return;
         }
         else if(node->getParent() != NULL) { //get the parent
@@ -598,12 +1233,13 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
             parent->setLeft(left);
             left->setParent(parent);
         }
-        delete node;
+        destroyNode(node);
         return;
     }
 
     //2 children
     else if(node->getLeft() != NULL && node->getRight() != NULL) { //else
+         Node<Key, Value>* pred = predecessor(node);
          Node<Key, Value>* pred_left = NULL;
          Node<Key, Value>* pred_parent = NULL;
 
@@ -619,7 +1255,7 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
             if(pred_parent == node) {
                 pred_left->setParent(pred);
                 pred->setLeft(pred_left);
-                delete node;
+                destroyNode(node);
                 return;
             }
             else {
@@ -633,32 +1269,37 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
                 pred_parent->setLeft(pred_left);
             }
 
-            delete node;
+            destroyNode(node);
             return;
         }
         else if(pred_left == NULL) { //pred has no child
             if(pred_parent == node) {
                 pred->setLeft(NULL);
-                delete node;
+                destroyNode(node);
                 return;
             }
             pred_parent->setRight(NULL);
-            delete node;
+            destroyNode(node);
             return;
         }
         else if(pred_parent == NULL) {
             pred_left->setParent(NULL);
         }
 
-        delete node;
+        destroyNode(node);
     }
 }
 
+/**
+* Returns the node with the next smaller key, or NULL if current is the
+* smallest: the rightmost node of the left subtree if there is one,
+* otherwise the first ancestor that current is in the right subtree of.
+*/
 template<class Key, class Value>
 Node<Key, Value>*
 BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
 {
-    if(current == NULL || current->getLeft() == NULL) {
+    if(current == NULL) {
         return NULL;
     }
 
@@ -669,60 +1310,270 @@ BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
         }
         return current;
     }
-    else { 
-        if(current->getParent() == NULL) { //only right side of tree
-            return NULL;
-        } 
-        Node<Key, Value>* temp = current->getParent();
 
-        while(temp != NULL) {
-            temp = current->getParent();
-            if(temp->getRight() != current) {
-                current = temp;
-            }
-            else if(temp->getRight() == current) {
-                return current;
-            }
-        }
+    Node<Key, Value>* parent = current->getParent();
+    while(parent != NULL && parent->getLeft() == current) { //climb while coming from the left
+        current = parent;
+        parent = parent->getParent();
     }
-    return NULL;
+    return parent;
 }
 
+/**
+* Returns the node with the next larger key, or NULL if current is the
+* largest. Always walks the tree links, ignoring any override of
+* getNext, so it is safe while those are being rebuilt.
+*/
 template<class Key, class Value>
 Node<Key, Value>*
 BinarySearchTree<Key, Value>::successor(Node<Key, Value>* current)
 {
-    if(current == NULL || current->getRight() == NULL) { 
+    if(current == NULL) {
         return NULL;
     }
+    return current->Node<Key, Value>::getNext();
+}
 
-    if(current->getRight() != NULL) {
-        current = current->getRight();
-        while(current->getLeft() != NULL) {
-            current = current->getLeft();
-        }
-        return current;
-    }
-
-    else {  
-        if(current->getParent() == NULL) { //only left side of tree
-            return NULL;
-        } 
-        Node<Key, Value>* temp = current->getParent();
 
-        while(temp != NULL) {
-            temp = current->getParent();
-            if(temp->getLeft() != current) {
-                current = temp;
-            }
-            else if(temp->getLeft() == current) {
-                return current;
-            }
+/**
+* Storage for one node of bytes bytes. Every node of a tree has the
+* same size, which is remembered for giving the storage back.
+*/
+template<typename Key, typename Value>
+void* BinarySearchTree<Key, Value>::allocateNode(size_t bytes)
+{
+    nodeSize_ = bytes;
+    return allocate(bytes);
+}
+
+template<typename Key, typename Value>
+void* BinarySearchTree<Key, Value>::allocate(size_t bytes)
+{
+    if(resource_ == NULL) {
+        return ::operator new(bytes);
+    }
+    return resource_->allocate(bytes, alignof(std::max_align_t));
+}
+
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::deallocate(void* storage, size_t bytes)
+{
+    if(resource_ == NULL) {
+        ::operator delete(storage);
+        return;
+    }
+    resource_->deallocate(storage, bytes, alignof(std::max_align_t));
+}
+
+/**
+* Estimated bytes the allocator spends beyond the bytes asked for.
+*/
+template<typename Key, typename Value>
+size_t BinarySearchTree<Key, Value>::chunkOverhead(size_t bytes) const
+{
+    if(resource_ != NULL) {
+        size_t align = alignof(std::max_align_t);
+        return (bytes + align - 1) / align * align - bytes;
+    }
+    size_t chunk = (bytes + sizeof(size_t) + 15) / 16 * 16;
+    if(chunk < 32) {
+        chunk = 32;
+    }
+    return chunk - bytes;
+}
+
+/**
+* Adds every node under node to usage, tombstones included.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::measure(Node<Key, Value>* node, MemoryUsage& usage) const
+{
+    if(node == NULL) {
+        return;
+    }
+    ++usage.nodes;
+    if(node->isDeleted()) {
+        ++usage.deadNodes;
+    }
+    usage.deepBytes += DeepSize<Key>::of(node->getKey()) + DeepSize<Value>::of(node->getValue());
+    measure(node->getLeft(), usage);
+    measure(node->getRight(), usage);
+}
+
+/**
+* Every node leaves the tree through here. Nodes from a bulk-built block
+* are destroyed in place, and the block is freed once none are left;
+* everything else came from allocateNode.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::destroyNode(Node<Key, Value>* node)
+{
+    NodeBlock* block = detachNode(node);
+    node->~Node();
+    freeNode(node, block, resource_, nodeSize_);
+}
+
+/**
+* Drops an unlinked node from the tree's bookkeeping without freeing it,
+* for a node that lives on outside the tree. Returns the block holding
+* it, whose count still includes it, or NULL if it was allocated alone.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::NodeBlock*
+BinarySearchTree<Key, Value>::detachNode(Node<Key, Value>* node)
+{
+    ++generation_;
+    size_t i = findBlock(node);
+    if(i == blocks_.size()) {
+        return NULL;
+    }
+    NodeBlock* block = blocks_[i].block;
+    if(--blocks_[i].live == 0) {
+        blocks_.erase(blocks_.begin() + i);
+    }
+    return block;
+}
+
+/**
+* Gives back the storage of a destroyed node: the node itself if block
+* is NULL, otherwise the whole block once its last node is gone.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::freeNode(Node<Key, Value>* node, NodeBlock* block,
+    std::pmr::memory_resource* resource, size_t bytes)
+{
+    void* storage = node;
+    if(block != NULL) {
+        if(block->live.fetch_sub(1) != 1) {
+            return;
         }
+        storage = block->begin;
+        bytes = block->end - block->begin;
+        delete block;
     }
-    return NULL;
+    if(resource == NULL) {
+        ::operator delete(storage);
+        return;
+    }
+    resource->deallocate(storage, bytes, alignof(std::max_align_t));
+}
+
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::nodeAt(const iterator& it)
+{
+    return it.current_;
+}
+
+/**
+* Takes ownership of storage holding count nodes of nodeBytes each,
+* all constructed in place and about to be linked into the tree.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::adoptBlock(void* storage, size_t count, size_t nodeBytes)
+{
+    BlockRef ref;
+    ref.block = new NodeBlock;
+    ref.block->begin = static_cast<char*>(storage);
+    ref.block->end = ref.block->begin + count * nodeBytes;
+    ref.block->live.store(count);
+    ref.live = count;
+    size_t i = blocks_.size();
+    while(i > 0 && ref.block->begin < blocks_[i - 1].block->begin) {
+        --i;
+    }
+    blocks_.insert(blocks_.begin() + i, ref);
 }
 
+/**
+* The index in blocks_ of the block holding node, or blocks_.size() if
+* node was allocated on its own.
+*/
+template<typename Key, typename Value>
+size_t BinarySearchTree<Key, Value>::findBlock(const Node<Key, Value>* node) const
+{
+    const char* address = reinterpret_cast<const char*>(node);
+    size_t lo = 0;
+    size_t hi = blocks_.size();
+    while(lo < hi) { //first block starting after the node
+        size_t mid = lo + (hi - lo) / 2;
+        if(address < blocks_[mid].block->begin) {
+            hi = mid;
+        }
+        else {
+            lo = mid + 1;
+        }
+    }
+    if(lo > 0 && address < blocks_[lo - 1].block->end) {
+        return lo - 1;
+    }
+    return blocks_.size();
+}
+
+/**
+* Hands the block references for every node in the subtree rooted at
+* node over to the tree that now holds them. O(size of the subtree),
+* and free when there are no blocks.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::moveBlockRefs(Node<Key, Value>* node, BinarySearchTree<Key, Value>& to)
+{
+    if(blocks_.empty() || node == NULL) {
+        return;
+    }
+    moveBlockRefs(node->getLeft(), to);
+    moveBlockRefs(node->getRight(), to);
+    size_t i = findBlock(node);
+    if(i == blocks_.size()) {
+        return;
+    }
+    NodeBlock* block = blocks_[i].block;
+    if(--blocks_[i].live == 0) {
+        blocks_.erase(blocks_.begin() + i);
+    }
+    to.addBlockRef(block);
+}
+
+/**
+* Counts one more node of block as linked into this tree.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::addBlockRef(NodeBlock* block)
+{
+    size_t j = 0;
+    while(j < blocks_.size() && blocks_[j].block->begin < block->begin) {
+        ++j;
+    }
+    if(j == blocks_.size() || blocks_[j].block != block) {
+        BlockRef ref;
+        ref.block = block;
+        ref.live = 0;
+        blocks_.insert(blocks_.begin() + j, ref);
+    }
+    ++blocks_[j].live;
+}
+
+/**
+* Merges every block reference of from into this tree, after all of
+* from's nodes were linked in here.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::takeBlockRefs(BinarySearchTree<Key, Value>& from)
+{
+    for(size_t i = 0; i < from.blocks_.size(); ++i) {
+        const BlockRef& ref = from.blocks_[i];
+        size_t j = 0;
+        while(j < blocks_.size() && blocks_[j].block->begin < ref.block->begin) {
+            ++j;
+        }
+        if(j < blocks_.size() && blocks_[j].block == ref.block) {
+            blocks_[j].live += ref.live;
+        }
+        else {
+            blocks_.insert(blocks_.begin() + j, ref);
+        }
+    }
+    from.blocks_.clear();
+}
 
 /**
 * A method to remove all contents of the tree and
@@ -734,37 +1585,119 @@ void BinarySearchTree<Key, Value>::clear()
     Node<Key, Value>* node(root_);
     postOrder(node);
     root_ = NULL;
+    size_ = 0;
+    min_ = NULL;
+    max_ = NULL;
 }
 
+/**
+* Empties the tree like clear, but in O(1) when that is safe: the nodes
+* come from a memory resource and neither Key nor Value needs its
+* destructor run. The nodes are then simply forgotten, and their memory
+* is reclaimed when the resource is released, which is the point of a
+* std::pmr::monotonic_buffer_resource or a per-request arena. Any other
+* tree is cleared node by node.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::release()
+{
+    if(resource_ == NULL || !std::is_trivially_destructible<Key>::value ||
+        !std::is_trivially_destructible<Value>::value) {
+        clear();
+        return;
+    }
+    for(size_t i = 0; i < blocks_.size(); ++i) {
+        if(blocks_[i].block->live.fetch_sub(blocks_[i].live) == blocks_[i].live) {
+            delete blocks_[i].block;
+        }
+    }
+    blocks_.clear();
+    ++generation_;
+    root_ = NULL;
+    size_ = 0;
+    min_ = NULL;
+    max_ = NULL;
+}
+
+/**
+* The resource nodes are allocated from, or NULL for the global heap.
+*/
+template<typename Key, typename Value>
+std::pmr::memory_resource* BinarySearchTree<Key, Value>::resource() const
+{
+    return resource_;
+}
+
+/**
+* Frees every node in the subtree rooted at node and returns how many there were.
+*/
 template<class Key, class Value>
-void BinarySearchTree<Key, Value>::postOrder(Node<Key, Value>* node) {
+size_t BinarySearchTree<Key, Value>::postOrder(Node<Key, Value>* node) {
 
     if(node == NULL) {
-        return;
+        return 0;
     }
-    postOrder(node->getLeft());
-    postOrder(node->getRight());
-    delete node;
+    size_t count = postOrder(node->getLeft());
+    count += postOrder(node->getRight());
+    destroyNode(node);
+    return count + 1;
 }
 
 
 /**
 * A helper function to find the smallest node in the tree.
+* The node is cached, so this does not walk the left spine.
 */
 template<typename Key, typename Value>
 Node<Key, Value>*
 BinarySearchTree<Key, Value>::getSmallestNode() const
 {
-    Node<Key, Value>* temp(root_);
+    return min_;
+}
 
-    if(temp == NULL) {
-        return NULL;
+/**
+* Bookkeeping for a node that was just linked into the tree.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::noteInsert(Node<Key, Value>* node)
+{
+    ++size_;
+    if(min_ == NULL || node->getKey() < min_->getKey()) {
+        min_ = node;
     }
+    if(max_ == NULL || max_->getKey() < node->getKey()) {
+        max_ = node;
+    }
+}
 
-    while(temp->getLeft() != NULL) {
-        temp = temp->getLeft();
+/**
+* Bookkeeping for a node that is about to be unlinked. Must be called
+* while the node is still in place so the new min/max can be found
+* from its neighbours: the smallest node has no left child, so the next
+* smallest is either the leftmost node of its right subtree or its parent.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::noteRemove(Node<Key, Value>* node)
+{
+    --size_;
+    if(node == min_) {
+        min_ = node->getParent();
+        if(node->getRight() != NULL) {
+            min_ = node->getRight();
+            while(min_->getLeft() != NULL) {
+                min_ = min_->getLeft();
+            }
+        }
+    }
+    if(node == max_) {
+        max_ = node->getParent();
+        if(node->getLeft() != NULL) {
+            max_ = node->getLeft();
+            while(max_->getRight() != NULL) {
+                max_ = max_->getRight();
+            }
+        }
     }
-    return temp;
 }
 
 /**
@@ -778,7 +1711,7 @@ Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) con
     Node<Key, Value>* temp(root_);
 
     while(temp != NULL) {
-        Key this_key = temp->getKey();
+        const Key& this_key = temp->getKey();
         if(key == this_key) {
             return temp;
         }
@@ -792,6 +1725,84 @@ Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) con
     return NULL;
 }
 
+/**
+* Helper function to find the node with the smallest key that is not
+* less than k, or NULL if every key is less than k
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::internalLowerBound(const Key& key) const
+{
+    Node<Key, Value>* temp(root_);
+    Node<Key, Value>* result = NULL;
+
+    while(temp != NULL) {
+        if(temp->getKey() < key) {
+            temp = temp->getRight();
+        }
+        else {
+            result = temp;
+            temp = temp->getLeft();
+        }
+    }
+    return result;
+}
+
+/**
+* The lowest node not less than key, searching from start instead of the
+* root. It climbs only while start's subtree cannot hold key's position,
+* so for a key d ranks away it usually stops about log d levels up in a
+* balanced tree. A key just across a high ancestor, such as the root,
+* still climbs to it: parent pointers alone cannot avoid that.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::fingerLowerBound(Node<Key, Value>* start, const Key& key) const
+{
+    Node<Key, Value>* x = start;
+    if(key < x->getKey()) {
+        //stop below an ancestor smaller than key, which bounds x's subtree from below
+        while(x->getParent() != NULL) {
+            Node<Key, Value>* p = x->getParent();
+            if(x == p->getRight() && p->getKey() < key) {
+                break;
+            }
+            x = p;
+        }
+    }
+    else if(x->getKey() < key) {
+        //stop below an ancestor not smaller than key, which bounds it from above
+        while(x->getParent() != NULL) {
+            Node<Key, Value>* p = x->getParent();
+            if(x == p->getLeft() && !(p->getKey() < key)) {
+                break;
+            }
+            x = p;
+        }
+    }
+    else {
+        return x;
+    }
+
+    Node<Key, Value>* temp = x;
+    Node<Key, Value>* result = NULL;
+    while(temp != NULL) {
+        if(temp->getKey() < key) {
+            temp = temp->getRight();
+        }
+        else {
+            result = temp;
+            temp = temp->getLeft();
+        }
+    }
+    if(result != NULL) {
+        return result;
+    }
+    //every key under x is smaller: the answer is the first ancestor x is left of
+    while(x->getParent() != NULL && x == x->getParent()->getRight()) {
+        x = x->getParent();
+    }
+    return x->getParent();
+}
+
 /**
  * Return true iff the BST is balanced.
  */
@@ -829,6 +1840,118 @@ int BinarySearchTree<Key, Value>::height(Node<Key, Value>* node, bool& balanced)
     
 }
 
+/**
+* Re-finds the cached min/max nodes after a bulk change, in O(depth).
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::resetBounds()
+{
+    min_ = root_;
+    max_ = root_;
+    if(root_ == NULL) {
+        return;
+    }
+    while(min_->getLeft() != NULL) {
+        min_ = min_->getLeft();
+    }
+    while(max_->getRight() != NULL) {
+        max_ = max_->getRight();
+    }
+    skipDeletedBounds();
+}
+
+/**
+* Moves the cached min/max inwards past any tombstones.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::skipDeletedBounds()
+{
+    while(min_ != NULL && min_->isDeleted()) {
+        min_ = successor(min_);
+    }
+    while(max_ != NULL && max_->isDeleted()) {
+        max_ = predecessor(max_);
+    }
+}
+
+/**
+* Frees the nodes of a subtree whose keys are in [lo, hi] and returns the
+* root of what is left, adding the number freed to count. Whatever survives
+* on the left of a freed node is smaller than lo and whatever survives on
+* its right is larger than hi, so the two sides are joined by hanging the
+* right one off the largest node of the left one.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::trim(Node<Key, Value>* node, const Key& lo, const Key& hi, size_t& count)
+{
+    if(node == NULL) {
+        return NULL;
+    }
+    if(node->getKey() < lo) {
+        Node<Key, Value>* right = trim(node->getRight(), lo, hi, count);
+        node->setRight(right);
+        if(right != NULL) {
+            right->setParent(node);
+        }
+        return node;
+    }
+    if(hi < node->getKey()) {
+        Node<Key, Value>* left = trim(node->getLeft(), lo, hi, count);
+        node->setLeft(left);
+        if(left != NULL) {
+            left->setParent(node);
+        }
+        return node;
+    }
+
+    Node<Key, Value>* left = trim(node->getLeft(), lo, hi, count);
+    Node<Key, Value>* right = trim(node->getRight(), lo, hi, count);
+    destroyNode(node);
+    ++count;
+
+    if(left == NULL) {
+        return right;
+    }
+    if(right != NULL) {
+        Node<Key, Value>* temp = left;
+        while(temp->getRight() != NULL) {
+            temp = temp->getRight();
+        }
+        temp->setRight(right);
+        right->setParent(temp);
+    }
+    return left;
+}
+
+/**
+ * Returns the number of levels in the tree. A plain BST has no shape
+ * information, so this visits every node.
+ */
+template<typename Key, typename Value>
+int BinarySearchTree<Key, Value>::height() const
+{
+    return subtreeHeight(root_);
+}
+
+template<typename Key, typename Value>
+int BinarySearchTree<Key, Value>::subtreeHeight(Node<Key, Value>* node) {
+    if(node == NULL) {
+        return 0;
+    }
+    return 1 + maxHeight(subtreeHeight(node->getLeft()), subtreeHeight(node->getRight()));
+}
+
+/**
+* Counts the nodes of a subtree, tombstones included. O(n).
+*/
+template<typename Key, typename Value>
+size_t BinarySearchTree<Key, Value>::subtreeSize(Node<Key, Value>* node) {
+    if(node == NULL) {
+        return 0;
+    }
+    return 1 + subtreeSize(node->getLeft()) + subtreeSize(node->getRight());
+}
+
 template<typename Key, typename Value>
 int BinarySearchTree<Key, Value>::maxHeight(int left, int right) {
     if(left >= right) {
@@ -841,6 +1964,243 @@ int BinarySearchTree<Key, Value>::maxHeight(int left, int right) {
 
 
 
+/**
+* Rotates node down to the left, so its right child takes its place.
+* Shared by every balanced tree built on top of this class.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::rotateLeft(Node<Key, Value>* node) {
+    Node<Key, Value>* parent = NULL;
+    Node<Key, Value>* child = node->getRight();
+
+    //node has a parent
+    if(node->getParent() != NULL) {
+        parent = node->getParent();
+
+        if(parent->getLeft() == node) { //node is left child
+            parent->setLeft(child);
+        }
+        else { //node is right child
+            parent->setRight(child);
+        }
+    }
+    else { //child becomes root
+        root_ = child;
+    }
+
+    child->setParent(parent);
+
+    Node<Key, Value>* left = child->getLeft();
+    if(left != NULL) {
+        left->setParent(node);
+    }
+
+    child->setLeft(node);
+    node->setParent(child);
+
+    node->setRight(left);
+}
+
+/**
+* Rotates node down to the right, so its left child takes its place.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::rotateRight(Node<Key, Value>* node) {
+    Node<Key, Value>* parent = NULL;
+    Node<Key, Value>* child = node->getLeft();
+
+    //node has a parent
+    if(node->getParent() != NULL) {
+        parent = node->getParent();
+
+        if(parent->getLeft() == node) { //node is left child
+            parent->setLeft(child);
+        }
+        else { //node is right child
+            parent->setRight(child);
+        }
+    }
+    else { //child becomes root
+        root_ = child;
+    }
+
+    child->setParent(parent);
+
+    Node<Key, Value>* right = child->getRight();
+    if(right != NULL) {
+        right->setParent(node);
+    }
+
+    child->setRight(node);
+    node->setParent(child);
+
+    node->setLeft(right);
+}
+
+/**
+* Appends the nodes of the subtree rooted at node to out, in key order.
+* Uses an explicit stack so degenerate (list-shaped) trees are fine.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::flatten(Node<Key, Value>* node, std::vector<Node<Key, Value>*>& out)
+{
+    std::vector<Node<Key, Value>*> stack;
+    while(node != NULL || !stack.empty()) {
+        while(node != NULL) {
+            stack.push_back(node);
+            node = node->getLeft();
+        }
+        node = stack.back();
+        stack.pop_back();
+        out.push_back(node);
+        node = node->getRight();
+    }
+}
+
+/**
+* Relinks nodes[lo, hi), which must be in key order, into a perfectly
+* balanced subtree hanging from parent and returns its root.
+* No nodes are allocated or freed.
+*/
+template<class Key, class Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::buildBalanced(std::vector<Node<Key, Value>*>& nodes,
+    size_t lo, size_t hi, Node<Key, Value>* parent)
+{
+    if(lo >= hi) {
+        return NULL;
+    }
+    size_t mid = lo + (hi - lo) / 2;
+    Node<Key, Value>* root = nodes[mid];
+    root->setParent(parent);
+    root->setLeft(buildBalanced(nodes, lo, mid, root));
+    root->setRight(buildBalanced(nodes, mid + 1, hi, root));
+    return root;
+}
+
+/**
+* Counts every sampleEvery-th find by key from now on, or stops counting
+* if sampleEvery is 0. The counts gathered so far are kept either way.
+* Sampling costs one atomic increment per find, and a locked map update
+* per sample, so concurrent readers may profile too.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::setProfiling(size_t sampleEvery)
+{
+    profileEvery_.store(sampleEvery, std::memory_order_relaxed);
+}
+
+/**
+* Reshapes the tree to minimize the expected depth of the sampled finds,
+* reusing the nodes, in O(n log n). The root of every subtree is the key
+* that best splits its range's sampled weight in half (Mehlhorn's
+* bisection rule), which puts each key within about two levels of its
+* depth in the optimal tree. Knuth's exact algorithm needs O(n^2) time
+* and space, too much for a large dictionary. A sampled find for an
+* absent key weighs on the gap where it would have been, so frequent
+* misses are also cut short. Every key gets one extra count, so keys
+* that were never sampled still end up at depth O(log n).
+*
+* Ends with the counts reset. The shape ignores any balance invariant,
+* so trees that keep one override this to throw std::logic_error.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::rebuildOptimal()
+{
+    std::vector<Node<Key, Value>*> nodes;
+    nodes.reserve(size_);
+    flatten(root_, nodes);
+
+    //hits[i] weighs nodes[i], gaps[i] the gap just before it
+    std::vector<uint64_t> hits(nodes.size(), 1);
+    std::vector<uint64_t> gaps(nodes.size() + 1, 0);
+    {
+        std::lock_guard<std::mutex> lock(profileLock_);
+        size_t i = 0;
+        typename std::map<Key, uint64_t>::const_iterator it;
+        for(it = profile_.begin(); it != profile_.end(); ++it) {
+            while(i < nodes.size() && nodes[i]->getKey() < it->first) {
+                ++i;
+            }
+            if(i < nodes.size() && !(it->first < nodes[i]->getKey())) {
+                hits[i] += it->second;
+            }
+            else {
+                gaps[i] += it->second;
+            }
+        }
+        profile_.clear();
+    }
+
+    std::vector<uint64_t> prefix(nodes.size() + 1, 0);
+    for(size_t i = 0; i < nodes.size(); ++i) {
+        prefix[i + 1] = prefix[i] + gaps[i] + hits[i];
+    }
+    root_ = buildWeighted(nodes, prefix, gaps, 0, nodes.size(), NULL);
+}
+
+/**
+* Records one find of key if it is the every-th. find reads the sampling
+* rate once and passes it in, so a concurrent setProfiling(0) cannot
+* make it 0 here.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::profileLookup(const Key& key, size_t every) const
+{
+    if(profileTick_.fetch_add(1, std::memory_order_relaxed) % every != 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(profileLock_);
+    ++profile_[key];
+}
+
+/**
+* Links nodes[lo, hi) into a subtree under parent, rooted at the node r
+* where the weight left of it (nodes and gaps lo..r) and the weight
+* right of it (gaps and nodes after r) are closest. prefix[i] is the
+* weight of gaps and nodes before node i, not counting gap i.
+*/
+template<class Key, class Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::buildWeighted(std::vector<Node<Key, Value>*>& nodes,
+    const std::vector<uint64_t>& prefix, const std::vector<uint64_t>& gaps,
+    size_t lo, size_t hi, Node<Key, Value>* parent)
+{
+    if(lo >= hi) {
+        return NULL;
+    }
+    //left grows and right shrinks with r, so binary search for the crossing
+    uint64_t end = prefix[hi] + gaps[hi];
+    size_t first = lo, last = hi - 1;
+    while(first < last) {
+        size_t r = first + (last - first) / 2;
+        uint64_t left = prefix[r] - prefix[lo] + gaps[r];
+        uint64_t right = end - prefix[r + 1];
+        if(left < right) {
+            first = r + 1;
+        }
+        else {
+            last = r;
+        }
+    }
+    size_t r = first;
+    if(r > lo) {
+        uint64_t left = prefix[r] - prefix[lo] + gaps[r];
+        uint64_t right = end - prefix[r + 1];
+        uint64_t prevLeft = prefix[r - 1] - prefix[lo] + gaps[r - 1];
+        uint64_t prevRight = end - prefix[r];
+        uint64_t diff = (left > right) ? left - right : right - left;
+        uint64_t prevDiff = (prevLeft > prevRight) ? prevLeft - prevRight : prevRight - prevLeft;
+        if(prevDiff < diff) {
+            r = r - 1;
+        }
+    }
+
+    Node<Key, Value>* root = nodes[r];
+    root->setParent(parent);
+    root->setLeft(buildWeighted(nodes, prefix, gaps, lo, r, root));
+    root->setRight(buildWeighted(nodes, prefix, gaps, r + 1, hi, root));
+    return root;
+}
+
 template<typename Key, typename Value>
 void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
 {
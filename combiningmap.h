@@ -0,0 +1,339 @@
+#ifndef COMBININGMAP_H
+#define COMBININGMAP_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+
+/**
+* A thread-safe AVLTree that uses flat combining instead of having every
+* thread take a lock and walk the tree itself. A thread publishes its
+* insert, remove or find in a slot of a shared array and then either
+* waits for the answer or, if no one else is combining, becomes the
+* combiner. The combiner gathers every pending request, sorts them by
+* key and applies them in one ordered pass: requests on the same key
+* are folded together so the tree is touched once per distinct key. It
+* then writes each answer back into its slot. The tree, its root and the
+* hot upper levels stay in one core's cache instead of bouncing between
+* all writers.
+*
+* Requests that are pending at the same time are concurrent, so any order
+* among them is a valid one. The combiner keeps them in slot order per key.
+*
+* If applying a request throws (copying a key or value, or allocating a
+* node), the combiner records the exception in the slot of every request
+* on that key and moves on; each of those calls rethrows it in its own
+* thread. Requests on other keys are not affected.
+*
+* Key and Value must be default constructible, since slots hold copies.
+*/
+template <class Key, class Value>
+class CombiningAVLMap
+{
+public:
+    CombiningAVLMap(size_t slots = 128);
+
+    bool insert(const std::pair<const Key, Value>& new_item);
+    bool erase(const Key& key);
+    bool find(const Key& key, Value& value);
+    size_t size();
+
+    // Runs f(key, value) over every item in key order while holding the
+    // combiner lock, so f must not call back into the map.
+    template<class F> void forEach(F f);
+
+protected:
+    enum Op { INSERT, ERASE, FIND };
+    enum State { EMPTY, CLAIMED, PENDING, DONE };
+
+    /**
+    * One published request. Each sits on its own cache line so that
+    * threads spinning on their own slot do not disturb each other.
+    */
+    struct alignas(64) Slot
+    {
+        Slot() : state(EMPTY), op(INSERT), found(false) { }
+
+        std::atomic<int> state;
+        Op op;
+        Key key;
+        Value value;
+        bool found; //result: key was present before the request
+        std::exception_ptr error; //set instead of a result if applying it threw
+    };
+
+    // Add helper functions here
+    Slot& publish(Op op, const Key& key, const Value& value);
+    void wait(Slot& slot);
+    void combine();
+    void apply(size_t begin, size_t end);
+    void fail(size_t begin, size_t end);
+    static bool byKey(Slot* a, Slot* b);
+
+protected:
+    AVLTree<Key, Value> tree_;
+    std::vector<Slot> slots_;
+    std::mutex combiner_;
+    std::vector<Slot*> batch_; //only touched by the combiner
+};
+
+template<class Key, class Value>
+CombiningAVLMap<Key, Value>::CombiningAVLMap(size_t slots) :
+    slots_(slots)
+{
+    if(slots == 0) {
+        throw std::out_of_range("Invalid slot count");
+    }
+    batch_.reserve(slots);
+}
+
+/**
+* Inserts or overwrites. Returns true if the key was not already present.
+*/
+template<class Key, class Value>
+bool CombiningAVLMap<Key, Value>::insert(const std::pair<const Key, Value>& new_item)
+{
+    Slot& slot = publish(INSERT, new_item.first, new_item.second);
+    wait(slot);
+    bool found = slot.found;
+    slot.state.store(EMPTY, std::memory_order_release);
+    return !found;
+}
+
+/**
+* Removes key. Returns true if it was present.
+*/
+template<class Key, class Value>
+bool CombiningAVLMap<Key, Value>::erase(const Key& key)
+{
+    Slot& slot = publish(ERASE, key, Value());
+    wait(slot);
+    bool found = slot.found;
+    slot.state.store(EMPTY, std::memory_order_release);
+    return found;
+}
+
+/**
+* Copies the value for key into value and returns true if key is present.
+*/
+template<class Key, class Value>
+bool CombiningAVLMap<Key, Value>::find(const Key& key, Value& value)
+{
+    Slot& slot = publish(FIND, key, Value());
+    wait(slot);
+    bool found = slot.found;
+    if(found) {
+        value = slot.value;
+    }
+    slot.state.store(EMPTY, std::memory_order_release);
+    return found;
+}
+
+template<class Key, class Value>
+size_t CombiningAVLMap<Key, Value>::size()
+{
+    std::lock_guard<std::mutex> lock(combiner_);
+    return tree_.size();
+}
+
+template<class Key, class Value>
+template<class F>
+void CombiningAVLMap<Key, Value>::forEach(F f)
+{
+    std::lock_guard<std::mutex> lock(combiner_);
+    for(typename AVLTree<Key, Value>::iterator it = tree_.begin(); it != tree_.end(); ++it) {
+        f(it->first, it->second);
+    }
+}
+
+/**
+* Claims a free slot, starting from one picked by thread id so threads
+* usually come back to the same slot, and publishes the request in it.
+*/
+template<class Key, class Value>
+typename CombiningAVLMap<Key, Value>::Slot&
+CombiningAVLMap<Key, Value>::publish(Op op, const Key& key, const Value& value)
+{
+    size_t i = std::hash<std::thread::id>()(std::this_thread::get_id()) % slots_.size();
+    while(true) {
+        for(size_t n = 0; n < slots_.size(); ++n) {
+            Slot& slot = slots_[i];
+            int expected = EMPTY;
+            if(slot.state.load(std::memory_order_relaxed) == EMPTY &&
+                slot.state.compare_exchange_strong(expected, CLAIMED, std::memory_order_acquire)) {
+                try {
+                    slot.op = op;
+                    slot.key = key;
+                    slot.value = value;
+                }
+                catch(...) {
+                    slot.state.store(EMPTY, std::memory_order_release);
+                    throw;
+                }
+                slot.state.store(PENDING, std::memory_order_release);
+                return slot;
+            }
+            i = (i + 1 == slots_.size()) ? 0 : i + 1;
+        }
+        std::this_thread::yield(); //more threads than slots
+    }
+}
+
+/**
+* Waits until slot is answered, combining whenever the combiner lock is
+* free. If the combiner failed the request, frees the slot and rethrows.
+*/
+template<class Key, class Value>
+void CombiningAVLMap<Key, Value>::wait(Slot& slot)
+{
+    while(slot.state.load(std::memory_order_acquire) != DONE) {
+        std::unique_lock<std::mutex> lock(combiner_, std::try_to_lock);
+        if(lock.owns_lock()) {
+            combine();
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+    if(slot.error) {
+        std::exception_ptr error = slot.error;
+        slot.error = std::exception_ptr();
+        slot.state.store(EMPTY, std::memory_order_release);
+        std::rethrow_exception(error);
+    }
+}
+
+/**
+* Applies every pending request. Requests are sorted by key so the tree
+* is walked in order, and all requests on one key are folded into at most
+* one lookup and one insert or remove. Requests published while this runs
+* are picked up by a few extra passes before giving up the lock.
+*/
+template<class Key, class Value>
+void CombiningAVLMap<Key, Value>::combine()
+{
+    for(int pass = 0; pass < 3; ++pass) {
+        batch_.clear();
+        for(size_t i = 0; i < slots_.size(); ++i) {
+            if(slots_[i].state.load(std::memory_order_acquire) == PENDING) {
+                batch_.push_back(&slots_[i]);
+            }
+        }
+        if(batch_.empty()) {
+            return;
+        }
+        try {
+            std::stable_sort(batch_.begin(), batch_.end(), byKey);
+        }
+        catch(...) {
+            fail(0, batch_.size());
+            continue;
+        }
+
+        size_t begin = 0;
+        while(begin < batch_.size()) {
+            const Key& key = batch_[begin]->key;
+            size_t end = begin + 1;
+            while(end < batch_.size() && !(key < batch_[end]->key)) {
+                ++end;
+            }
+            try {
+                apply(begin, end);
+            }
+            catch(...) {
+                fail(begin, end);
+            }
+            begin = end;
+        }
+    }
+}
+
+/**
+* Applies batch_[begin, end), the requests on one key, and answers them.
+*/
+template<class Key, class Value>
+void CombiningAVLMap<Key, Value>::apply(size_t begin, size_t end)
+{
+    const Key& key = batch_[begin]->key;
+
+    //a lone write needs no lookup: the size change tells if the key was there
+    if(end == begin + 1 && batch_[begin]->op != FIND) {
+        Slot* slot = batch_[begin];
+        size_t before = tree_.size();
+        if(slot->op == INSERT) {
+            tree_.insert(std::make_pair(key, slot->value));
+            slot->found = (tree_.size() == before);
+        }
+        else {
+            tree_.remove(key);
+            slot->found = (tree_.size() != before);
+        }
+        slot->state.store(DONE, std::memory_order_release);
+        return;
+    }
+
+    //replay the group against the key's current state
+    typename AVLTree<Key, Value>::iterator it = tree_.find(key);
+    bool present = (it != tree_.end());
+    Value value = present ? it->second : Value();
+    bool written = false;
+    for(size_t i = begin; i < end; ++i) {
+        Slot* slot = batch_[i];
+        slot->found = present;
+        if(slot->op == INSERT) {
+            value = slot->value;
+            present = true;
+            written = true;
+        }
+        else if(slot->op == ERASE) {
+            present = false;
+            written = true;
+        }
+        else if(present) {
+            slot->value = value;
+        }
+    }
+
+    if(written) {
+        if(present) {
+            tree_.insert(std::make_pair(key, value));
+        }
+        else if(it != tree_.end()) {
+            tree_.erase(it);
+        }
+    }
+
+    for(size_t i = begin; i < end; ++i) {
+        batch_[i]->state.store(DONE, std::memory_order_release);
+    }
+}
+
+/**
+* Answers every request in batch_[begin, end) with the exception being
+* handled, for its owner to rethrow.
+*/
+template<class Key, class Value>
+void CombiningAVLMap<Key, Value>::fail(size_t begin, size_t end)
+{
+    std::exception_ptr error = std::current_exception();
+    for(size_t i = begin; i < end; ++i) {
+        batch_[i]->error = error;
+        batch_[i]->state.store(DONE, std::memory_order_release);
+    }
+}
+
+template<class Key, class Value>
+bool CombiningAVLMap<Key, Value>::byKey(Slot* a, Slot* b)
+{
+    return a->key < b->key;
+}
+
+
+#endif
@@ -0,0 +1,308 @@
+#include <iostream>
+#include <csignal>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "durablemap.h"
+
+/**
+* Recovery checks for DurableAVLMap: reopening, replay after a
+* checkpoint, torn and corrupt log tails, log write failures, and
+* writers killed at random points. Prints each failed check and exits
+* non-zero if there was one.
+*/
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if(!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl; \
+            ++failures; \
+        } \
+    } while(0)
+
+#define CHECK_THROWS(expr, type) \
+    do { \
+        bool thrown = false; \
+        try { expr; } \
+        catch(type&) { thrown = true; } \
+        CHECK(thrown && #expr " throws " #type); \
+    } while(0)
+
+typedef DurableAVLMap<int, long> Map;
+
+static const std::string dir = (std::filesystem::temp_directory_path() / "durablemap-test").string();
+
+std::map<int, long> contents(const Map& m)
+{
+    std::map<int, long> items;
+    m.forEach([&items](const int& key, const long& value) { items[key] = value; });
+    return items;
+}
+
+/**
+* Appends a record header promising 32 bytes followed by fewer, as a
+* crash in the middle of a write leaves behind.
+*/
+void tearSegment(uint64_t segment)
+{
+    std::FILE* f = std::fopen((dir + "/wal." + std::to_string(segment)).c_str(), "ab");
+    std::fwrite("\x20\0\0\0garbage", 1, 11, f);
+    std::fclose(f);
+}
+
+uint64_t lastSegment()
+{
+    uint64_t last = 0;
+    for(const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(dir)) {
+        std::string name = entry.path().filename().string();
+        if(name.compare(0, 4, "wal.") == 0) {
+            last = std::max<uint64_t>(last, std::stoull(name.substr(4)));
+        }
+    }
+    return last;
+}
+
+void testReopen()
+{
+    std::filesystem::remove_all(dir);
+    std::mt19937 rng(1);
+    std::map<int, long> ref;
+    {
+        Map::Options options;
+        options.checkpointBytes = 0;
+        Map m(dir, options);
+        for(int i = 0; i < 5000; ++i) {
+            int k = rng() % 1000;
+            if(rng() % 4) {
+                m.insert(std::make_pair(k, static_cast<long>(i)));
+                ref[k] = i;
+            }
+            else {
+                CHECK(m.erase(k) == (ref.erase(k) > 0));
+            }
+        }
+        CHECK(contents(m) == ref);
+    }
+    {
+        Map m(dir);
+        CHECK(contents(m) == ref);
+        CHECK(m.replayed() > 0);
+        m.checkpoint();
+        for(int i = 0; i < 100; ++i) {
+            m.insert(std::make_pair(i, static_cast<long>(-i)));
+            ref[i] = -i;
+        }
+    }
+    {
+        //only what came after the checkpoint is replayed
+        Map m(dir);
+        CHECK(contents(m) == ref);
+        CHECK(m.replayed() == 100);
+    }
+
+    std::filesystem::remove_all(dir);
+    {
+        Map::Options options;
+        options.checkpointBytes = 64 << 10;
+        Map m(dir, options);
+        std::vector<std::thread> writers;
+        for(int t = 0; t < 4; ++t) {
+            writers.push_back(std::thread([&m, t] {
+                for(int i = 0; i < 10000; ++i) {
+                    int k = t * 100000 + i % 3000;
+                    if(i % 5 == 4) {
+                        m.erase(k);
+                    }
+                    else {
+                        m.insert(std::make_pair(k, static_cast<long>(i)));
+                    }
+                }
+            }));
+        }
+        for(size_t t = 0; t < writers.size(); ++t) {
+            writers[t].join();
+        }
+        ref = contents(m);
+    }
+    {
+        Map m(dir);
+        CHECK(contents(m) == ref);
+    }
+}
+
+void testTornTails()
+{
+    std::filesystem::remove_all(dir);
+    Map::Options options;
+    options.checkpointBytes = 0;
+    {
+        Map m(dir, options);
+        for(int i = 0; i < 50; ++i) {
+            m.insert(std::make_pair(i, static_cast<long>(i)));
+        }
+    }
+
+    //at the end of the last segment
+    tearSegment(lastSegment());
+    {
+        Map m(dir);
+        CHECK(m.size() == 50);
+        m.insert(std::make_pair(50, 50L));
+    }
+
+    //at the end of a segment followed only by an empty one
+    tearSegment(lastSegment());
+    std::fclose(std::fopen((dir + "/wal." + std::to_string(lastSegment() + 1)).c_str(), "wb"));
+    {
+        Map m(dir);
+        CHECK(m.size() == 51);
+        m.insert(std::make_pair(51, 51L));
+    }
+    {
+        Map m(dir);
+        CHECK(m.size() == 52);
+    }
+
+    //before a segment holding records it is corruption; each open
+    //starts a new segment, so the previous one is followed by this one
+    {
+        Map m(dir, options);
+        m.insert(std::make_pair(52, 52L));
+    }
+    tearSegment(lastSegment() - 1);
+    CHECK_THROWS(Map m(dir), std::runtime_error);
+}
+
+/**
+* Lets a test make every later write to the current segment fail, by
+* putting a read-only descriptor in its place.
+*/
+struct BreakableMap : public Map
+{
+    using Map::Map;
+
+    void breakLog()
+    {
+        int readOnly = ::open("/dev/null", O_RDONLY);
+        ::dup2(readOnly, fd_);
+        ::close(readOnly);
+    }
+};
+
+void testLogFailure()
+{
+    const Map::SyncMode modes[] = { Map::SYNC_GROUP, Map::SYNC_EACH };
+    for(int mode = 0; mode < 2; ++mode) {
+        std::filesystem::remove_all(dir);
+        {
+            Map::Options options;
+            options.checkpointBytes = 0;
+            options.sync = modes[mode];
+            BreakableMap m(dir, options);
+            for(int i = 0; i < 100; ++i) {
+                m.insert(std::make_pair(i, static_cast<long>(i)));
+            }
+            m.breakLog();
+            CHECK_THROWS(m.insert(std::make_pair(1000, 1L)), std::runtime_error);
+
+            //nothing can commit behind the lost record
+            CHECK_THROWS(m.insert(std::make_pair(1001, 1L)), std::runtime_error);
+            CHECK_THROWS(m.erase(5), std::runtime_error);
+            CHECK_THROWS(m.checkpoint(), std::runtime_error);
+            CHECK(m.size() == 101);
+        }
+        Map m(dir);
+        CHECK(m.size() == 100);
+    }
+}
+
+/**
+* Kills a writer at a random point and checks that what comes back is
+* the state after some prefix of its operations, no shorter than the
+* ones it saw return.
+*/
+void testCrashes()
+{
+    std::mt19937 rng(3);
+    long* acked = static_cast<long*>(::mmap(NULL, sizeof(long), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+    for(int trial = 0; trial < 12; ++trial) {
+        std::filesystem::remove_all(dir);
+        *acked = 0;
+        unsigned seed = rng();
+        pid_t pid = ::fork();
+        if(pid == 0) {
+            Map::Options options;
+            options.sync = (trial % 2) ? Map::SYNC_NONE : Map::SYNC_GROUP;
+            options.checkpointBytes = 8 << 10;
+            Map* m = new Map(dir, options);
+            std::mt19937 ops(seed);
+            for(long i = 1; ; ++i) {
+                int k = ops() % 500;
+                if(ops() % 4) {
+                    m->insert(std::make_pair(k, i));
+                }
+                else {
+                    m->erase(k);
+                }
+                *acked = i;
+            }
+        }
+        ::usleep(20000 + rng() % 80000);
+        ::kill(pid, SIGKILL);
+        ::waitpid(pid, NULL, 0);
+
+        long done = *acked;
+        Map m(dir);
+        std::map<int, long> got = contents(m);
+        std::map<int, long> state;
+        std::mt19937 ops(seed);
+        bool matched = false;
+        for(long i = 1; i <= done + 1 && !matched; ++i) {
+            int k = ops() % 500;
+            if(ops() % 4) {
+                state[k] = i;
+            }
+            else {
+                state.erase(k);
+            }
+            matched = i >= done && state == got;
+        }
+        CHECK(matched);
+    }
+    ::munmap(acked, sizeof(long));
+}
+
+int main()
+{
+    struct Test
+    {
+        const char* name;
+        void (*run)();
+    };
+    const Test tests[] = {
+        { "reopen", testReopen },
+        { "tornTails", testTornTails },
+        { "logFailure", testLogFailure },
+        { "crashes", testCrashes },
+    };
+    for(size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i) {
+        int before = failures;
+        tests[i].run();
+        std::cout << (failures == before ? "ok     " : "FAILED ") << tests[i].name << std::endl;
+    }
+    std::filesystem::remove_all(dir);
+    if(failures > 0) {
+        std::cout << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
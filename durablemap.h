@@ -0,0 +1,841 @@
+#ifndef DURABLEMAP_H
+#define DURABLEMAP_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "avlbst.h"
+
+/**
+* How DurableAVLMap writes a key or value to its log and checkpoints.
+* The default copies the object's bytes, so it only serves trivially
+* copyable types; specialize it for anything that owns memory.
+*/
+template <typename T>
+struct LogCodec
+{
+    static_assert(std::is_trivially_copyable<T>::value, "LogCodec needs a specialization for this type");
+
+    static void write(std::string& out, const T& value)
+    {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    static bool read(const char*& p, const char* end, T& value)
+    {
+        if(static_cast<size_t>(end - p) < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, p, sizeof(T));
+        p += sizeof(T);
+        return true;
+    }
+};
+
+/**
+* A 32-bit length followed by the bytes.
+*/
+template <>
+struct LogCodec<std::string>
+{
+    static void write(std::string& out, const std::string& value)
+    {
+        uint32_t size = static_cast<uint32_t>(value.size());
+        out.append(reinterpret_cast<const char*>(&size), sizeof(size));
+        out.append(value);
+    }
+
+    static bool read(const char*& p, const char* end, std::string& value)
+    {
+        uint32_t size;
+        if(static_cast<size_t>(end - p) < sizeof(size)) {
+            return false;
+        }
+        std::memcpy(&size, p, sizeof(size));
+        p += sizeof(size);
+        if(static_cast<size_t>(end - p) < size) {
+            return false;
+        }
+        value.assign(p, size);
+        p += size;
+        return true;
+    }
+};
+
+/**
+* A thread-safe AVLTree that survives crashes. Every insert and erase is
+* appended to a write-ahead log in dir before it returns, and opening the
+* same dir again rebuilds the map by loading the last checkpoint and
+* replaying the log written after it.
+*
+* Writers that arrive while a log write is in flight queue their records
+* in memory, and the next write takes them all with one write and one
+* fsync (group commit). groupDelay makes the writer that flushes wait a
+* little first, so more records share each fsync. SYNC_EACH instead
+* writes and syncs every record on its own, and SYNC_NONE never syncs,
+* so it survives a process crash but not a power loss.
+*
+* The log is a series of numbered segment files. A checkpoint seals the
+* current segment and then copies the tree to a new snapshot file a
+* chunk at a time, holding the tree's read lock only while it copies a
+* chunk, so writers keep going. The snapshot is therefore fuzzy: a key
+* may hold any value it had during the copy. That is fine because
+* everything written during the copy is also in the new segments, and
+* replaying those in order over the snapshot gives the final state.
+* Once the snapshot is safely renamed into place, the sealed segments
+* are deleted. Checkpoints run on a background thread whenever the log
+* has grown by checkpointBytes since the last one, or on demand.
+*
+* A torn record at the end of the last segment, from a crash in the
+* middle of a write, is cut off during recovery; so is one at the end of
+* a segment followed only by empty ones. Any other damage throws
+* std::runtime_error, as do I/O errors. Once a log write or sync has
+* failed, nothing later can be made durable behind the lost records, so
+* the failing call and every later write throw that error; reopening the
+* map recovers what reached the disk.
+*
+* Key and Value must be default constructible and have a LogCodec.
+*/
+template <class Key, class Value>
+class DurableAVLMap
+{
+public:
+    enum SyncMode { SYNC_EACH, SYNC_GROUP, SYNC_NONE };
+
+    struct Options
+    {
+        Options() : sync(SYNC_GROUP), groupDelay(0), checkpointBytes(64 << 20) { }
+
+        SyncMode sync;
+        std::chrono::microseconds groupDelay; //how long a flush waits for company
+        size_t checkpointBytes; //log growth that triggers a checkpoint, 0 for never
+    };
+
+    DurableAVLMap(const std::string& dir, const Options& options = Options());
+    DurableAVLMap(const DurableAVLMap<Key, Value>& other) = delete;
+    DurableAVLMap<Key, Value>& operator=(const DurableAVLMap<Key, Value>& other) = delete;
+    ~DurableAVLMap();
+
+    void insert(const std::pair<const Key, Value>& new_item);
+    bool erase(const Key& key);
+    bool find(const Key& key, Value& value) const;
+    size_t size() const;
+
+    // Visits items in key order under the read lock, so f must not call
+    // back into the map.
+    template<class F> void forEach(F f) const;
+
+    void checkpoint();
+    size_t replayed() const;
+
+protected:
+    enum Op { INSERT = 1, ERASE = 2, END = 3 };
+
+    // Add helper functions here
+    uint64_t append(const std::string& record);
+    void commit(uint64_t lsn);
+    uint64_t rotate();
+    void checkLog();
+    void checkpointLoop();
+    void recover();
+    bool replay(const char*& p, const char* end, bool& finished);
+    std::string segmentPath(uint64_t segment) const;
+    std::vector<uint64_t> listSegments() const;
+    void dropSegments(uint64_t first);
+    int openSegment(uint64_t segment);
+    static void encode(std::string& out, Op op, const Key& key, const Value* value);
+    static uint32_t checksum(const char* data, size_t size);
+    static void writeAll(int fd, const std::string& data);
+    static void syncFile(int fd, SyncMode sync);
+    static void syncDir(const std::string& dir);
+    static void readFile(const std::string& path, std::string& out);
+    static void fail(const std::string& what);
+
+protected:
+    std::string dir_;
+    Options options_;
+    AVLTree<Key, Value> tree_;
+    mutable std::shared_mutex treeLock_;
+
+    // Everything below is guarded by logLock_. Records get log sequence
+    // numbers in the order they are applied to the tree.
+    std::mutex logLock_;
+    std::condition_variable flushed_;
+    std::condition_variable checkpointWake_;
+    std::string buffer_; //records not yet handed to the kernel
+    uint64_t appendedLsn_;
+    uint64_t durableLsn_;
+    bool flushing_; //a writer is writing a batch with logLock_ released
+    int fd_; //current segment
+    uint64_t segment_;
+    size_t walBytes_; //appended since the last checkpoint began
+    std::exception_ptr logError_; //the write or sync that failed, after which nothing commits
+    bool stop_;
+
+    std::mutex checkpointLock_; //one checkpoint at a time
+    std::exception_ptr checkpointError_; //from the background thread
+    size_t replayed_;
+    std::thread checkpointer_;
+};
+
+/**
+* Opens or creates the map in dir, recovering whatever it held.
+*/
+template<class Key, class Value>
+DurableAVLMap<Key, Value>::DurableAVLMap(const std::string& dir, const Options& options) :
+    dir_(dir), options_(options), appendedLsn_(0), durableLsn_(0), flushing_(false),
+    fd_(-1), segment_(0), walBytes_(0), stop_(false), replayed_(0)
+{
+    std::error_code error;
+    std::filesystem::create_directories(dir_, error);
+    if(error) {
+        throw std::runtime_error("Cannot create " + dir_ + ": " + error.message());
+    }
+    recover();
+    checkpointer_ = std::thread(&DurableAVLMap<Key, Value>::checkpointLoop, this);
+}
+
+/**
+* Makes every write durable and stops the background checkpoints.
+*/
+template<class Key, class Value>
+DurableAVLMap<Key, Value>::~DurableAVLMap()
+{
+    {
+        std::lock_guard<std::mutex> lock(logLock_);
+        stop_ = true;
+    }
+    checkpointWake_.notify_all();
+    checkpointer_.join();
+    try {
+        commit(appendedLsn_);
+    }
+    catch(...) {
+        //nothing can be reported from here; recovery stops at the last good record
+    }
+    ::close(fd_);
+}
+
+/**
+* Inserts or overwrites, returning once the write is durable. Readers
+* may see the new value slightly before that.
+*/
+template<class Key, class Value>
+void DurableAVLMap<Key, Value>::insert(const std::pair<const Key, Value>& new_item)
+{
+    std::string record;
+    encode(record, INSERT, new_item.first, &new_item.second);
+    uint64_t lsn;
+    {
+        std::unique_lock<std::shared_mutex> lock(treeLock_);
+        checkLog();
+        tree_.insert(new_item);
+        lsn = append(record);
+    }
+    commit(lsn);
+}
+
+/**
+* Removes key and returns true if it was present. Nothing is logged for
+* an absent key.
+*/
+template<class Key, class Value>
+bool DurableAVLMap<Key, Value>::erase(const Key& key)
+{
+    std::string record;
+    encode(record, ERASE, key, NULL);
+    uint64_t lsn;
+    {
+        std::unique_lock<std::shared_mutex> lock(treeLock_);
+        checkLog();
+        size_t before = tree_.size();
+        tree_.remove(key);
+        if(tree_.size() == before) {
+            return false;
+        }
+        lsn = append(record);
+    }
+    commit(lsn);
+    return true;
+}
+
+template<class Key, class Value>
+bool DurableAVLMap<Key, Value>::find(const Key& key, Value& value) const
+{
+    std::shared_lock<std::shared_mutex> lock(treeLock_);
+    typename AVLTree<Key, Value>::iterator it = tree_.find(key);
+    if(it == tree_.end()) {
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+template<class Key, class Value>
+size_t DurableAVLMap<Key, Value>::size() const
+{
+    std::shared_lock<std::shared_mutex> lock(treeLock_);
+    return tree_.size();
+}
+
+template<class Key, class Value>
+template<class F>
+void DurableAVLMap<Key, Value>::forEach(F f) const
+{
+    std::shared_lock<std::shared_mutex> lock(treeLock_);
+    for(typename AVLTree<Key, Value>::iterator it = tree_.begin(); it != tree_.end(); ++it) {
+        f(it->first, it->second);
+    }
+}
+
+/**
+* How many log records recovery replayed on top of the checkpoint.
+*/
+template<class Key, class Value>
+size_t DurableAVLMap<Key, Value>::replayed() const
+{
+    return replayed_;
+}
+
+/**
+* Gives record the next sequence number. Called with the tree locked, so
+* the log order is the order the tree saw. SYNC_EACH writes and syncs it
+* right here; otherwise it waits in buffer_ for commit.
+*/
+template<class Key, class Value>
+uint64_t DurableAVLMap<Key, Value>::append(const std::string& record)
+{
+    std::unique_lock<std::mutex> lock(logLock_);
+    uint64_t lsn = ++appendedLsn_;
+    walBytes_ += record.size();
+    if(options_.sync == SYNC_EACH) {
+        flushed_.wait(lock, [this] { return !flushing_; });
+        if(logError_) {
+            std::rethrow_exception(logError_);
+        }
+        try {
+            writeAll(fd_, record);
+            syncFile(fd_, options_.sync);
+        }
+        catch(...) {
+            logError_ = std::current_exception();
+            throw;
+        }
+        durableLsn_ = lsn;
+    }
+    else {
+        buffer_ += record;
+    }
+    if(options_.checkpointBytes > 0 && walBytes_ >= options_.checkpointBytes) {
+        checkpointWake_.notify_one();
+    }
+    return lsn;
+}
+
+/**
+* Throws the error that failed the log, if one has. Writers call it
+* before touching the tree, so they do not apply what cannot be logged.
+*/
+template<class Key, class Value>
+void DurableAVLMap<Key, Value>::checkLog()
+{
+    std::lock_guard<std::mutex> lock(logLock_);
+    if(logError_) {
+        std::rethrow_exception(logError_);
+    }
+}
+
+/**
+* Returns once record lsn is durable. If no one is writing the log, this
+* writer takes every buffered record, its own and everyone else's, and
+* writes and syncs them together while the others wait for it. If that
+* write fails, the batch is lost and the log is failed: this call and
+* every later one throw, rather than later batches marking the lost
+* records durable.
+*/
+template<class Key, class Value>
+void DurableAVLMap<Key, Value>::commit(uint64_t lsn)
+{
+    std::unique_lock<std::mutex> lock(logLock_);
+    while(durableLsn_ < lsn) {
+        if(logError_) {
+            std::rethrow_exception(logError_);
+        }
+        if(flushing_) {
+            flushed_.wait(lock);
+            continue;
+        }
+        flushing_ = true;
+        if(options_.groupDelay.count() > 0) {
+            lock.unlock();
+            std::this_thread::sleep_for(options_.groupDelay);
+            lock.lock();
+        }
+        std::string batch;
+        batch.swap(buffer_);
+        uint64_t target = appendedLsn_;
+        int fd = fd_;
+        lock.unlock();
+        try {
+            writeAll(fd, batch);
+            syncFile(fd, options_.sync);
+        }
+        catch(...) {
+            lock.lock();
+            logError_ = std::current_exception();
+            flushing_ = false;
+            flushed_.notify_all();
+            throw;
+        }
+        lock.lock();
+        flushing_ = false;
+        durableLsn_ = std::max(durableLsn_, target);
+        flushed_.notify_all();
+    }
+}
+
+/**
+* Seals the current segment and starts the next one, returning its
+* number. Records buffered so far go to the sealed segment, and are
+* synced there before the next segment is created, so a segment with
+* a successor always ends in whole records.
+*/
+template<class Key, class Value>
+uint64_t DurableAVLMap<Key, Value>::rotate()
+{
+    std::unique_lock<std::mutex> lock(logLock_);
+    flushed_.wait(lock, [this] { return !flushing_; });
+    if(logError_) {
+        std::rethrow_exception(logError_);
+    }
+    walBytes_ = 0;
+    flushing_ = true;
+    std::string batch;
+    batch.swap(buffer_);
+    uint64_t target = appendedLsn_;
+    int sealed = fd_;
+    lock.unlock();
+    try {
+        writeAll(sealed, batch);
+        syncFile(sealed, options_.sync);
+    }
+    catch(...) {
+        lock.lock();
+        logError_ = std::current_exception();
+        flushing_ = false;
+        flushed_.notify_all();
+        throw;
+    }
+
+    int fd;
+    try {
+        fd = openSegment(segment_ + 1);
+    }
+    catch(...) {
+        //the batch is safe; keep appending to the old segment
+        lock.lock();
+        flushing_ = false;
+        durableLsn_ = std::max(durableLsn_, target);
+        flushed_.notify_all();
+        throw;
+    }
+    ::close(sealed);
+    lock.lock();
+    fd_ = fd;
+    ++segment_;
+    flushing_ = false;
+    durableLsn_ = std::max(durableLsn_, target);
+    flushed_.notify_all();
+    return segment_;
+}
+
+/**
+* Writes a fuzzy snapshot of the tree and drops the log it covers. See
+* the class comment for why a snapshot taken while writers run is safe.
+* Also rethrows the error of a failed background checkpoint, if any.
+*/
+template<class Key, class Value>
+void DurableAVLMap<Key, Value>::checkpoint()
+{
+    std::lock_guard<std::mutex> guard(checkpointLock_);
+    if(checkpointError_) {
+        std::exception_ptr error = checkpointError_;
+        checkpointError_ = std::exception_ptr();
+        std::rethrow_exception(error);
+    }
+
+    uint64_t first = rotate();
+    std::string temp = dir_ + "/checkpoint.tmp";
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        fail("Cannot create " + temp);
+    }
+
+    try {
+        std::string out("AVLCKPT1");
+        out.append(reinterpret_cast<const char*>(&first), sizeof(first));
+
+        //copy a chunk at a time, resuming after the last key copied
+        std::vector<std::pair<Key, Value> > chunk;
+        Key next = Key();
+        bool started = false;
+        while(true) {
+            chunk.clear();
+            {
+                std::shared_lock<std::shared_mutex> lock(treeLock_);
+                typename AVLTree<Key, Value>::iterator it = started ? tree_.lowerBound(next) : tree_.begin();
+                if(started && it != tree_.end() && !(next < it->first)) {
+                    ++it;
+                }
+                for(; it != tree_.end() && chunk.size() < 1024; ++it) {
+                    chunk.push_back(std::make_pair(it->first, it->second));
+                }
+            }
+            if(chunk.empty()) {
+                break;
+            }
+            for(size_t i = 0; i < chunk.size(); ++i) {
+                encode(out, INSERT, chunk[i].first, &chunk[i].second);
+            }
+            next = chunk.back().first;
+            started = true;
+            if(out.size() >= (1 << 20)) {
+                writeAll(fd, out);
+                out.clear();
+            }
+        }
+        encode(out, END, Key(), NULL);
+        writeAll(fd, out);
+        if(::fsync(fd) != 0) {
+            fail("Cannot sync " + temp);
+        }
+    }
+    catch(...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+
+    std::string path = dir_ + "/checkpoint";
+    if(::rename(temp.c_str(), path.c_str()) != 0) {
+        fail("Cannot rename " + temp);
+    }
+    syncDir(dir_);
+
+    dropSegments(first);
+}
+
+/**
+* Runs a checkpoint whenever the log has grown by checkpointBytes. A
+* failure is kept for the next checkpoint() call, and the thread waits
+* for another checkpointBytes before trying again.
+*/
+template<class Key, class Value>
+void DurableAVLMap<Key, Value>::checkpointLoop()
+{
+    std::unique_lock<std::mutex> lock(logLock_);
+    while(true) {
+        checkpointWake_.wait(lock, [this] {
+            return stop_ || (options_.checkpointBytes > 0 && walBytes_ >= options_.checkpointBytes);
+        });
+        if(stop_) {
+            return;
+        }
+        lock.unlock();
+        try {
+            checkpoint();
+        }
+        catch(...) {
+            std::lock_guard<std::mutex> guard(checkpointLock_);
+            checkpointError_ = std::current_exception();
+            std::lock_guard<std::mutex> relock(logLock_);
+            walBytes_ = 0;
+        }
+        lock.lock();
+    }
+}
+
+/**
+* Loads the checkpoint, replays the segments written after it and opens
+* a fresh segment for new writes.
+*/
+template<class Key, class Value>
+void DurableAVLMap<Key, Value>::recover()
+{
+    std::vector<uint64_t> segments = listSegments();
+    uint64_t first = 0;
+    std::string data;
+    if(std::filesystem::exists(dir_ + "/checkpoint")) {
+        readFile(dir_ + "/checkpoint", data);
+        if(data.size() < 16 || data.compare(0, 8, "AVLCKPT1") != 0) {
+            throw std::runtime_error("Corrupt checkpoint in " + dir_);
+        }
+        std::memcpy(&first, data.data() + 8, sizeof(first));
+        const char* p = data.data() + 16;
+        const char* end = data.data() + data.size();
+        bool finished = false;
+        while(!finished) {
+            if(!replay(p, end, finished)) {
+                throw std::runtime_error("Corrupt checkpoint in " + dir_);
+            }
+        }
+    }
+
+    dropSegments(first); //left behind by a crash right after a checkpoint
+    for(size_t i = 0; i < segments.size(); ++i) {
+        if(segments[i] < first) {
+            continue;
+        }
+        std::string path = segmentPath(segments[i]);
+        readFile(path, data);
+        const char* begin = data.data();
+        const char* p = begin;
+        const char* end = begin + data.size();
+        bool finished = false;
+        while(p < end) {
+            if(!replay(p, end, finished)) {
+                for(size_t j = i + 1; j < segments.size(); ++j) {
+                    if(std::filesystem::file_size(segmentPath(segments[j])) != 0) {
+                        throw std::runtime_error("Corrupt log segment " + path);
+                    }
+                }
+                //a torn write from the crash: keep what came before it
+                if(::truncate(path.c_str(), p - begin) != 0) {
+                    fail("Cannot truncate " + path);
+                }
+                break;
+            }
+            ++replayed_;
+        }
+    }
+
+    segment_ = std::max(first, segments.empty() ? 0 : segments.back() + 1);
+    fd_ = openSegment(segment_);
+}
+
+/**
+* Applies the record at p to the tree and moves p past it. Returns false,
+* leaving p alone, if the record is cut short or fails its checksum.
+*/
+template<class Key, class Value>
+bool DurableAVLMap<Key, Value>::replay(const char*& p, const char* end, bool& finished)
+{
+    uint32_t size, sum;
+    if(static_cast<size_t>(end - p) < 2 * sizeof(uint32_t)) {
+        return false;
+    }
+    std::memcpy(&size, p, sizeof(size));
+    std::memcpy(&sum, p + sizeof(size), sizeof(sum));
+    const char* body = p + 2 * sizeof(uint32_t);
+    if(static_cast<size_t>(end - body) < size || size == 0 || checksum(body, size) != sum) {
+        return false;
+    }
+    const char* bodyEnd = body + size;
+    char op = *body++;
+    Key key;
+    if(!LogCodec<Key>::read(body, bodyEnd, key)) {
+        return false;
+    }
+    if(op == INSERT) {
+        Value value;
+        if(!LogCodec<Value>::read(body, bodyEnd, value)) {
+            return false;
+        }
+        tree_.insert(std::make_pair(key, value));
+    }
+    else if(op == ERASE) {
+        tree_.remove(key);
+    }
+    else if(op == END) {
+        finished = true;
+    }
+    else {
+        return false;
+    }
+    p = bodyEnd;
+    return true;
+}
+
+template<class Key, class Value>
+std::string DurableAVLMap<Key, Value>::segmentPath(uint64_t segment) const
+{
+    return dir_ + "/wal." + std::to_string(segment);
+}
+
+/**
+* The numbers of the log segments in dir_, in ascending order.
+*/
+template<class Key, class Value>
+std::vector<uint64_t> DurableAVLMap<Key, Value>::listSegments() const
+{
+    std::vector<uint64_t> segments;
+    for(const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(dir_)) {
+        std::string name = entry.path().filename().string();
+        if(name.size() > 4 && name.compare(0, 4, "wal.") == 0) {
+            segments.push_back(std::strtoull(name.c_str() + 4, NULL, 10));
+        }
+    }
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+/**
+* Deletes the segments before first, which a checkpoint has covered.
+*/
+template<class Key, class Value>
+void DurableAVLMap<Key, Value>::dropSegments(uint64_t first)
+{
+    std::vector<uint64_t> segments = listSegments();
+    for(size_t i = 0; i < segments.size() && segments[i] < first; ++i) {
+        ::unlink(segmentPath(segments[i]).c_str());
+    }
+}
+
+/**
+* Creates segment for appending and makes its directory entry durable.
+*/
+template<class Key, class Value>
+int DurableAVLMap<Key, Value>::openSegment(uint64_t segment)
+{
+    std::string path = segmentPath(segment);
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if(fd < 0) {
+        fail("Cannot open " + path);
+    }
+    syncDir(dir_);
+    return fd;
+}
+
+/**
+* Appends one record: its body size and checksum, then the op, the key
+* and, for an insert, the value.
+*/
+template<class Key, class Value>
+void DurableAVLMap<Key, Value>::encode(std::string& out, Op op, const Key& key, const Value* value)
+{
+    size_t start = out.size();
+    out.append(2 * sizeof(uint32_t), '\0');
+    out.push_back(static_cast<char>(op));
+    LogCodec<Key>::write(out, key);
+    if(value != NULL) {
+        LogCodec<Value>::write(out, *value);
+    }
+    uint32_t size = static_cast<uint32_t>(out.size() - start - 2 * sizeof(uint32_t));
+    uint32_t sum = checksum(out.data() + start + 2 * sizeof(uint32_t), size);
+    std::memcpy(&out[start], &size, sizeof(size));
+    std::memcpy(&out[start + sizeof(size)], &sum, sizeof(sum));
+}
+
+/**
+* CRC-32 (IEEE), to tell a torn or damaged record from a whole one.
+*/
+template<class Key, class Value>
+uint32_t DurableAVLMap<Key, Value>::checksum(const char* data, size_t size)
+{
+    static const std::vector<uint32_t> table = [] {
+        std::vector<uint32_t> t(256);
+        for(uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for(int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    uint32_t crc = 0xFFFFFFFFu;
+    for(size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+template<class Key, class Value>
+void DurableAVLMap<Key, Value>::writeAll(int fd, const std::string& data)
+{
+    size_t done = 0;
+    while(done < data.size()) {
+        ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+        if(n < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            fail("Cannot write log");
+        }
+        done += static_cast<size_t>(n);
+    }
+}
+
+template<class Key, class Value>
+void DurableAVLMap<Key, Value>::syncFile(int fd, SyncMode sync)
+{
+    if(sync != SYNC_NONE && ::fdatasync(fd) != 0) {
+        fail("Cannot sync log");
+    }
+}
+
+template<class Key, class Value>
+void DurableAVLMap<Key, Value>::syncDir(const std::string& dir)
+{
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if(fd < 0) {
+        fail("Cannot open " + dir);
+    }
+    int result = ::fsync(fd);
+    ::close(fd);
+    if(result != 0) {
+        fail("Cannot sync " + dir);
+    }
+}
+
+template<class Key, class Value>
+void DurableAVLMap<Key, Value>::readFile(const std::string& path, std::string& out)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        fail("Cannot open " + path);
+    }
+    out.clear();
+    char buffer[1 << 16];
+    while(true) {
+        ssize_t n = ::read(fd, buffer, sizeof(buffer));
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n < 0) {
+            ::close(fd);
+            fail("Cannot read " + path);
+        }
+        if(n == 0) {
+            break;
+        }
+        out.append(buffer, n);
+    }
+    ::close(fd);
+}
+
+template<class Key, class Value>
+void DurableAVLMap<Key, Value>::fail(const std::string& what)
+{
+    throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+
+#endif
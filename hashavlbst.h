@@ -0,0 +1,403 @@
+#ifndef HASHAVLBST_H
+#define HASHAVLBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <functional>
+#include <stdexcept>
+#include <stdint.h>
+#include <typeinfo>
+#include <vector>
+#include "avlbst.h"
+
+/**
+* An AVLTree that also indexes its nodes in an open-addressing hash table,
+* so find, operator[] and remove locate a key with about one probe
+* instead of a descent. Ordered operations (iteration, lowerBound,
+* eraseRange, splitAt) keep using the tree.
+*
+* The table maps each linked node, tombstones included, by the hash of
+* its key, using linear probing with the hashes stored alongside the
+* pointers and at most half the slots full. Rotations and nodeSwap move
+* links, not keys, so they never touch it. Nodes enter through
+* createNode, adoptNode and bulkLoaded and leave through the overrides
+* below, which AVLTree's virtuals reach through a base reference too. A
+* node freed or moved by a path the table does not see is caught by the
+* tree's generation counter: lookups then fall back to the tree until the
+* next insert, remove or rehash() rebuilds the table.
+*/
+template <class Key, class Value, class Hash = std::hash<Key> >
+class HashedAVLTree : public AVLTree<Key, Value>
+{
+public:
+    explicit HashedAVLTree(std::pmr::memory_resource* resource = NULL);
+    virtual void clear() override;
+    virtual void release() override;
+    virtual size_t eraseRange(const Key& lo, const Key& hi) override;
+
+    virtual size_t splitAt(const Key& key, AVLTree<Key, Value>& upper) override;
+    virtual void concat(AVLTree<Key, Value>& upper) override;
+    virtual void compact() override;
+
+    void rehash();
+    size_t tableBytes() const;
+protected:
+    virtual Node<Key, Value>* internalFind(const Key& key) const override;
+    virtual void removeNode(Node<Key, Value>* n) override;
+    virtual AVLNode<Key, Value>* createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent) override;
+    virtual AVLNode<Key, Value>* adoptNode(AVLNode<Key, Value>* node) override;
+    virtual void bulkLoaded() override;
+
+    struct Slot
+    {
+        uint64_t hash;
+        Node<Key, Value>* node; //NULL for an empty slot
+    };
+
+    // Add helper functions here
+    bool tableCurrent() const;
+    void insertSlot(Node<Key, Value>* node);
+    void eraseSlot(Node<Key, Value>* node);
+    void addSubtree(Node<Key, Value>* node);
+    void moveSubtree(Node<Key, Value>* node, HashedAVLTree<Key, Value, Hash>& to);
+    void resize(size_t capacity);
+    void sync();
+    static uint64_t hashOf(const Key& key);
+
+protected:
+    std::vector<Slot> slots_; //capacity is a power of two
+    size_t count_; //nodes in the table
+    size_t tableGeneration_; //the tree's generation when the table was last known to match it
+};
+
+template<class Key, class Value, class Hash>
+HashedAVLTree<Key, Value, Hash>::HashedAVLTree(std::pmr::memory_resource* resource) :
+    AVLTree<Key, Value>(resource), slots_(16), count_(0), tableGeneration_(0)
+{
+
+}
+
+template<class Key, class Value, class Hash>
+void HashedAVLTree<Key, Value, Hash>::clear()
+{
+    AVLTree<Key, Value>::clear();
+    slots_.assign(16, Slot());
+    count_ = 0;
+    tableGeneration_ = this->generation_;
+}
+
+template<class Key, class Value, class Hash>
+void HashedAVLTree<Key, Value, Hash>::release()
+{
+    AVLTree<Key, Value>::release();
+    slots_.assign(16, Slot());
+    count_ = 0;
+    tableGeneration_ = this->generation_;
+}
+
+/**
+* Unindexes the nodes in [lo, hi], tombstones included, before the tree
+* frees them, so this stays O(log^2 n + k).
+*/
+template<class Key, class Value, class Hash>
+size_t HashedAVLTree<Key, Value, Hash>::eraseRange(const Key& lo, const Key& hi)
+{
+    if(hi < lo) {
+        return 0;
+    }
+    bool current = tableCurrent();
+    size_t freed = 0;
+    if(current) {
+        Node<Key, Value>* node = this->internalLowerBound(lo);
+        while(node != NULL && !(hi < node->getKey())) {
+            eraseSlot(node);
+            ++freed;
+            node = this->successor(node);
+        }
+    }
+    size_t before = this->generation_;
+    size_t count = AVLTree<Key, Value>::eraseRange(lo, hi);
+    if(current && this->generation_ == before + freed) {
+        tableGeneration_ = this->generation_;
+    }
+    sync();
+    return count;
+}
+
+/**
+* AVLTree::splitAt, with the moved nodes' entries moved to upper's table
+* while walking them, which splitAt does anyway to count them.
+*/
+template<class Key, class Value, class Hash>
+size_t HashedAVLTree<Key, Value, Hash>::splitAt(const Key& key, AVLTree<Key, Value>& upper)
+{
+    bool current = tableCurrent();
+    size_t before = this->generation_;
+    size_t moved = AVLTree<Key, Value>::splitAt(key, upper);
+    HashedAVLTree<Key, Value, Hash>& other = static_cast<HashedAVLTree<Key, Value, Hash>&>(upper);
+    if(current && this->generation_ == before + 1) {
+        moveSubtree(other.root_, other);
+        tableGeneration_ = this->generation_;
+        other.tableGeneration_ = other.generation_;
+    }
+    sync();
+    other.sync();
+    return moved;
+}
+
+/**
+* AVLTree::concat, with upper's table merged into this one. That is
+* O(m) for m keys in upper, where the tree join alone is O(log n).
+* upper's table is read before the join, so its type is checked first.
+*/
+template<class Key, class Value, class Hash>
+void HashedAVLTree<Key, Value, Hash>::concat(AVLTree<Key, Value>& upper)
+{
+    if(typeid(upper) != typeid(*this)) {
+        throw std::invalid_argument("Different tree types");
+    }
+    HashedAVLTree<Key, Value, Hash>& other = static_cast<HashedAVLTree<Key, Value, Hash>&>(upper);
+    bool current = tableCurrent() && other.tableCurrent();
+    AVLTree<Key, Value>::concat(upper);
+    if(current) {
+        for(size_t i = 0; i < other.slots_.size(); ++i) {
+            if(other.slots_[i].node != NULL) {
+                insertSlot(other.slots_[i].node);
+            }
+        }
+    }
+    other.slots_.assign(16, Slot());
+    other.count_ = 0;
+    other.tableGeneration_ = other.generation_;
+    sync();
+}
+
+/**
+* Also reached from setTombstones and lazy removes.
+*/
+template<class Key, class Value, class Hash>
+void HashedAVLTree<Key, Value, Hash>::compact()
+{
+    AVLTree<Key, Value>::compact();
+    sync();
+}
+
+/**
+* Rebuilds the table from the tree. O(n). Only needed if the table was
+* left stale by a path it does not see.
+*/
+template<class Key, class Value, class Hash>
+void HashedAVLTree<Key, Value, Hash>::rehash()
+{
+    size_t linked = this->size_ + this->deadCount_;
+    size_t capacity = 16;
+    while(capacity < 2 * linked) {
+        capacity *= 2;
+    }
+    slots_.assign(capacity, Slot());
+    count_ = 0;
+    addSubtree(this->root_);
+    tableGeneration_ = this->generation_;
+}
+
+template<class Key, class Value, class Hash>
+size_t HashedAVLTree<Key, Value, Hash>::tableBytes() const
+{
+    return slots_.capacity() * sizeof(Slot);
+}
+
+/**
+* One probe sequence in the table, or the tree's own search while the
+* table is out of date.
+*/
+template<class Key, class Value, class Hash>
+Node<Key, Value>* HashedAVLTree<Key, Value, Hash>::internalFind(const Key& key) const
+{
+    if(!tableCurrent()) {
+        return AVLTree<Key, Value>::internalFind(key);
+    }
+    uint64_t hash = hashOf(key);
+    size_t mask = slots_.size() - 1;
+    for(size_t i = hash & mask; slots_[i].node != NULL; i = (i + 1) & mask) {
+        if(slots_[i].hash == hash && slots_[i].node->getKey() == key) {
+            return slots_[i].node->isDeleted() ? NULL : slots_[i].node;
+        }
+    }
+    return NULL;
+}
+
+/**
+* An eager remove frees exactly the removed node, whose entry goes first.
+* A lazy one frees nothing, unless it triggers compact, and then the
+* generation shows it and the table is rebuilt.
+*/
+template<class Key, class Value, class Hash>
+void HashedAVLTree<Key, Value, Hash>::removeNode(Node<Key, Value>* n)
+{
+    bool current = tableCurrent();
+    bool eager = !this->tombstones_;
+    if(current && eager) {
+        eraseSlot(n);
+    }
+    size_t before = this->generation_;
+    AVLTree<Key, Value>::removeNode(n);
+    if(current && this->generation_ == before + (eager ? 1 : 0)) {
+        tableGeneration_ = this->generation_;
+    }
+    sync();
+}
+
+/**
+* insert links every node it creates, so it is indexed right away. The
+* node is not linked yet, so a stale table is rebuilt without it first.
+*/
+template<class Key, class Value, class Hash>
+AVLNode<Key, Value>* HashedAVLTree<Key, Value, Hash>::createNode(const Key& key, const Value& value,
+    AVLNode<Key, Value>* parent)
+{
+    AVLNode<Key, Value>* node = AVLTree<Key, Value>::createNode(key, value, parent);
+    sync();
+    insertSlot(node);
+    return node;
+}
+
+/**
+* A node inserted from a NodeHandle is indexed like a created one.
+*/
+template<class Key, class Value, class Hash>
+AVLNode<Key, Value>* HashedAVLTree<Key, Value, Hash>::adoptNode(AVLNode<Key, Value>* node)
+{
+    sync();
+    insertSlot(node);
+    return node;
+}
+
+template<class Key, class Value, class Hash>
+void HashedAVLTree<Key, Value, Hash>::bulkLoaded()
+{
+    AVLTree<Key, Value>::bulkLoaded();
+    rehash();
+}
+
+/**
+* True if no node has been freed or moved out behind the table's back and
+* it holds as many nodes as the tree links.
+*/
+template<class Key, class Value, class Hash>
+bool HashedAVLTree<Key, Value, Hash>::tableCurrent() const
+{
+    return tableGeneration_ == this->generation_ && count_ == this->size_ + this->deadCount_;
+}
+
+/**
+* Indexes a node whose key is not in the table yet.
+*/
+template<class Key, class Value, class Hash>
+void HashedAVLTree<Key, Value, Hash>::insertSlot(Node<Key, Value>* node)
+{
+    if(2 * (count_ + 1) > slots_.size()) {
+        resize(2 * slots_.size());
+    }
+    uint64_t hash = hashOf(node->getKey());
+    size_t mask = slots_.size() - 1;
+    size_t i = hash & mask;
+    while(slots_[i].node != NULL) {
+        i = (i + 1) & mask;
+    }
+    slots_[i].hash = hash;
+    slots_[i].node = node;
+    ++count_;
+}
+
+/**
+* Removes node's entry and shifts later entries of the same run back into
+* the gap, so lookups never need tombstones to keep probing.
+*/
+template<class Key, class Value, class Hash>
+void HashedAVLTree<Key, Value, Hash>::eraseSlot(Node<Key, Value>* node)
+{
+    size_t mask = slots_.size() - 1;
+    size_t i = hashOf(node->getKey()) & mask;
+    while(slots_[i].node != node) {
+        if(slots_[i].node == NULL) {
+            return;
+        }
+        i = (i + 1) & mask;
+    }
+    size_t gap = i;
+    for(size_t j = (i + 1) & mask; slots_[j].node != NULL; j = (j + 1) & mask) {
+        size_t home = slots_[j].hash & mask;
+        //j may fill the gap unless its home lies cyclically in (gap, j]
+        if(((j - home) & mask) >= ((j - gap) & mask)) {
+            slots_[gap] = slots_[j];
+            gap = j;
+        }
+    }
+    slots_[gap].node = NULL;
+    --count_;
+}
+
+template<class Key, class Value, class Hash>
+void HashedAVLTree<Key, Value, Hash>::addSubtree(Node<Key, Value>* node)
+{
+    if(node == NULL) {
+        return;
+    }
+    insertSlot(node);
+    addSubtree(node->getLeft());
+    addSubtree(node->getRight());
+}
+
+template<class Key, class Value, class Hash>
+void HashedAVLTree<Key, Value, Hash>::moveSubtree(Node<Key, Value>* node, HashedAVLTree<Key, Value, Hash>& to)
+{
+    if(node == NULL) {
+        return;
+    }
+    eraseSlot(node);
+    to.insertSlot(node);
+    moveSubtree(node->getLeft(), to);
+    moveSubtree(node->getRight(), to);
+}
+
+/**
+* Rehashes into capacity slots using the stored hashes, so no key is
+* read.
+*/
+template<class Key, class Value, class Hash>
+void HashedAVLTree<Key, Value, Hash>::resize(size_t capacity)
+{
+    std::vector<Slot> old(capacity, Slot());
+    old.swap(slots_);
+    size_t mask = capacity - 1;
+    for(size_t j = 0; j < old.size(); ++j) {
+        if(old[j].node != NULL) {
+            size_t i = old[j].hash & mask;
+            while(slots_[i].node != NULL) {
+                i = (i + 1) & mask;
+            }
+            slots_[i] = old[j];
+        }
+    }
+}
+
+/**
+* Rebuilds the table if something above could not keep it current.
+*/
+template<class Key, class Value, class Hash>
+void HashedAVLTree<Key, Value, Hash>::sync()
+{
+    if(!tableCurrent()) {
+        rehash();
+    }
+}
+
+template<class Key, class Value, class Hash>
+uint64_t HashedAVLTree<Key, Value, Hash>::hashOf(const Key& key)
+{
+    return AVLTree<Key, Value>::template filterHash<Hash>(key);
+}
+
+
+#endif
@@ -0,0 +1,346 @@
+#ifndef INTERVALBST_H
+#define INTERVALBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+
+/**
+* An AVLNode keyed by a closed interval [low, high] that also stores the
+* largest high endpoint found anywhere in its subtree.
+*/
+template <typename T, typename Value>
+class IntervalNode : public AVLNode<std::pair<T, T>, Value>
+{
+public:
+    // Constructor/destructor.
+    IntervalNode(const std::pair<T, T>& key, const Value& value, IntervalNode<T, Value>* parent);
+    virtual ~IntervalNode();
+
+    // Getter/setter for the subtree's largest high endpoint.
+    const T& getMaxHigh() const;
+    void setMaxHigh(const T& maxHigh);
+
+    // Getters for parent, left, and right, returning IntervalNodes.
+    virtual IntervalNode<T, Value>* getParent() const override;
+    virtual IntervalNode<T, Value>* getLeft() const override;
+    virtual IntervalNode<T, Value>* getRight() const override;
+
+protected:
+    T maxHigh_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the IntervalNode class.
+  -------------------------------------------------
+*/
+
+/**
+* A new node is a leaf, so its max endpoint is its own high endpoint.
+*/
+template<class T, class Value>
+IntervalNode<T, Value>::IntervalNode(const std::pair<T, T>& key, const Value& value, IntervalNode<T, Value> *parent) :
+    AVLNode<std::pair<T, T>, Value>(key, value, parent), maxHigh_(key.second)
+{
+
+}
+
+/**
+* A destructor which does nothing.
+*/
+template<class T, class Value>
+IntervalNode<T, Value>::~IntervalNode()
+{
+
+}
+
+/**
+* A getter for the largest high endpoint in this subtree.
+*/
+template<class T, class Value>
+const T& IntervalNode<T, Value>::getMaxHigh() const
+{
+    return maxHigh_;
+}
+
+/**
+* A setter for the largest high endpoint in this subtree.
+*/
+template<class T, class Value>
+void IntervalNode<T, Value>::setMaxHigh(const T& maxHigh)
+{
+    maxHigh_ = maxHigh;
+}
+
+/**
+* An overridden function for getting the parent since a static_cast is necessary to make sure
+* that our node is a IntervalNode.
+*/
+template<class T, class Value>
+IntervalNode<T, Value> *IntervalNode<T, Value>::getParent() const
+{
+    return static_cast<IntervalNode<T, Value>*>(this->parent_);
+}
+
+/**
+* Overridden for the same reasons as above.
+*/
+template<class T, class Value>
+IntervalNode<T, Value> *IntervalNode<T, Value>::getLeft() const
+{
+    return static_cast<IntervalNode<T, Value>*>(this->left_);
+}
+
+/**
+* Overridden for the same reasons as above.
+*/
+template<class T, class Value>
+IntervalNode<T, Value> *IntervalNode<T, Value>::getRight() const
+{
+    return static_cast<IntervalNode<T, Value>*>(this->right_);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the IntervalNode class.
+  -----------------------------------------------
+*/
+
+
+/**
+* An interval tree: an AVLTree keyed by closed intervals [low, high], ordered
+* by low endpoint then high endpoint, where each node also knows the largest
+* high endpoint in its subtree. Queries skip every subtree whose max high
+* is below the query or whose low endpoints are all past it, and report
+* matches in key order instead of scanning every interval.
+*
+* overlapping, stabbing and containing visit the search path for the
+* query's end plus the paths down to the k matches, which is
+* O(log n + k log(n/k)): close to O(log n + k) when matches cluster, and
+* never worse than O(k log n). A strict O(log n + k) bound would need the
+* nodes heap-ordered by high endpoint (a priority search tree), which the
+* AVL shape cannot give. within has no bound on high endpoints to prune
+* with, so it walks every interval starting inside the query:
+* O(log n + m) for m such intervals.
+*
+* Inserting the same interval twice overwrites its value, as with any key.
+* An interval whose low end is past its high end is rejected with
+* std::out_of_range, whether it comes through insert or buildFrom.
+*/
+template <class T, class Value>
+class IntervalTree : public AVLTree<std::pair<T, T>, Value>
+{
+public:
+    typedef std::pair<T, T> Interval;
+    typedef std::pair<const Interval, Value> Item;
+
+    explicit IntervalTree(std::pmr::memory_resource* resource = NULL);
+    using AVLTree<Interval, Value>::insert;
+    virtual void insert(const Item& new_item) override;
+    void insert(const T& low, const T& high, const Value& value);
+
+    // Queries append pointers to the matching items to out, in key order.
+    void overlapping(const T& low, const T& high, std::vector<const Item*>& out) const;
+    void stabbing(const T& point, std::vector<const Item*>& out) const;
+    void containing(const T& low, const T& high, std::vector<const Item*>& out) const;
+    void within(const T& low, const T& high, std::vector<const Item*>& out) const;
+protected:
+    virtual AVLNode<Interval, Value>* createNode(const Interval& key, const Value& value, AVLNode<Interval, Value>* parent) override;
+    virtual size_t nodeBytes() const override;
+    virtual AVLNode<Interval, Value>* constructNode(void* where, const Interval& key, const Value& value,
+        AVLNode<Interval, Value>* parent) override;
+    virtual void updateNode(AVLNode<Interval, Value>* node) override;
+    virtual void updatePath(AVLNode<Interval, Value>* node) override;
+
+    // Add helper functions here
+    static void checkInterval(const Interval& key);
+    void overlapping(IntervalNode<T, Value>* node, const T& low, const T& high, std::vector<const Item*>& out) const;
+    void containing(IntervalNode<T, Value>* node, const T& low, const T& high, std::vector<const Item*>& out) const;
+    void within(IntervalNode<T, Value>* node, const T& low, const T& high, std::vector<const Item*>& out) const;
+};
+
+template<class T, class Value>
+IntervalTree<T, Value>::IntervalTree(std::pmr::memory_resource* resource) :
+    AVLTree<std::pair<T, T>, Value>(resource)
+{
+
+}
+
+/**
+* Inserts the interval new_item.first. Throws if its low end is past its
+* high end.
+*/
+template<class T, class Value>
+void IntervalTree<T, Value>::insert(const Item& new_item)
+{
+    checkInterval(new_item.first);
+    AVLTree<Interval, Value>::insert(new_item);
+}
+
+/**
+* Inserts the interval [low, high]. Throws if low > high.
+*/
+template<class T, class Value>
+void IntervalTree<T, Value>::insert(const T& low, const T& high, const Value& value)
+{
+    insert(Item(Interval(low, high), value));
+}
+
+/**
+* Finds every interval that shares at least one point with [low, high].
+*/
+template<class T, class Value>
+void IntervalTree<T, Value>::overlapping(const T& low, const T& high, std::vector<const Item*>& out) const
+{
+    overlapping(static_cast<IntervalNode<T, Value>*>(this->root_), low, high, out);
+}
+
+/**
+* Finds every interval that contains point.
+*/
+template<class T, class Value>
+void IntervalTree<T, Value>::stabbing(const T& point, std::vector<const Item*>& out) const
+{
+    overlapping(static_cast<IntervalNode<T, Value>*>(this->root_), point, point, out);
+}
+
+/**
+* Finds every interval that covers all of [low, high].
+*/
+template<class T, class Value>
+void IntervalTree<T, Value>::containing(const T& low, const T& high, std::vector<const Item*>& out) const
+{
+    containing(static_cast<IntervalNode<T, Value>*>(this->root_), low, high, out);
+}
+
+/**
+* Finds every interval that lies entirely inside [low, high].
+*/
+template<class T, class Value>
+void IntervalTree<T, Value>::within(const T& low, const T& high, std::vector<const Item*>& out) const
+{
+    within(static_cast<IntervalNode<T, Value>*>(this->root_), low, high, out);
+}
+
+template<class T, class Value>
+void IntervalTree<T, Value>::checkInterval(const Interval& key)
+{
+    if(key.second < key.first) throw std::out_of_range("Invalid interval");
+}
+
+template<class T, class Value>
+void IntervalTree<T, Value>::overlapping(IntervalNode<T, Value>* node, const T& low, const T& high,
+    std::vector<const Item*>& out) const
+{
+    //nothing in this subtree reaches low
+    if(node == NULL || node->getMaxHigh() < low) {
+        return;
+    }
+    overlapping(node->getLeft(), low, high, out);
+
+    //this node and everything to its right starts after high
+    if(high < node->getKey().first) {
+        return;
+    }
+    if(!node->isDeleted() && !(node->getKey().second < low)) {
+        out.push_back(&node->getItem());
+    }
+    overlapping(node->getRight(), low, high, out);
+}
+
+template<class T, class Value>
+void IntervalTree<T, Value>::containing(IntervalNode<T, Value>* node, const T& low, const T& high,
+    std::vector<const Item*>& out) const
+{
+    //nothing in this subtree reaches high
+    if(node == NULL || node->getMaxHigh() < high) {
+        return;
+    }
+    containing(node->getLeft(), low, high, out);
+
+    //this node and everything to its right starts after low
+    if(low < node->getKey().first) {
+        return;
+    }
+    if(!node->isDeleted() && !(node->getKey().second < high)) {
+        out.push_back(&node->getItem());
+    }
+    containing(node->getRight(), low, high, out);
+}
+
+template<class T, class Value>
+void IntervalTree<T, Value>::within(IntervalNode<T, Value>* node, const T& low, const T& high,
+    std::vector<const Item*>& out) const
+{
+    if(node == NULL) {
+        return;
+    }
+    //only starts in [low, high] can qualify, so this is a range walk on the key
+    if(!(node->getKey().first < low)) {
+        within(node->getLeft(), low, high, out);
+    }
+    if(!node->isDeleted() && !(node->getKey().first < low) && !(high < node->getKey().second)) {
+        out.push_back(&node->getItem());
+    }
+    if(!(high < node->getKey().first)) {
+        within(node->getRight(), low, high, out);
+    }
+}
+
+template<class T, class Value>
+AVLNode<std::pair<T, T>, Value>* IntervalTree<T, Value>::createNode(const Interval& key, const Value& value,
+    AVLNode<Interval, Value>* parent)
+{
+    return new (this->allocateNode(sizeof(IntervalNode<T, Value>)))
+        IntervalNode<T, Value>(key, value, static_cast<IntervalNode<T, Value>*>(parent));
+}
+
+template<class T, class Value>
+size_t IntervalTree<T, Value>::nodeBytes() const
+{
+    return sizeof(IntervalNode<T, Value>);
+}
+
+template<class T, class Value>
+AVLNode<std::pair<T, T>, Value>* IntervalTree<T, Value>::constructNode(void* where, const Interval& key,
+    const Value& value, AVLNode<Interval, Value>* parent)
+{
+    //buildFrom creates its nodes here without going through insert
+    checkInterval(key);
+    return new (where) IntervalNode<T, Value>(key, value, static_cast<IntervalNode<T, Value>*>(parent));
+}
+
+/**
+* A node's max endpoint is the largest of its own and its children's.
+* A tombstone's own endpoint still counts, which only makes the bound
+* looser until the next compaction.
+*/
+template<class T, class Value>
+void IntervalTree<T, Value>::updateNode(AVLNode<Interval, Value>* node)
+{
+    IntervalNode<T, Value>* n = static_cast<IntervalNode<T, Value>*>(node);
+    T maxHigh = n->getKey().second;
+    if(n->getLeft() != NULL && maxHigh < n->getLeft()->getMaxHigh()) {
+        maxHigh = n->getLeft()->getMaxHigh();
+    }
+    if(n->getRight() != NULL && maxHigh < n->getRight()->getMaxHigh()) {
+        maxHigh = n->getRight()->getMaxHigh();
+    }
+    n->setMaxHigh(maxHigh);
+}
+
+template<class T, class Value>
+void IntervalTree<T, Value>::updatePath(AVLNode<Interval, Value>* node)
+{
+    while(node != NULL) {
+        updateNode(node);
+        node = node->getParent();
+    }
+}
+
+
+#endif
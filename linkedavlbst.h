@@ -0,0 +1,422 @@
+#ifndef LINKEDAVLBST_H
+#define LINKEDAVLBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <stdexcept>
+#include <typeinfo>
+#include "avlbst.h"
+
+/**
+* An AVLNode that also links to its in-order neighbours, so that an
+* iterator advances with one pointer hop instead of a walk through child
+* and parent links.
+*/
+template <typename Key, typename Value>
+class LinkedAVLNode : public AVLNode<Key, Value>
+{
+public:
+    // Constructor/destructor.
+    LinkedAVLNode(const Key& key, const Value& value, LinkedAVLNode<Key, Value>* parent);
+    virtual ~LinkedAVLNode();
+
+    // Getters/setters for the in-order neighbours, tombstones included.
+    virtual LinkedAVLNode<Key, Value>* getNext() const override;
+    LinkedAVLNode<Key, Value>* getPrev() const;
+    void setNext(LinkedAVLNode<Key, Value>* next);
+    void setPrev(LinkedAVLNode<Key, Value>* prev);
+
+    // Getters for parent, left, and right, returning LinkedAVLNodes.
+    virtual LinkedAVLNode<Key, Value>* getParent() const override;
+    virtual LinkedAVLNode<Key, Value>* getLeft() const override;
+    virtual LinkedAVLNode<Key, Value>* getRight() const override;
+
+protected:
+    LinkedAVLNode<Key, Value>* prev_;
+    LinkedAVLNode<Key, Value>* next_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the LinkedAVLNode class.
+  -------------------------------------------------
+*/
+
+/**
+* The neighbours are filled in by the tree once the node is linked.
+*/
+template<class Key, class Value>
+LinkedAVLNode<Key, Value>::LinkedAVLNode(const Key& key, const Value& value, LinkedAVLNode<Key, Value> *parent) :
+    AVLNode<Key, Value>(key, value, parent), prev_(NULL), next_(NULL)
+{
+
+}
+
+/**
+* A destructor which does nothing.
+*/
+template<class Key, class Value>
+LinkedAVLNode<Key, Value>::~LinkedAVLNode()
+{
+
+}
+
+template<class Key, class Value>
+LinkedAVLNode<Key, Value> *LinkedAVLNode<Key, Value>::getNext() const
+{
+    return next_;
+}
+
+template<class Key, class Value>
+LinkedAVLNode<Key, Value> *LinkedAVLNode<Key, Value>::getPrev() const
+{
+    return prev_;
+}
+
+template<class Key, class Value>
+void LinkedAVLNode<Key, Value>::setNext(LinkedAVLNode<Key, Value>* next)
+{
+    next_ = next;
+}
+
+template<class Key, class Value>
+void LinkedAVLNode<Key, Value>::setPrev(LinkedAVLNode<Key, Value>* prev)
+{
+    prev_ = prev;
+}
+
+/**
+* An overridden function for getting the parent since a static_cast is necessary to make sure
+* that our node is a LinkedAVLNode.
+*/
+template<class Key, class Value>
+LinkedAVLNode<Key, Value> *LinkedAVLNode<Key, Value>::getParent() const
+{
+    return static_cast<LinkedAVLNode<Key, Value>*>(this->parent_);
+}
+
+/**
+* Overridden for the same reasons as above.
+*/
+template<class Key, class Value>
+LinkedAVLNode<Key, Value> *LinkedAVLNode<Key, Value>::getLeft() const
+{
+    return static_cast<LinkedAVLNode<Key, Value>*>(this->left_);
+}
+
+/**
+* Overridden for the same reasons as above.
+*/
+template<class Key, class Value>
+LinkedAVLNode<Key, Value> *LinkedAVLNode<Key, Value>::getRight() const
+{
+    return static_cast<LinkedAVLNode<Key, Value>*>(this->right_);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the LinkedAVLNode class.
+  -----------------------------------------------
+*/
+
+
+/**
+* An AVLTree whose nodes form a doubly linked list in key order, so full
+* and range scans take one hop per item instead of climbing out of every
+* subtree they finish. Each node costs two more pointers.
+*
+* Rotations and nodeSwap change the shape but never the key order, so the
+* list is only touched where nodes enter or leave: a new leaf is spliced
+* in next to its parent (its in-order neighbour on one side), an eager
+* remove unlinks the node it frees, and eraseRange, splitAt and concat
+* cut or join the list at their boundaries. Tombstones stay in the list
+* and iterators skip them as before. compact and bulk loads rebuild the
+* list in one O(n) pass. All of these are virtual in AVLTree, so the list
+* is kept up to date even when they are called through a base reference.
+* The tree's generation counter is checked as well, and a list it shows
+* to be stale is rebuilt before it is used for anything else.
+*/
+template <class Key, class Value>
+class LinkedAVLTree : public AVLTree<Key, Value>
+{
+public:
+    explicit LinkedAVLTree(std::pmr::memory_resource* resource = NULL);
+    virtual size_t eraseRange(const Key& lo, const Key& hi) override;
+
+    virtual size_t splitAt(const Key& key, AVLTree<Key, Value>& upper) override;
+    virtual void concat(AVLTree<Key, Value>& upper) override;
+    virtual void compact() override;
+protected:
+    virtual void removeNode(Node<Key, Value>* n) override;
+    virtual AVLNode<Key, Value>* createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent) override;
+    virtual void nodeLinked(AVLNode<Key, Value>* node) override;
+    virtual size_t nodeBytes() const override;
+    virtual AVLNode<Key, Value>* constructNode(void* where, const Key& key, const Value& value,
+        AVLNode<Key, Value>* parent) override;
+    virtual void bulkLoaded() override;
+
+    // Add helper functions here
+    bool linksCurrent() const;
+    void relink();
+    void sync();
+    LinkedAVLNode<Key, Value>* first() const;
+    LinkedAVLNode<Key, Value>* last() const;
+    static void join(LinkedAVLNode<Key, Value>* prev, LinkedAVLNode<Key, Value>* next);
+
+protected:
+    size_t linkGeneration_; //the tree's generation when the list was last known to match it
+};
+
+template<class Key, class Value>
+LinkedAVLTree<Key, Value>::LinkedAVLTree(std::pmr::memory_resource* resource) :
+    AVLTree<Key, Value>(resource), linkGeneration_(0)
+{
+
+}
+
+/**
+* Cuts the range out of the list around the nodes AVLTree::eraseRange
+* frees, tombstones included. Walking them is O(k), which freeing them
+* costs anyway.
+*/
+template<class Key, class Value>
+size_t LinkedAVLTree<Key, Value>::eraseRange(const Key& lo, const Key& hi)
+{
+    bool current = linksCurrent();
+    LinkedAVLNode<Key, Value>* before = NULL;
+    LinkedAVLNode<Key, Value>* after = NULL;
+    size_t freed = 0;
+    if(current && !(hi < lo)) {
+        after = static_cast<LinkedAVLNode<Key, Value>*>(this->internalLowerBound(lo));
+        before = (after == NULL) ? last() : after->getPrev();
+        while(after != NULL && !(hi < after->getKey())) {
+            after = after->getNext();
+            ++freed;
+        }
+    }
+    size_t generation = this->generation_;
+    size_t count = AVLTree<Key, Value>::eraseRange(lo, hi);
+    if(current && this->generation_ == generation + freed) {
+        join(before, after);
+        linkGeneration_ = this->generation_;
+    }
+    sync();
+    return count;
+}
+
+/**
+* AVLTree::splitAt, then cuts the list between the last node below key
+* and the first one not below it.
+*/
+template<class Key, class Value>
+size_t LinkedAVLTree<Key, Value>::splitAt(const Key& key, AVLTree<Key, Value>& upper)
+{
+    bool current = linksCurrent();
+    LinkedAVLNode<Key, Value>* boundary = NULL;
+    if(current) {
+        boundary = static_cast<LinkedAVLNode<Key, Value>*>(this->internalLowerBound(key));
+    }
+    size_t generation = this->generation_;
+    size_t moved = AVLTree<Key, Value>::splitAt(key, upper);
+    LinkedAVLTree<Key, Value>& other = static_cast<LinkedAVLTree<Key, Value>&>(upper);
+    if(current && this->generation_ == generation + 1) {
+        if(boundary != NULL) {
+            join(boundary->getPrev(), NULL);
+            join(NULL, boundary);
+        }
+        linkGeneration_ = this->generation_;
+        other.linkGeneration_ = other.generation_;
+    }
+    sync();
+    other.sync();
+    return moved;
+}
+
+/**
+* AVLTree::concat, then links this tree's last node to upper's first.
+* upper's list is read before the join, so its type is checked first.
+*/
+template<class Key, class Value>
+void LinkedAVLTree<Key, Value>::concat(AVLTree<Key, Value>& upper)
+{
+    if(typeid(upper) != typeid(*this)) {
+        throw std::invalid_argument("Different tree types");
+    }
+    LinkedAVLTree<Key, Value>& other = static_cast<LinkedAVLTree<Key, Value>&>(upper);
+    bool current = linksCurrent() && other.linksCurrent();
+    LinkedAVLNode<Key, Value>* tail = last();
+    LinkedAVLNode<Key, Value>* head = other.first();
+    AVLTree<Key, Value>::concat(upper);
+    if(current) {
+        join(tail, head);
+    }
+    other.linkGeneration_ = other.generation_;
+    sync();
+}
+
+/**
+* AVLTree::compact frees the tombstones and reshapes the tree, so the
+* list is rebuilt. Also reached from setTombstones and lazy removes.
+*/
+template<class Key, class Value>
+void LinkedAVLTree<Key, Value>::compact()
+{
+    AVLTree<Key, Value>::compact();
+    sync();
+}
+
+/**
+* An eager remove frees exactly the removed node, which is unlinked
+* first. nodeSwap only moves it in the tree, so its neighbours are still
+* the right ones. A lazy remove keeps the node in the list.
+*/
+template<class Key, class Value>
+void LinkedAVLTree<Key, Value>::removeNode(Node<Key, Value>* n)
+{
+    bool current = linksCurrent();
+    bool eager = !this->tombstones_;
+    if(current && eager) {
+        LinkedAVLNode<Key, Value>* node = static_cast<LinkedAVLNode<Key, Value>*>(n);
+        join(node->getPrev(), node->getNext());
+    }
+    size_t generation = this->generation_;
+    AVLTree<Key, Value>::removeNode(n);
+    if(current && this->generation_ == generation + (eager ? 1 : 0)) {
+        linkGeneration_ = this->generation_;
+    }
+    sync();
+}
+
+template<class Key, class Value>
+AVLNode<Key, Value>* LinkedAVLTree<Key, Value>::createNode(const Key& key, const Value& value,
+    AVLNode<Key, Value>* parent)
+{
+    return new (this->allocateNode(sizeof(LinkedAVLNode<Key, Value>)))
+        LinkedAVLNode<Key, Value>(key, value, static_cast<LinkedAVLNode<Key, Value>*>(parent));
+}
+
+/**
+* A new leaf sits right after its parent if it is a right child and right
+* before it if it is a left child, so it is spliced in next to the parent.
+*/
+template<class Key, class Value>
+void LinkedAVLTree<Key, Value>::nodeLinked(AVLNode<Key, Value>* n)
+{
+    if(!linksCurrent()) {
+        relink(); //the new leaf is already in the tree, so this covers it
+        return;
+    }
+    LinkedAVLNode<Key, Value>* node = static_cast<LinkedAVLNode<Key, Value>*>(n);
+    LinkedAVLNode<Key, Value>* parent = node->getParent();
+    if(parent == NULL) {
+        join(NULL, node);
+        join(node, NULL);
+    }
+    else if(parent->getLeft() == node) {
+        join(parent->getPrev(), node);
+        join(node, parent);
+    }
+    else {
+        join(node, parent->getNext());
+        join(parent, node);
+    }
+}
+
+template<class Key, class Value>
+size_t LinkedAVLTree<Key, Value>::nodeBytes() const
+{
+    return sizeof(LinkedAVLNode<Key, Value>);
+}
+
+template<class Key, class Value>
+AVLNode<Key, Value>* LinkedAVLTree<Key, Value>::constructNode(void* where, const Key& key,
+    const Value& value, AVLNode<Key, Value>* parent)
+{
+    return new (where) LinkedAVLNode<Key, Value>(key, value, static_cast<LinkedAVLNode<Key, Value>*>(parent));
+}
+
+template<class Key, class Value>
+void LinkedAVLTree<Key, Value>::bulkLoaded()
+{
+    AVLTree<Key, Value>::bulkLoaded();
+    relink();
+}
+
+/**
+* True if no node has been freed or moved out behind the list's back.
+*/
+template<class Key, class Value>
+bool LinkedAVLTree<Key, Value>::linksCurrent() const
+{
+    return linkGeneration_ == this->generation_;
+}
+
+/**
+* Rebuilds the list from the tree links, which successor follows instead
+* of the list. O(n).
+*/
+template<class Key, class Value>
+void LinkedAVLTree<Key, Value>::relink()
+{
+    LinkedAVLNode<Key, Value>* prev = NULL;
+    LinkedAVLNode<Key, Value>* node = first();
+    while(node != NULL) {
+        join(prev, node);
+        prev = node;
+        node = static_cast<LinkedAVLNode<Key, Value>*>(this->successor(node));
+    }
+    if(prev != NULL) {
+        join(NULL, first());
+        join(prev, NULL);
+    }
+    linkGeneration_ = this->generation_;
+}
+
+template<class Key, class Value>
+void LinkedAVLTree<Key, Value>::sync()
+{
+    if(!linksCurrent()) {
+        relink();
+    }
+}
+
+/**
+* The leftmost node, tombstone or not, found through the tree links.
+*/
+template<class Key, class Value>
+LinkedAVLNode<Key, Value>* LinkedAVLTree<Key, Value>::first() const
+{
+    LinkedAVLNode<Key, Value>* node = static_cast<LinkedAVLNode<Key, Value>*>(this->root_);
+    while(node != NULL && node->getLeft() != NULL) {
+        node = node->getLeft();
+    }
+    return node;
+}
+
+template<class Key, class Value>
+LinkedAVLNode<Key, Value>* LinkedAVLTree<Key, Value>::last() const
+{
+    LinkedAVLNode<Key, Value>* node = static_cast<LinkedAVLNode<Key, Value>*>(this->root_);
+    while(node != NULL && node->getRight() != NULL) {
+        node = node->getRight();
+    }
+    return node;
+}
+
+/**
+* Makes prev and next neighbours. Either may be NULL for an end of the list.
+*/
+template<class Key, class Value>
+void LinkedAVLTree<Key, Value>::join(LinkedAVLNode<Key, Value>* prev, LinkedAVLNode<Key, Value>* next)
+{
+    if(prev != NULL) {
+        prev->setNext(next);
+    }
+    if(next != NULL) {
+        next->setPrev(prev);
+    }
+}
+
+
+#endif
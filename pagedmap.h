@@ -0,0 +1,1104 @@
+#ifndef PAGEDMAP_H
+#define PAGEDMAP_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+* A cache of fixed-size file pages in a fixed number of frames, evicted
+* with the CLOCK algorithm: each frame has a reference bit that a hit
+* sets, and the clock hand clears bits as it sweeps until it finds a
+* frame that was not touched since its last pass. Pinned frames are
+* never evicted. Dirty frames are written back when evicted or flushed.
+*/
+class BufferPool
+{
+public:
+    BufferPool(int fd, size_t pageSize, size_t frames);
+    BufferPool(const BufferPool& other) = delete;
+    BufferPool& operator=(const BufferPool& other) = delete;
+    ~BufferPool();
+
+    size_t pin(uint32_t page);
+    size_t pinNew(uint32_t page);
+    void unpin(size_t frame, bool dirty);
+    char* data(size_t frame);
+    void flush();
+    void discard();
+    void readAhead(uint32_t page, size_t count);
+
+    size_t reads() const;
+    size_t writes() const;
+
+protected:
+    struct Frame
+    {
+        uint32_t page;
+        uint32_t pins;
+        bool used;
+        bool dirty;
+        bool referenced;
+    };
+
+    // Add helper functions here
+    size_t victim();
+    void writeBack(size_t frame);
+
+protected:
+    int fd_;
+    size_t pageSize_;
+    std::vector<Frame> frames_;
+    char* memory_;
+    std::unordered_map<uint32_t, size_t> table_; //page to frame
+    size_t hand_;
+    size_t reads_;
+    size_t writes_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the BufferPool class.
+  -------------------------------------------------
+*/
+
+inline BufferPool::BufferPool(int fd, size_t pageSize, size_t frames) :
+    fd_(fd), pageSize_(pageSize), frames_(frames), hand_(0), reads_(0), writes_(0)
+{
+    memory_ = new char[pageSize * frames];
+    for(size_t i = 0; i < frames_.size(); ++i) {
+        frames_[i].page = 0;
+        frames_[i].pins = 0;
+        frames_[i].used = false;
+        frames_[i].dirty = false;
+        frames_[i].referenced = false;
+    }
+}
+
+inline BufferPool::~BufferPool()
+{
+    delete [] memory_;
+}
+
+/**
+* Returns the frame holding page, reading it in if needed, pinned until unpin.
+*/
+inline size_t BufferPool::pin(uint32_t page)
+{
+    std::unordered_map<uint32_t, size_t>::iterator it = table_.find(page);
+    if(it != table_.end()) {
+        Frame& frame = frames_[it->second];
+        ++frame.pins;
+        frame.referenced = true;
+        return it->second;
+    }
+    size_t index = victim();
+    char* buffer = data(index);
+    size_t done = 0;
+    while(done < pageSize_) {
+        ssize_t n = ::pread(fd_, buffer + done, pageSize_ - done, static_cast<off_t>(page) * pageSize_ + done);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n <= 0) {
+            throw std::runtime_error(std::string("Cannot read page: ") + std::strerror(n < 0 ? errno : EIO));
+        }
+        done += static_cast<size_t>(n);
+    }
+    ++reads_;
+    Frame& frame = frames_[index];
+    frame.page = page;
+    frame.pins = 1;
+    frame.used = true;
+    frame.dirty = false;
+    frame.referenced = true;
+    table_[page] = index;
+    return index;
+}
+
+/**
+* Like pin, for a page that is new at the end of the file: the frame is
+* zeroed instead of read, and dirty so it reaches the file.
+*/
+inline size_t BufferPool::pinNew(uint32_t page)
+{
+    size_t index = victim();
+    std::memset(data(index), 0, pageSize_);
+    Frame& frame = frames_[index];
+    frame.page = page;
+    frame.pins = 1;
+    frame.used = true;
+    frame.dirty = true;
+    frame.referenced = true;
+    table_[page] = index;
+    return index;
+}
+
+inline void BufferPool::unpin(size_t frame, bool dirty)
+{
+    frames_[frame].pins -= 1;
+    if(dirty) {
+        frames_[frame].dirty = true;
+    }
+}
+
+inline char* BufferPool::data(size_t frame)
+{
+    return memory_ + frame * pageSize_;
+}
+
+/**
+* Writes every dirty page back, leaving them cached.
+*/
+inline void BufferPool::flush()
+{
+    for(size_t i = 0; i < frames_.size(); ++i) {
+        if(frames_[i].used && frames_[i].dirty) {
+            writeBack(i);
+        }
+    }
+}
+
+/**
+* Forgets every cached page without writing it back.
+*/
+inline void BufferPool::discard()
+{
+    for(size_t i = 0; i < frames_.size(); ++i) {
+        frames_[i].used = false;
+        frames_[i].dirty = false;
+        frames_[i].pins = 0;
+    }
+    table_.clear();
+}
+
+/**
+* Asks the kernel to start reading count pages from page onwards, so a
+* scan that gets there finds them in the page cache. Pages already in
+* the pool are skipped.
+*/
+inline void BufferPool::readAhead(uint32_t page, size_t count)
+{
+    while(count > 0 && table_.count(page) != 0) {
+        ++page;
+        --count;
+    }
+    if(count > 0) {
+        ::posix_fadvise(fd_, static_cast<off_t>(page) * pageSize_, count * pageSize_, POSIX_FADV_WILLNEED);
+    }
+}
+
+inline size_t BufferPool::reads() const
+{
+    return reads_;
+}
+
+inline size_t BufferPool::writes() const
+{
+    return writes_;
+}
+
+/**
+* Picks a frame for a new page: a free one, or the first unpinned frame
+* the clock hand finds with its reference bit clear.
+*/
+inline size_t BufferPool::victim()
+{
+    for(size_t sweep = 0; sweep < 2 * frames_.size() + 1; ++sweep) {
+        size_t index = hand_;
+        hand_ = (hand_ + 1 == frames_.size()) ? 0 : hand_ + 1;
+        Frame& frame = frames_[index];
+        if(!frame.used) {
+            return index;
+        }
+        if(frame.pins > 0) {
+            continue;
+        }
+        if(frame.referenced) {
+            frame.referenced = false;
+            continue;
+        }
+        if(frame.dirty) {
+            writeBack(index);
+        }
+        table_.erase(frame.page);
+        frame.used = false;
+        return index;
+    }
+    throw std::runtime_error("Every page in the pool is pinned");
+}
+
+inline void BufferPool::writeBack(size_t frame)
+{
+    const char* buffer = data(frame);
+    off_t offset = static_cast<off_t>(frames_[frame].page) * pageSize_;
+    size_t done = 0;
+    while(done < pageSize_) {
+        ssize_t n = ::pwrite(fd_, buffer + done, pageSize_ - done, offset + done);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n < 0) {
+            throw std::runtime_error(std::string("Cannot write page: ") + std::strerror(errno));
+        }
+        done += static_cast<size_t>(n);
+    }
+    ++writes_;
+    frames_[frame].dirty = false;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the BufferPool class.
+  -----------------------------------------------
+*/
+
+
+/**
+* An ordered map that lives in a file and keeps only memoryBudget bytes
+* of it in memory, for maps that outgrow RAM. It offers the same
+* operations as BinarySearchTree, but items are stored by value in a
+* B+ tree of fixed-size pages instead of in linked nodes: internal pages
+* hold separator keys and child page numbers, leaves hold the items in
+* order and link to the next leaf. A lookup touches one page per level,
+* a handful for any realistic size, and pages are cached in a
+* BufferPool. Once the data outgrows the budget, operations keep
+* working and pay a page read per miss.
+*
+* Iteration walks the leaf chain, and on entering a leaf asks the kernel
+* to read the next readAhead pages, which is where leaves filled in
+* order end up. Removes leave pages that empty out in place; later
+* inserts into the same key range reuse them.
+*
+* Key and Value must be trivially copyable, since they are copied
+* straight into pages. An iterator holds a copy of its item and is
+* invalidated by any change to the map. Changes reach the file when
+* pages are evicted, on flush() and in the destructor. There is no
+* log, so a crash can leave the file inconsistent; see DurableAVLMap
+* for crash safety.
+*/
+template <class Key, class Value>
+class PagedBTree
+{
+    static_assert(std::is_trivially_copyable<Key>::value, "PagedBTree keys must be trivially copyable");
+    static_assert(std::is_trivially_copyable<Value>::value, "PagedBTree values must be trivially copyable");
+
+public:
+    PagedBTree(const std::string& path, size_t memoryBudget = 64 << 20, size_t pageSize = 4096,
+        size_t readAhead = 8);
+    PagedBTree(const PagedBTree<Key, Value>& other) = delete;
+    PagedBTree<Key, Value>& operator=(const PagedBTree<Key, Value>& other) = delete;
+    ~PagedBTree();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool empty() const;
+    size_t size() const;
+    int height() const;
+    void flush();
+
+    // Page reads from and writes to the file since it was opened.
+    size_t pageReads() const;
+    size_t pageWrites() const;
+
+    /**
+    * Walks the items in key order along the leaf chain.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+        iterator(const iterator& rhs);
+        iterator(iterator&& rhs);
+        iterator& operator=(const iterator& rhs);
+        iterator& operator=(iterator&& rhs);
+
+        const std::pair<const Key, Value>& operator*() const;
+        const std::pair<const Key, Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class PagedBTree<Key, Value>;
+        iterator(PagedBTree<Key, Value>* tree, uint32_t leaf, uint32_t slot);
+        void settle();
+
+        PagedBTree<Key, Value>* tree_;
+        uint32_t leaf_; //0 at the end
+        uint32_t slot_;
+        std::optional<std::pair<const Key, Value> > item_;
+    };
+
+    iterator begin();
+    iterator end();
+    iterator find(const Key& key);
+    iterator lowerBound(const Key& key);
+    Value operator[](const Key& key);
+
+protected:
+    /**
+    * Every page starts with this. Leaves then hold count keys followed,
+    * at a fixed offset, by count values; internal pages hold count keys
+    * and count + 1 child page numbers. Key i of an internal page is the
+    * smallest key under child i + 1.
+    */
+    struct PageHeader
+    {
+        uint32_t leaf;
+        uint32_t count;
+        uint32_t next; //next leaf, 0 for none
+        uint32_t unused;
+    };
+
+    /**
+    * Page 0 of the file.
+    */
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t pageSize;
+        uint32_t keySize;
+        uint32_t valueSize;
+        uint32_t root;
+        uint32_t pages;
+        uint32_t height;
+        uint64_t size;
+    };
+
+    // Add helper functions here
+    void reset();
+    void writeHeader();
+    bool insert(uint32_t page, const Key& key, const Value& value, Key& separator, uint32_t& sibling);
+    uint32_t findLeaf(const Key& key);
+    uint32_t lowerSlot(const char* page, const Key& key) const;
+    uint32_t childSlot(const char* page, const Key& key) const;
+    uint32_t allocatePage();
+
+    static PageHeader* header(char* page);
+    static const PageHeader* header(const char* page);
+    static Key keyAt(const char* page, uint32_t i);
+    static void setKey(char* page, uint32_t i, const Key& key);
+    Value valueAt(const char* page, uint32_t i) const;
+    void setValue(char* page, uint32_t i, const Value& value);
+    uint32_t childAt(const char* page, uint32_t i) const;
+    void setChild(char* page, uint32_t i, uint32_t child);
+    char* valueBase(char* page) const;
+    const char* valueBase(const char* page) const;
+    char* childBase(char* page) const;
+    const char* childBase(const char* page) const;
+
+protected:
+    int fd_;
+    size_t pageSize_;
+    size_t readAhead_;
+    size_t leafCapacity_;
+    size_t innerCapacity_;
+    uint32_t root_;
+    uint32_t pages_; //pages in the file, the header included
+    int height_; //levels, 1 for a lone leaf
+    size_t size_;
+    BufferPool* pool_;
+};
+
+/*
+--------------------------------------------------------------
+Begin implementations for the PagedBTree::iterator class.
+---------------------------------------------------------------
+*/
+
+template<class Key, class Value>
+PagedBTree<Key, Value>::iterator::iterator() :
+    tree_(NULL), leaf_(0), slot_(0)
+{
+
+}
+
+/**
+* Moves to the first item at or after slot of leaf, skipping empty leaves.
+*/
+template<class Key, class Value>
+PagedBTree<Key, Value>::iterator::iterator(PagedBTree<Key, Value>* tree, uint32_t leaf, uint32_t slot) :
+    tree_(tree), leaf_(leaf), slot_(slot)
+{
+    settle();
+}
+
+template<class Key, class Value>
+PagedBTree<Key, Value>::iterator::iterator(const iterator& rhs) :
+    tree_(rhs.tree_), leaf_(rhs.leaf_), slot_(rhs.slot_), item_(rhs.item_)
+{
+
+}
+
+template<class Key, class Value>
+PagedBTree<Key, Value>::iterator::iterator(iterator&& rhs) :
+    tree_(rhs.tree_), leaf_(rhs.leaf_), slot_(rhs.slot_), item_(std::move(rhs.item_))
+{
+
+}
+
+/**
+* The copied item has a const key, so it is rebuilt rather than assigned.
+*/
+template<class Key, class Value>
+typename PagedBTree<Key, Value>::iterator& PagedBTree<Key, Value>::iterator::operator=(const iterator& rhs)
+{
+    if(this != &rhs) {
+        tree_ = rhs.tree_;
+        leaf_ = rhs.leaf_;
+        slot_ = rhs.slot_;
+        item_.reset();
+        if(rhs.item_) {
+            item_.emplace(*rhs.item_);
+        }
+    }
+    return *this;
+}
+
+template<class Key, class Value>
+typename PagedBTree<Key, Value>::iterator& PagedBTree<Key, Value>::iterator::operator=(iterator&& rhs)
+{
+    if(this != &rhs) {
+        tree_ = rhs.tree_;
+        leaf_ = rhs.leaf_;
+        slot_ = rhs.slot_;
+        item_.reset();
+        if(rhs.item_) {
+            item_.emplace(std::move(*rhs.item_));
+        }
+    }
+    return *this;
+}
+
+template<class Key, class Value>
+const std::pair<const Key, Value>& PagedBTree<Key, Value>::iterator::operator*() const
+{
+    return *item_;
+}
+
+template<class Key, class Value>
+const std::pair<const Key, Value>* PagedBTree<Key, Value>::iterator::operator->() const
+{
+    return &*item_;
+}
+
+template<class Key, class Value>
+bool PagedBTree<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return leaf_ == rhs.leaf_ && (leaf_ == 0 || slot_ == rhs.slot_);
+}
+
+template<class Key, class Value>
+bool PagedBTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+template<class Key, class Value>
+typename PagedBTree<Key, Value>::iterator& PagedBTree<Key, Value>::iterator::operator++()
+{
+    ++slot_;
+    settle();
+    return *this;
+}
+
+/**
+* Follows the leaf chain until slot_ names an item, then copies it out.
+* Each new leaf entered kicks off read-ahead past it.
+*/
+template<class Key, class Value>
+void PagedBTree<Key, Value>::iterator::settle()
+{
+    item_.reset();
+    while(leaf_ != 0) {
+        BufferPool& pool = *tree_->pool_;
+        size_t frame = pool.pin(leaf_);
+        const char* page = pool.data(frame);
+        const PageHeader* head = header(page);
+        if(slot_ < head->count) {
+            item_.emplace(keyAt(page, slot_), tree_->valueAt(page, slot_));
+            pool.unpin(frame, false);
+            return;
+        }
+        uint32_t next = head->next;
+        pool.unpin(frame, false);
+        if(next != 0) {
+            pool.readAhead(next + 1, tree_->readAhead_);
+        }
+        leaf_ = next;
+        slot_ = 0;
+    }
+}
+
+/*
+--------------------------------------------------------------
+End implementations for the PagedBTree::iterator class.
+---------------------------------------------------------------
+*/
+
+/**
+* Opens the tree stored at path, or creates it. The pool gets
+* memoryBudget / pageSize frames, at least 16 so a descent never runs
+* out of frames to pin.
+*/
+template<class Key, class Value>
+PagedBTree<Key, Value>::PagedBTree(const std::string& path, size_t memoryBudget, size_t pageSize,
+    size_t readAhead) :
+    pageSize_(pageSize), readAhead_(readAhead), pool_(NULL)
+{
+    if(pageSize_ < sizeof(FileHeader) || pageSize_ > (1u << 30)) {
+        throw std::invalid_argument("Invalid page size");
+    }
+    leafCapacity_ = (pageSize_ - sizeof(PageHeader)) / (sizeof(Key) + sizeof(Value));
+    innerCapacity_ = (pageSize_ - sizeof(PageHeader) - sizeof(uint32_t)) / (sizeof(Key) + sizeof(uint32_t));
+    if(leafCapacity_ < 3 || innerCapacity_ < 3) {
+        throw std::invalid_argument("Page too small for these keys and values");
+    }
+
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if(fd_ < 0) {
+        throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+    }
+    pool_ = new BufferPool(fd_, pageSize_, std::max<size_t>(16, memoryBudget / pageSize_));
+
+    try {
+        if(::lseek(fd_, 0, SEEK_END) == 0) {
+            reset();
+            return;
+        }
+        FileHeader file;
+        if(::pread(fd_, &file, sizeof(file), 0) != static_cast<ssize_t>(sizeof(file)) ||
+            std::memcmp(file.magic, "AVLPAGE1", 8) != 0 || file.pageSize != pageSize_ ||
+            file.keySize != sizeof(Key) || file.valueSize != sizeof(Value)) {
+            throw std::invalid_argument("File " + path + " does not hold a tree of this type");
+        }
+        root_ = file.root;
+        pages_ = file.pages;
+        height_ = static_cast<int>(file.height);
+        size_ = file.size;
+    }
+    catch(...) {
+        delete pool_;
+        ::close(fd_);
+        throw;
+    }
+}
+
+/**
+* Writes everything back and closes the file.
+*/
+template<class Key, class Value>
+PagedBTree<Key, Value>::~PagedBTree()
+{
+    try {
+        flush();
+    }
+    catch(...) {
+        //nothing can be reported from a destructor
+    }
+    delete pool_;
+    ::close(fd_);
+}
+
+/**
+* Recall: If key is already in the tree, you should
+* overwrite the current value with the updated value.
+*/
+template<class Key, class Value>
+void PagedBTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    Key separator;
+    uint32_t sibling;
+    if(!insert(root_, keyValuePair.first, keyValuePair.second, separator, sibling)) {
+        return;
+    }
+    //the root split: grow a level
+    uint32_t root = allocatePage();
+    size_t frame = pool_->pinNew(root);
+    char* page = pool_->data(frame);
+    header(page)->leaf = 0;
+    header(page)->count = 1;
+    setKey(page, 0, separator);
+    setChild(page, 0, root_);
+    setChild(page, 1, sibling);
+    pool_->unpin(frame, true);
+    root_ = root;
+    ++height_;
+}
+
+/**
+* Removes key from its leaf if it is there. Pages are never merged.
+*/
+template<class Key, class Value>
+void PagedBTree<Key, Value>::remove(const Key& key)
+{
+    uint32_t leaf = findLeaf(key);
+    size_t frame = pool_->pin(leaf);
+    char* page = pool_->data(frame);
+    PageHeader* head = header(page);
+    uint32_t slot = lowerSlot(page, key);
+    if(slot == head->count || key < keyAt(page, slot)) {
+        pool_->unpin(frame, false);
+        return;
+    }
+    uint32_t after = head->count - slot - 1;
+    char* keys = page + sizeof(PageHeader);
+    std::memmove(keys + slot * sizeof(Key), keys + (slot + 1) * sizeof(Key), after * sizeof(Key));
+    char* values = valueBase(page);
+    std::memmove(values + slot * sizeof(Value), values + (slot + 1) * sizeof(Value), after * sizeof(Value));
+    --head->count;
+    --size_;
+    pool_->unpin(frame, true);
+}
+
+/**
+* Empties the tree and truncates the file.
+*/
+template<class Key, class Value>
+void PagedBTree<Key, Value>::clear()
+{
+    pool_->discard();
+    if(::ftruncate(fd_, 0) != 0) {
+        throw std::runtime_error(std::string("Cannot truncate: ") + std::strerror(errno));
+    }
+    reset();
+}
+
+template<class Key, class Value>
+bool PagedBTree<Key, Value>::empty() const
+{
+    return size_ == 0;
+}
+
+template<class Key, class Value>
+size_t PagedBTree<Key, Value>::size() const
+{
+    return size_;
+}
+
+template<class Key, class Value>
+int PagedBTree<Key, Value>::height() const
+{
+    return height_;
+}
+
+/**
+* Writes every changed page and the file header back and syncs the file.
+*/
+template<class Key, class Value>
+void PagedBTree<Key, Value>::flush()
+{
+    writeHeader();
+    pool_->flush();
+    if(::fdatasync(fd_) != 0) {
+        throw std::runtime_error(std::string("Cannot sync: ") + std::strerror(errno));
+    }
+}
+
+template<class Key, class Value>
+size_t PagedBTree<Key, Value>::pageReads() const
+{
+    return pool_->reads();
+}
+
+template<class Key, class Value>
+size_t PagedBTree<Key, Value>::pageWrites() const
+{
+    return pool_->writes();
+}
+
+template<class Key, class Value>
+typename PagedBTree<Key, Value>::iterator PagedBTree<Key, Value>::begin()
+{
+    //the leftmost leaf is always page 1: splits move the upper half out
+    return iterator(this, 1, 0);
+}
+
+template<class Key, class Value>
+typename PagedBTree<Key, Value>::iterator PagedBTree<Key, Value>::end()
+{
+    return iterator(this, 0, 0);
+}
+
+template<class Key, class Value>
+typename PagedBTree<Key, Value>::iterator PagedBTree<Key, Value>::find(const Key& key)
+{
+    iterator it = lowerBound(key);
+    if(it != end() && !(key < it->first)) {
+        return it;
+    }
+    return end();
+}
+
+/**
+* An iterator to the first item whose key is not less than key.
+*/
+template<class Key, class Value>
+typename PagedBTree<Key, Value>::iterator PagedBTree<Key, Value>::lowerBound(const Key& key)
+{
+    uint32_t leaf = findLeaf(key);
+    size_t frame = pool_->pin(leaf);
+    uint32_t slot = lowerSlot(pool_->data(frame), key);
+    pool_->unpin(frame, false);
+    return iterator(this, leaf, slot);
+}
+
+/**
+* Returns a copy of the value for key, since pages move in and out of
+* memory. Throws std::out_of_range if key is absent.
+*/
+template<class Key, class Value>
+Value PagedBTree<Key, Value>::operator[](const Key& key)
+{
+    iterator it = find(key);
+    if(it == end()) {
+        throw std::out_of_range("Invalid key");
+    }
+    return it->second;
+}
+
+/**
+* Starts an empty tree: the header page and one empty leaf as the root.
+*/
+template<class Key, class Value>
+void PagedBTree<Key, Value>::reset()
+{
+    pages_ = 1;
+    size_ = 0;
+    height_ = 1;
+    root_ = allocatePage();
+    size_t frame = pool_->pinNew(root_);
+    header(pool_->data(frame))->leaf = 1;
+    pool_->unpin(frame, true);
+    frame = pool_->pinNew(0);
+    pool_->unpin(frame, true);
+    writeHeader();
+}
+
+template<class Key, class Value>
+void PagedBTree<Key, Value>::writeHeader()
+{
+    FileHeader file;
+    std::memset(&file, 0, sizeof(file));
+    std::memcpy(file.magic, "AVLPAGE1", 8);
+    file.pageSize = static_cast<uint32_t>(pageSize_);
+    file.keySize = sizeof(Key);
+    file.valueSize = sizeof(Value);
+    file.root = root_;
+    file.pages = pages_;
+    file.height = static_cast<uint32_t>(height_);
+    file.size = size_;
+    size_t frame = pool_->pin(0);
+    std::memcpy(pool_->data(frame), &file, sizeof(file));
+    pool_->unpin(frame, true);
+}
+
+/**
+* Inserts into the subtree at page. If page had to split, returns true
+* with the new right-hand page in sibling and the smallest key under it
+* in separator, for the caller to link in.
+*/
+template<class Key, class Value>
+bool PagedBTree<Key, Value>::insert(uint32_t page, const Key& key, const Value& value, Key& separator, uint32_t& sibling)
+{
+    size_t frame = pool_->pin(page);
+    char* data = pool_->data(frame);
+    PageHeader* head = header(data);
+
+    if(head->leaf) {
+        uint32_t slot = lowerSlot(data, key);
+        if(slot < head->count && !(key < keyAt(data, slot))) { //update value
+            setValue(data, slot, value);
+            pool_->unpin(frame, true);
+            return false;
+        }
+        ++size_;
+        if(head->count < leafCapacity_) {
+            uint32_t after = head->count - slot;
+            char* keys = data + sizeof(PageHeader);
+            std::memmove(keys + (slot + 1) * sizeof(Key), keys + slot * sizeof(Key), after * sizeof(Key));
+            char* values = valueBase(data);
+            std::memmove(values + (slot + 1) * sizeof(Value), values + slot * sizeof(Value), after * sizeof(Value));
+            setKey(data, slot, key);
+            setValue(data, slot, value);
+            ++head->count;
+            pool_->unpin(frame, true);
+            return false;
+        }
+
+        //full: gather the items with the new one and deal them over two leaves
+        std::vector<std::pair<Key, Value> > items;
+        items.reserve(head->count + 1);
+        for(uint32_t i = 0; i < head->count; ++i) {
+            if(i == slot) {
+                items.push_back(std::make_pair(key, value));
+            }
+            items.push_back(std::make_pair(keyAt(data, i), valueAt(data, i)));
+        }
+        if(slot == head->count) {
+            items.push_back(std::make_pair(key, value));
+        }
+        //a leaf full of ascending inserts splits unevenly, so sequential loads pack pages
+        size_t keep = (slot == head->count && head->next == 0) ? items.size() - 1 : items.size() / 2;
+
+        sibling = allocatePage();
+        size_t siblingFrame = pool_->pinNew(sibling);
+        char* right = pool_->data(siblingFrame);
+        header(right)->leaf = 1;
+        header(right)->count = static_cast<uint32_t>(items.size() - keep);
+        header(right)->next = head->next;
+        for(size_t i = keep; i < items.size(); ++i) {
+            setKey(right, static_cast<uint32_t>(i - keep), items[i].first);
+            setValue(right, static_cast<uint32_t>(i - keep), items[i].second);
+        }
+        head->count = static_cast<uint32_t>(keep);
+        head->next = sibling;
+        for(size_t i = 0; i < keep; ++i) {
+            setKey(data, static_cast<uint32_t>(i), items[i].first);
+            setValue(data, static_cast<uint32_t>(i), items[i].second);
+        }
+        separator = items[keep].first;
+        pool_->unpin(siblingFrame, true);
+        pool_->unpin(frame, true);
+        return true;
+    }
+
+    uint32_t slot = childSlot(data, key);
+    uint32_t child = childAt(data, slot);
+    Key childSeparator;
+    uint32_t childSibling;
+    bool split;
+    try {
+        split = insert(child, key, value, childSeparator, childSibling);
+    }
+    catch(...) {
+        pool_->unpin(frame, false);
+        throw;
+    }
+    if(!split) {
+        pool_->unpin(frame, false);
+        return false;
+    }
+
+    //link the child's new sibling in right after it
+    std::vector<Key> keys;
+    std::vector<uint32_t> children;
+    keys.reserve(head->count + 1);
+    children.reserve(head->count + 2);
+    for(uint32_t i = 0; i < head->count; ++i) {
+        keys.push_back(keyAt(data, i));
+    }
+    for(uint32_t i = 0; i <= head->count; ++i) {
+        children.push_back(childAt(data, i));
+    }
+    keys.insert(keys.begin() + slot, childSeparator);
+    children.insert(children.begin() + slot + 1, childSibling);
+
+    if(keys.size() <= innerCapacity_) {
+        head->count = static_cast<uint32_t>(keys.size());
+        for(size_t i = 0; i < keys.size(); ++i) {
+            setKey(data, static_cast<uint32_t>(i), keys[i]);
+        }
+        for(size_t i = 0; i < children.size(); ++i) {
+            setChild(data, static_cast<uint32_t>(i), children[i]);
+        }
+        pool_->unpin(frame, true);
+        return false;
+    }
+
+    //full: the middle key moves up, the keys after it go to a new page
+    size_t middle = keys.size() / 2;
+    sibling = allocatePage();
+    size_t siblingFrame = pool_->pinNew(sibling);
+    char* right = pool_->data(siblingFrame);
+    header(right)->leaf = 0;
+    header(right)->count = static_cast<uint32_t>(keys.size() - middle - 1);
+    for(size_t i = middle + 1; i < keys.size(); ++i) {
+        setKey(right, static_cast<uint32_t>(i - middle - 1), keys[i]);
+    }
+    for(size_t i = middle + 1; i < children.size(); ++i) {
+        setChild(right, static_cast<uint32_t>(i - middle - 1), children[i]);
+    }
+    head->count = static_cast<uint32_t>(middle);
+    for(size_t i = 0; i < middle; ++i) {
+        setKey(data, static_cast<uint32_t>(i), keys[i]);
+    }
+    for(size_t i = 0; i <= middle; ++i) {
+        setChild(data, static_cast<uint32_t>(i), children[i]);
+    }
+    separator = keys[middle];
+    pool_->unpin(siblingFrame, true);
+    pool_->unpin(frame, true);
+    return true;
+}
+
+/**
+* The leaf whose key range covers key.
+*/
+template<class Key, class Value>
+uint32_t PagedBTree<Key, Value>::findLeaf(const Key& key)
+{
+    uint32_t page = root_;
+    while(true) {
+        size_t frame = pool_->pin(page);
+        const char* data = pool_->data(frame);
+        if(header(data)->leaf) {
+            pool_->unpin(frame, false);
+            return page;
+        }
+        uint32_t child = childAt(data, childSlot(data, key));
+        pool_->unpin(frame, false);
+        page = child;
+    }
+}
+
+/**
+* The first slot of a leaf whose key is not less than key.
+*/
+template<class Key, class Value>
+uint32_t PagedBTree<Key, Value>::lowerSlot(const char* page, const Key& key) const
+{
+    uint32_t lo = 0;
+    uint32_t hi = header(page)->count;
+    while(lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if(keyAt(page, mid) < key) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+* The child of an internal page to follow for key: the number of
+* separators that are not greater than it.
+*/
+template<class Key, class Value>
+uint32_t PagedBTree<Key, Value>::childSlot(const char* page, const Key& key) const
+{
+    uint32_t lo = 0;
+    uint32_t hi = header(page)->count;
+    while(lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if(key < keyAt(page, mid)) {
+            hi = mid;
+        }
+        else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
+
+template<class Key, class Value>
+uint32_t PagedBTree<Key, Value>::allocatePage()
+{
+    if(pages_ == UINT32_MAX) {
+        throw std::length_error("Tree file is full");
+    }
+    return pages_++;
+}
+
+// Page contents are copied in and out with memcpy, which keeps every
+// access well defined whatever the alignment of Key and Value.
+
+template<class Key, class Value>
+typename PagedBTree<Key, Value>::PageHeader* PagedBTree<Key, Value>::header(char* page)
+{
+    return reinterpret_cast<PageHeader*>(page);
+}
+
+template<class Key, class Value>
+const typename PagedBTree<Key, Value>::PageHeader* PagedBTree<Key, Value>::header(const char* page)
+{
+    return reinterpret_cast<const PageHeader*>(page);
+}
+
+template<class Key, class Value>
+Key PagedBTree<Key, Value>::keyAt(const char* page, uint32_t i)
+{
+    Key key;
+    std::memcpy(&key, page + sizeof(PageHeader) + i * sizeof(Key), sizeof(Key));
+    return key;
+}
+
+template<class Key, class Value>
+void PagedBTree<Key, Value>::setKey(char* page, uint32_t i, const Key& key)
+{
+    std::memcpy(page + sizeof(PageHeader) + i * sizeof(Key), &key, sizeof(Key));
+}
+
+template<class Key, class Value>
+Value PagedBTree<Key, Value>::valueAt(const char* page, uint32_t i) const
+{
+    Value value;
+    std::memcpy(&value, valueBase(page) + i * sizeof(Value), sizeof(Value));
+    return value;
+}
+
+template<class Key, class Value>
+void PagedBTree<Key, Value>::setValue(char* page, uint32_t i, const Value& value)
+{
+    std::memcpy(valueBase(page) + i * sizeof(Value), &value, sizeof(Value));
+}
+
+template<class Key, class Value>
+uint32_t PagedBTree<Key, Value>::childAt(const char* page, uint32_t i) const
+{
+    uint32_t child;
+    std::memcpy(&child, childBase(page) + i * sizeof(uint32_t), sizeof(uint32_t));
+    return child;
+}
+
+template<class Key, class Value>
+void PagedBTree<Key, Value>::setChild(char* page, uint32_t i, uint32_t child)
+{
+    std::memcpy(childBase(page) + i * sizeof(uint32_t), &child, sizeof(uint32_t));
+}
+
+template<class Key, class Value>
+char* PagedBTree<Key, Value>::valueBase(char* page) const
+{
+    return page + sizeof(PageHeader) + leafCapacity_ * sizeof(Key);
+}
+
+template<class Key, class Value>
+const char* PagedBTree<Key, Value>::valueBase(const char* page) const
+{
+    return page + sizeof(PageHeader) + leafCapacity_ * sizeof(Key);
+}
+
+template<class Key, class Value>
+char* PagedBTree<Key, Value>::childBase(char* page) const
+{
+    return page + sizeof(PageHeader) + innerCapacity_ * sizeof(Key);
+}
+
+template<class Key, class Value>
+const char* PagedBTree<Key, Value>::childBase(const char* page) const
+{
+    return page + sizeof(PageHeader) + innerCapacity_ * sizeof(Key);
+}
+
+
+#endif
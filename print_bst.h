@@ -0,0 +1,103 @@
+#ifndef PRINT_BST_H
+#define PRINT_BST_H
+
+// Included at the end of bst.h, inside the BinarySearchTree implementations.
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+* Writes value to out if it has an operator<<, and "?" otherwise, so that
+* trees keyed by pairs or other plain structs can still be printed.
+*/
+template<typename T>
+auto printBSTKey(std::ostream& out, const T& value, int) -> decltype(out << value, void())
+{
+    out << value;
+}
+
+template<typename T>
+void printBSTKey(std::ostream& out, const T&, long)
+{
+    out << "?";
+}
+
+/**
+* Prints up to 5 levels of the subtree rooted at r, one line per level.
+* Each node gets a cell of the same width, centred over its two children,
+* and a missing node is shown as "-". Tombstones are shown in brackets.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::printRoot (Node<Key, Value> *r) const
+{
+    const int levels = 5;
+    if(r == NULL) {
+        std::cout << "(empty)" << std::endl;
+        return;
+    }
+
+    //collect the labels level by level, keeping NULL placeholders
+    std::vector<std::vector<std::string> > labels;
+    std::vector<Node<Key, Value>*> level(1, r);
+    size_t width = 1;
+    for(int depth = 0; depth < levels; ++depth) {
+        bool any = false;
+        std::vector<std::string> row;
+        std::vector<Node<Key, Value>*> next;
+        for(size_t i = 0; i < level.size(); ++i) {
+            Node<Key, Value>* node = level[i];
+            if(node == NULL) {
+                row.push_back("-");
+                next.push_back(NULL);
+                next.push_back(NULL);
+                continue;
+            }
+            any = true;
+            std::ostringstream label;
+            if(node->isDeleted()) {
+                label << "[";
+            }
+            printBSTKey(label, node->getKey(), 0);
+            if(node->isDeleted()) {
+                label << "]";
+            }
+            row.push_back(label.str());
+            width = std::max(width, row.back().size());
+            next.push_back(node->getLeft());
+            next.push_back(node->getRight());
+        }
+        if(!any) {
+            break;
+        }
+        labels.push_back(row);
+        level.swap(next);
+    }
+
+    //the bottom row gets one cell per node; each row above doubles the cell
+    size_t cell = width + 1;
+    for(size_t depth = 0; depth < labels.size(); ++depth) {
+        size_t span = cell << (labels.size() - 1 - depth);
+        std::string line;
+        for(size_t i = 0; i < labels[depth].size(); ++i) {
+            const std::string& label = labels[depth][i];
+            size_t pad = (span > label.size()) ? span - label.size() : 0;
+            line += std::string(pad / 2, ' ') + label + std::string(pad - pad / 2, ' ');
+        }
+        std::cout << line << std::endl;
+    }
+}
+
+/**
+* Prints the whole tree, as BinarySearchTree::print does.
+*/
+template<typename PPKey, typename PPValue>
+void prettyPrintBST(BinarySearchTree<PPKey, PPValue> & tree)
+{
+    tree.printRoot(tree.root_);
+}
+
+#endif
@@ -0,0 +1,408 @@
+#ifndef RBBST_H
+#define RBBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <stdexcept>
+#include "bst.h"
+
+/**
+* A special kind of node for a Red-Black tree, which adds the color as a data member.
+* The color takes a single byte, the same slot an AVLNode spends on its balance,
+* so a RBNode is never larger than an AVLNode.
+*/
+template <typename Key, typename Value>
+class RBNode : public Node<Key, Value>
+{
+public:
+    // Constructor/destructor.
+    RBNode(const Key& key, const Value& value, RBNode<Key, Value>* parent);
+    virtual ~RBNode();
+
+    // Getter/setter for the node's color.
+    bool isRed() const;
+    void setRed(bool red);
+
+    // Getters for parent, left, and right. These need to be redefined since they
+    // return pointers to RBNodes - not plain Nodes. See the Node class in bst.h
+    // for more information.
+    virtual RBNode<Key, Value>* getParent() const override;
+    virtual RBNode<Key, Value>* getLeft() const override;
+    virtual RBNode<Key, Value>* getRight() const override;
+
+protected:
+    bool red_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the RBNode class.
+  -------------------------------------------------
+*/
+
+/**
+* An explicit constructor to initialize the elements by calling the base class constructor and setting
+* the color to red since every new node will be red when it is first inserted.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>::RBNode(const Key& key, const Value& value, RBNode<Key, Value> *parent) :
+    Node<Key, Value>(key, value, parent), red_(true)
+{
+
+}
+
+/**
+* A destructor which does nothing.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>::~RBNode()
+{
+
+}
+
+/**
+* A getter for the color of a RBNode.
+*/
+template<class Key, class Value>
+bool RBNode<Key, Value>::isRed() const
+{
+    return red_;
+}
+
+/**
+* A setter for the color of a RBNode.
+*/
+template<class Key, class Value>
+void RBNode<Key, Value>::setRed(bool red)
+{
+    red_ = red;
+}
+
+/**
+* An overridden function for getting the parent since a static_cast is necessary to make sure
+* that our node is a RBNode.
+*/
+template<class Key, class Value>
+RBNode<Key, Value> *RBNode<Key, Value>::getParent() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->parent_);
+}
+
+/**
+* Overridden for the same reasons as above.
+*/
+template<class Key, class Value>
+RBNode<Key, Value> *RBNode<Key, Value>::getLeft() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->left_);
+}
+
+/**
+* Overridden for the same reasons as above.
+*/
+template<class Key, class Value>
+RBNode<Key, Value> *RBNode<Key, Value>::getRight() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->right_);
+}
+
+
+/*
+  -----------------------------------------------
+  End implementations for the RBNode class.
+  -----------------------------------------------
+*/
+
+
+/**
+* A Red-Black tree. Lookups are slightly deeper than in an AVLTree, but an
+* insert needs at most 2 rotations and a remove at most 3, so delete-heavy
+* workloads never cascade rotations up to the root.
+*/
+template <class Key, class Value>
+class RedBlackTree : public BinarySearchTree<Key, Value>
+{
+public:
+    explicit RedBlackTree(std::pmr::memory_resource* resource = NULL);
+    virtual void insert (const std::pair<const Key, Value> &new_item);
+    virtual size_t eraseRange(const Key& lo, const Key& hi) override;
+
+    virtual void rebuildOptimal() override;
+protected:
+    virtual void removeNode(Node<Key, Value>* n) override;
+    virtual void nodeSwap( RBNode<Key,Value>* n1, RBNode<Key,Value>* n2);
+
+    // Add helper functions here
+    void insertFix(RBNode<Key, Value>* n);
+    void removeFix(RBNode<Key, Value>* n, RBNode<Key, Value>* parent);
+    static bool isRed(RBNode<Key, Value>* n);
+};
+
+template<class Key, class Value>
+RedBlackTree<Key, Value>::RedBlackTree(std::pmr::memory_resource* resource) :
+    BinarySearchTree<Key, Value>(resource)
+{
+
+}
+
+/**
+* Always throws std::logic_error: a weight-shaped tree would break the
+* color invariants.
+*/
+template<class Key, class Value>
+void RedBlackTree<Key, Value>::rebuildOptimal()
+{
+    throw std::logic_error("RedBlackTree cannot take a weighted shape");
+}
+
+/*
+ * Recall: If key is already in the tree, you should
+ * overwrite the current value with the updated value.
+ */
+template<class Key, class Value>
+void RedBlackTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+{
+    const Key& key = new_item.first;
+    RBNode<Key, Value>* parent = NULL;
+    RBNode<Key, Value>* temp = static_cast<RBNode<Key, Value>*>(this->root_);
+
+    while(temp != NULL) {
+        parent = temp;
+        if(key < temp->getKey()) {
+            temp = temp->getLeft();
+        }
+        else if(temp->getKey() < key) {
+            temp = temp->getRight();
+        }
+        else { //update value
+            temp->setValue(new_item.second);
+            return;
+        }
+    }
+
+    RBNode<Key, Value>* node = new (this->allocateNode(sizeof(RBNode<Key, Value>)))
+        RBNode<Key, Value>(key, new_item.second, parent);
+    if(parent == NULL) { //tree is empty (adding to root)
+        this->root_ = node;
+    }
+    else if(key < parent->getKey()) {
+        parent->setLeft(node);
+    }
+    else {
+        parent->setRight(node);
+    }
+    this->noteInsert(node);
+
+    insertFix(node);
+}
+
+/**
+* Restores the red-black properties after n was added as a red leaf.
+* Recolors while the uncle is red, then finishes with at most 2 rotations.
+*/
+template<class Key, class Value>
+void RedBlackTree<Key, Value>::insertFix(RBNode<Key, Value>* n) {
+    RBNode<Key, Value>* p = n->getParent();
+
+    while(p != NULL && p->isRed()) {
+        RBNode<Key, Value>* g = p->getParent(); //exists since the root is black
+
+        if(g->getLeft() == p) { //parent is a left child
+            RBNode<Key, Value>* u = g->getRight();
+            if(isRed(u)) { //case 1: push the red up
+                p->setRed(false);
+                u->setRed(false);
+                g->setRed(true);
+                n = g;
+                p = n->getParent();
+                continue;
+            }
+            if(p->getRight() == n) { //case 2: zig-zag becomes zig-zig
+                this->rotateLeft(p);
+                n = p;
+                p = n->getParent();
+            }
+            p->setRed(false); //case 3
+            g->setRed(true);
+            this->rotateRight(g);
+        }
+        else { //parent is a right child
+            RBNode<Key, Value>* u = g->getLeft();
+            if(isRed(u)) { //case 1
+                p->setRed(false);
+                u->setRed(false);
+                g->setRed(true);
+                n = g;
+                p = n->getParent();
+                continue;
+            }
+            if(p->getLeft() == n) { //case 2
+                this->rotateRight(p);
+                n = p;
+                p = n->getParent();
+            }
+            p->setRed(false); //case 3
+            g->setRed(true);
+            this->rotateLeft(g);
+        }
+        break;
+    }
+
+    static_cast<RBNode<Key, Value>*>(this->root_)->setRed(false);
+}
+
+/*
+ * Recall: The writeup specifies that if a node has 2 children you
+ * should swap with the predecessor and then remove.
+ */
+template<class Key, class Value>
+void RedBlackTree<Key, Value>::removeNode(Node<Key, Value>* n)
+{
+    RBNode<Key, Value>* node = static_cast<RBNode<Key, Value>*>(n);
+    this->noteRemove(node);
+
+    //node has 2 children
+    if(node->getLeft() != NULL && node->getRight() != NULL) {
+        nodeSwap(node, static_cast<RBNode<Key, Value>*>(this->predecessor(node)));
+    }
+
+    //node now has at most one child, which takes its place
+    RBNode<Key, Value>* child = node->getLeft();
+    if(child == NULL) {
+        child = node->getRight();
+    }
+    RBNode<Key, Value>* parent = node->getParent();
+
+    if(child != NULL) {
+        child->setParent(parent);
+    }
+    if(parent == NULL) {
+        this->root_ = child;
+    }
+    else if(parent->getLeft() == node) {
+        parent->setLeft(child);
+    }
+    else {
+        parent->setRight(child);
+    }
+
+    //removing a black node leaves its side one black short
+    if(!node->isRed()) {
+        removeFix(child, parent);
+    }
+
+    this->destroyNode(node);
+}
+
+/**
+* Removes every key in [lo, hi] one node at a time, starting from the
+* first key in range. Each remove does O(1) rotations and walking to the
+* successor is amortized O(1), so this skips the k searches that k
+* remove() calls would do.
+*/
+template<class Key, class Value>
+size_t RedBlackTree<Key, Value>::eraseRange(const Key& lo, const Key& hi)
+{
+    size_t count = 0;
+    Node<Key, Value>* node = this->internalLowerBound(lo);
+    while(node != NULL && !(hi < node->getKey())) {
+        //nodeSwap relinks nodes rather than copying items, so next stays valid
+        Node<Key, Value>* next = this->successor(node);
+        removeNode(node);
+        ++count;
+        node = next;
+    }
+    return count;
+}
+
+/**
+* Restores the red-black properties when the subtree at n (possibly NULL,
+* so its parent is passed too) is one black node short. Recolors walk up
+* the tree, but every case that rotates terminates, so at most 3
+* rotations happen in total.
+*/
+template<class Key, class Value>
+void RedBlackTree<Key, Value>::removeFix(RBNode<Key, Value>* n, RBNode<Key, Value>* parent) {
+    while(parent != NULL && !isRed(n)) {
+        if(parent->getLeft() == n) { //n is a left child
+            RBNode<Key, Value>* s = parent->getRight();
+
+            if(s->isRed()) { //case 1: make the sibling black
+                s->setRed(false);
+                parent->setRed(true);
+                this->rotateLeft(parent);
+                s = parent->getRight();
+            }
+            if(!isRed(s->getLeft()) && !isRed(s->getRight())) { //case 2: move the deficit up
+                s->setRed(true);
+                n = parent;
+                parent = n->getParent();
+                continue;
+            }
+            if(!isRed(s->getRight())) { //case 3: red nephew on the far side
+                s->getLeft()->setRed(false);
+                s->setRed(true);
+                this->rotateRight(s);
+                s = parent->getRight();
+            }
+            s->setRed(parent->isRed()); //case 4
+            parent->setRed(false);
+            s->getRight()->setRed(false);
+            this->rotateLeft(parent);
+        }
+        else { //n is a right child
+            RBNode<Key, Value>* s = parent->getLeft();
+
+            if(s->isRed()) { //case 1
+                s->setRed(false);
+                parent->setRed(true);
+                this->rotateRight(parent);
+                s = parent->getLeft();
+            }
+            if(!isRed(s->getLeft()) && !isRed(s->getRight())) { //case 2
+                s->setRed(true);
+                n = parent;
+                parent = n->getParent();
+                continue;
+            }
+            if(!isRed(s->getLeft())) { //case 3
+                s->getRight()->setRed(false);
+                s->setRed(true);
+                this->rotateLeft(s);
+                s = parent->getLeft();
+            }
+            s->setRed(parent->isRed()); //case 4
+            parent->setRed(false);
+            s->getLeft()->setRed(false);
+            this->rotateRight(parent);
+        }
+        n = static_cast<RBNode<Key, Value>*>(this->root_);
+        break;
+    }
+
+    if(n != NULL) {
+        n->setRed(false);
+    }
+}
+
+/**
+* NULL children count as black leaves.
+*/
+template<class Key, class Value>
+bool RedBlackTree<Key, Value>::isRed(RBNode<Key, Value>* n)
+{
+    return n != NULL && n->isRed();
+}
+
+template<class Key, class Value>
+void RedBlackTree<Key, Value>::nodeSwap( RBNode<Key,Value>* n1, RBNode<Key,Value>* n2)
+{
+    BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
+    bool tempR = n1->isRed();
+    n1->setRed(n2->isRed());
+    n2->setRed(tempR);
+}
+
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef SGBST_H
+#define SGBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include "bst.h"
+
+/**
+* A scapegoat tree: a self-rebalancing BST that uses the plain Node with no
+* per-node balance data. Only the tree-wide size and the largest size since
+* the last full rebuild are kept. When an insert lands deeper than
+* log base 1/alpha of the size, the lowest ancestor whose subtree is more
+* than alpha-weight-unbalanced is rebuilt into perfect balance in linear
+* time. When removes shrink the tree below alpha times its old size, the
+* whole tree is rebuilt. Operations are O(log n) amortized.
+*
+* alpha must be in (0.5, 1): lower keeps the tree flatter at the cost of
+* more frequent rebuilds.
+*/
+template <class Key, class Value>
+class ScapegoatTree : public BinarySearchTree<Key, Value>
+{
+public:
+    explicit ScapegoatTree(double alpha = 0.7, std::pmr::memory_resource* resource = NULL);
+    virtual void insert (const std::pair<const Key, Value> &new_item);
+    virtual size_t eraseRange(const Key& lo, const Key& hi) override;
+protected:
+    virtual void removeNode(Node<Key, Value>* node) override;
+
+    // Add helper functions here
+    void rebuild(Node<Key, Value>* node);
+    void rebuildIfShrunk();
+    static size_t countNodes(Node<Key, Value>* node);
+    int depthLimit() const;
+
+protected:
+    double alpha_;
+    size_t maxSize_;
+};
+
+/**
+* Constructor that takes the weight-balance bound alpha.
+*/
+template<class Key, class Value>
+ScapegoatTree<Key, Value>::ScapegoatTree(double alpha, std::pmr::memory_resource* resource) :
+    BinarySearchTree<Key, Value>(resource), alpha_(alpha), maxSize_(0)
+{
+    if(alpha_ <= 0.5 || alpha_ >= 1.0) {
+        throw std::out_of_range("Invalid alpha");
+    }
+}
+
+/*
+ * Recall: If key is already in the tree, you should
+ * overwrite the current value with the updated value.
+ */
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+{
+    const Key& key = new_item.first;
+    Node<Key, Value>* parent = NULL;
+    Node<Key, Value>* temp = this->root_;
+    int depth = 0;
+
+    while(temp != NULL) {
+        parent = temp;
+        if(key < temp->getKey()) {
+            temp = temp->getLeft();
+        }
+        else if(temp->getKey() < key) {
+            temp = temp->getRight();
+        }
+        else { //update value
+            temp->setValue(new_item.second);
+            return;
+        }
+        ++depth;
+    }
+
+    Node<Key, Value>* node = new (this->allocateNode(sizeof(Node<Key, Value>))) Node<Key, Value>(key, new_item.second, parent);
+    if(parent == NULL) { //tree is empty (adding to root)
+        this->root_ = node;
+    }
+    else if(key < parent->getKey()) {
+        parent->setLeft(node);
+    }
+    else {
+        parent->setRight(node);
+    }
+    this->noteInsert(node);
+    if(this->size_ > maxSize_) {
+        maxSize_ = this->size_;
+    }
+
+    if(depth <= depthLimit()) {
+        return;
+    }
+
+    //too deep: climb until a child holds more than alpha of its parent's weight
+    size_t childSize = 1;
+    Node<Key, Value>* child = node;
+    while(child->getParent() != NULL) {
+        Node<Key, Value>* p = child->getParent();
+        Node<Key, Value>* sibling = (p->getLeft() == child) ? p->getRight() : p->getLeft();
+        size_t parentSize = childSize + 1 + countNodes(sibling);
+        if(childSize > alpha_ * parentSize) {
+            rebuild(p);
+            return;
+        }
+        child = p;
+        childSize = parentSize;
+    }
+}
+
+/**
+* Removes like a plain BST, then rebuilds everything once enough
+* removes have happened that the depth bound could be exceeded.
+*/
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::removeNode(Node<Key, Value>* node)
+{
+    BinarySearchTree<Key, Value>::removeNode(node);
+    rebuildIfShrunk();
+}
+
+/**
+* Cuts the range out like a plain BST, then applies the same rebuild rule.
+*/
+template<class Key, class Value>
+size_t ScapegoatTree<Key, Value>::eraseRange(const Key& lo, const Key& hi)
+{
+    size_t count = BinarySearchTree<Key, Value>::eraseRange(lo, hi);
+    rebuildIfShrunk();
+    return count;
+}
+
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::rebuildIfShrunk()
+{
+    if(this->size_ < alpha_ * maxSize_) {
+        if(this->root_ != NULL) {
+            rebuild(this->root_);
+        }
+        maxSize_ = this->size_;
+    }
+}
+
+/**
+* Rebuilds the subtree rooted at node into perfect balance in place.
+*/
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::rebuild(Node<Key, Value>* node)
+{
+    Node<Key, Value>* parent = node->getParent();
+    bool isLeft = (parent != NULL && parent->getLeft() == node);
+
+    std::vector<Node<Key, Value>*> nodes;
+    this->flatten(node, nodes);
+    Node<Key, Value>* root = this->buildBalanced(nodes, 0, nodes.size(), parent);
+
+    if(parent == NULL) {
+        this->root_ = root;
+    }
+    else if(isLeft) {
+        parent->setLeft(root);
+    }
+    else {
+        parent->setRight(root);
+    }
+}
+
+/**
+* Counts the nodes of a subtree. Only called on the rebuild path, whose
+* linear cost is paid for by the inserts since the last rebuild.
+*/
+template<class Key, class Value>
+size_t ScapegoatTree<Key, Value>::countNodes(Node<Key, Value>* node)
+{
+    if(node == NULL) {
+        return 0;
+    }
+    return 1 + countNodes(node->getLeft()) + countNodes(node->getRight());
+}
+
+/**
+* The deepest an insert may land before a rebuild: log base 1/alpha of the size.
+*/
+template<class Key, class Value>
+int ScapegoatTree<Key, Value>::depthLimit() const
+{
+    return static_cast<int>(std::floor(std::log(static_cast<double>(this->size_)) / std::log(1.0 / alpha_)));
+}
+
+
+#endif
@@ -0,0 +1,438 @@
+#ifndef SHARDEDMAP_H
+#define SHARDEDMAP_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+
+/**
+* A thread-safe ordered map that range-partitions its keys across several
+* AVLTree shards, each behind its own reader-writer lock. A point operation
+* locks only the shard that owns its key, so operations on different
+* shards run in parallel and reads of the same shard share it. Ordered
+* iteration and range scans walk the shards in key order.
+*
+* Shards split and merge online. A shard that grows past maxShardSize is
+* split at its median key. A shard that shrinks below an eighth of that is
+* merged into a neighbour. rebalance() also splits shards that took more
+* than twice their share of the operations since the last call, and merges
+* cold, small neighbours. Splits and merges briefly take the routing table
+* exclusively. They cost O(log n) for the tree surgery, plus a walk over
+* the shard to find the median and count what moved.
+*
+* Values are returned by copy because a reference would outlive the lock.
+*/
+template <class Key, class Value>
+class ShardedAVLMap
+{
+public:
+    ShardedAVLMap(size_t maxShardSize = 65536);
+    ShardedAVLMap(const std::vector<Key>& bounds, size_t maxShardSize = 65536);
+    ShardedAVLMap(const ShardedAVLMap<Key, Value>& other) = delete;
+    ShardedAVLMap<Key, Value>& operator=(const ShardedAVLMap<Key, Value>& other) = delete;
+    ~ShardedAVLMap();
+
+    void insert(const std::pair<const Key, Value>& new_item);
+    bool erase(const Key& key);
+    bool find(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+    void clear();
+    bool empty() const;
+    size_t size() const;
+
+    // Visit items in key order. Each shard is read-locked while it is
+    // visited, so f must not call back into the map.
+    template<class F> void forEach(F f) const;
+    template<class F> void scan(const Key& lo, const Key& hi, F f) const;
+
+    void rebalance();
+    size_t shardCount() const;
+    std::vector<size_t> shardSizes() const;
+
+protected:
+    struct Shard
+    {
+        Shard() : ops(0) { }
+
+        AVLTree<Key, Value> tree;
+        mutable std::shared_mutex lock;
+        mutable std::atomic<size_t> ops; //operations since the last rebalance
+    };
+
+    // Add helper functions here
+    size_t route(const Key& key) const;
+    void splitShard(const Key& key);
+    void mergeShard(const Key& key);
+    bool split(size_t i);
+    void merge(size_t i);
+
+protected:
+    // Guards shards_ and bounds_. Point operations hold it shared,
+    // splits and merges hold it exclusively.
+    mutable std::shared_mutex tableLock_;
+    std::vector<Shard*> shards_;
+    std::vector<Key> bounds_; //bounds_[i] is the smallest key shard i + 1 may hold
+    size_t maxShardSize_;
+};
+
+/**
+* Starts with a single shard that splits as the map grows.
+*/
+template<class Key, class Value>
+ShardedAVLMap<Key, Value>::ShardedAVLMap(size_t maxShardSize) :
+    maxShardSize_(maxShardSize)
+{
+    if(maxShardSize_ < 2) {
+        throw std::out_of_range("Invalid shard size");
+    }
+    shards_.push_back(new Shard);
+}
+
+/**
+* Starts with one shard per range, split at the given sorted bounds.
+*/
+template<class Key, class Value>
+ShardedAVLMap<Key, Value>::ShardedAVLMap(const std::vector<Key>& bounds, size_t maxShardSize) :
+    bounds_(bounds), maxShardSize_(maxShardSize)
+{
+    if(maxShardSize_ < 2) {
+        throw std::out_of_range("Invalid shard size");
+    }
+    for(size_t i = 1; i < bounds_.size(); ++i) {
+        if(!(bounds_[i - 1] < bounds_[i])) {
+            throw std::out_of_range("Invalid bounds");
+        }
+    }
+    for(size_t i = 0; i <= bounds_.size(); ++i) {
+        shards_.push_back(new Shard);
+    }
+}
+
+template<class Key, class Value>
+ShardedAVLMap<Key, Value>::~ShardedAVLMap()
+{
+    for(size_t i = 0; i < shards_.size(); ++i) {
+        delete shards_[i];
+    }
+}
+
+/**
+* Inserts or overwrites, then splits the shard if it has grown too large.
+*/
+template<class Key, class Value>
+void ShardedAVLMap<Key, Value>::insert(const std::pair<const Key, Value>& new_item)
+{
+    bool full;
+    {
+        std::shared_lock<std::shared_mutex> table(tableLock_);
+        Shard* shard = shards_[route(new_item.first)];
+        std::unique_lock<std::shared_mutex> lock(shard->lock);
+        shard->tree.insert(new_item);
+        shard->ops.fetch_add(1, std::memory_order_relaxed);
+        full = shard->tree.size() > maxShardSize_;
+    }
+    if(full) {
+        splitShard(new_item.first);
+    }
+}
+
+/**
+* Removes key and returns true if it was present. A shard left nearly
+* empty is merged into a neighbour.
+*/
+template<class Key, class Value>
+bool ShardedAVLMap<Key, Value>::erase(const Key& key)
+{
+    bool removed;
+    bool sparse;
+    {
+        std::shared_lock<std::shared_mutex> table(tableLock_);
+        Shard* shard = shards_[route(key)];
+        std::unique_lock<std::shared_mutex> lock(shard->lock);
+        size_t before = shard->tree.size();
+        shard->tree.remove(key);
+        shard->ops.fetch_add(1, std::memory_order_relaxed);
+        removed = shard->tree.size() != before;
+        sparse = removed && shards_.size() > 1 && shard->tree.size() < maxShardSize_ / 8;
+    }
+    if(sparse) {
+        mergeShard(key);
+    }
+    return removed;
+}
+
+/**
+* Copies the value for key into value and returns true if key is present.
+*/
+template<class Key, class Value>
+bool ShardedAVLMap<Key, Value>::find(const Key& key, Value& value) const
+{
+    std::shared_lock<std::shared_mutex> table(tableLock_);
+    Shard* shard = shards_[route(key)];
+    std::shared_lock<std::shared_mutex> lock(shard->lock);
+    shard->ops.fetch_add(1, std::memory_order_relaxed);
+    typename AVLTree<Key, Value>::iterator it = shard->tree.find(key);
+    if(it == shard->tree.end()) {
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+template<class Key, class Value>
+bool ShardedAVLMap<Key, Value>::contains(const Key& key) const
+{
+    std::shared_lock<std::shared_mutex> table(tableLock_);
+    Shard* shard = shards_[route(key)];
+    std::shared_lock<std::shared_mutex> lock(shard->lock);
+    shard->ops.fetch_add(1, std::memory_order_relaxed);
+    return shard->tree.find(key) != shard->tree.end();
+}
+
+/**
+* Removes everything and goes back to a single shard.
+*/
+template<class Key, class Value>
+void ShardedAVLMap<Key, Value>::clear()
+{
+    std::unique_lock<std::shared_mutex> table(tableLock_);
+    for(size_t i = 1; i < shards_.size(); ++i) {
+        delete shards_[i];
+    }
+    shards_.resize(1);
+    bounds_.clear();
+    shards_[0]->tree.clear();
+    shards_[0]->ops.store(0, std::memory_order_relaxed);
+}
+
+template<class Key, class Value>
+bool ShardedAVLMap<Key, Value>::empty() const
+{
+    return size() == 0;
+}
+
+/**
+* The total over all shards. Each shard is counted under its lock, but
+* concurrent writers can change the total while it is being summed.
+*/
+template<class Key, class Value>
+size_t ShardedAVLMap<Key, Value>::size() const
+{
+    std::shared_lock<std::shared_mutex> table(tableLock_);
+    size_t result = 0;
+    for(size_t i = 0; i < shards_.size(); ++i) {
+        std::shared_lock<std::shared_mutex> lock(shards_[i]->lock);
+        result += shards_[i]->tree.size();
+    }
+    return result;
+}
+
+/**
+* Calls f(key, value) for every item in key order. Shards are visited one
+* after another, so the walk sees each shard at a single point in time
+* but not the whole map.
+*/
+template<class Key, class Value>
+template<class F>
+void ShardedAVLMap<Key, Value>::forEach(F f) const
+{
+    std::shared_lock<std::shared_mutex> table(tableLock_);
+    for(size_t i = 0; i < shards_.size(); ++i) {
+        std::shared_lock<std::shared_mutex> lock(shards_[i]->lock);
+        const AVLTree<Key, Value>& tree = shards_[i]->tree;
+        for(typename AVLTree<Key, Value>::iterator it = tree.begin(); it != tree.end(); ++it) {
+            f(it->first, it->second);
+        }
+    }
+}
+
+/**
+* Calls f(key, value) for every item with a key in [lo, hi], in key
+* order, visiting only the shards whose ranges overlap it.
+*/
+template<class Key, class Value>
+template<class F>
+void ShardedAVLMap<Key, Value>::scan(const Key& lo, const Key& hi, F f) const
+{
+    if(hi < lo) {
+        return;
+    }
+    std::shared_lock<std::shared_mutex> table(tableLock_);
+    size_t last = route(hi);
+    for(size_t i = route(lo); i <= last; ++i) {
+        std::shared_lock<std::shared_mutex> lock(shards_[i]->lock);
+        const AVLTree<Key, Value>& tree = shards_[i]->tree;
+        shards_[i]->ops.fetch_add(1, std::memory_order_relaxed);
+        for(typename AVLTree<Key, Value>::iterator it = tree.lowerBound(lo);
+            it != tree.end() && !(hi < it->first); ++it) {
+            f(it->first, it->second);
+        }
+    }
+}
+
+/**
+* Splits every shard that took more than twice the average number of
+* operations since the last call, then merges neighbouring shards that
+* are both cold and together no larger than a quarter of maxShardSize.
+*/
+template<class Key, class Value>
+void ShardedAVLMap<Key, Value>::rebalance()
+{
+    std::unique_lock<std::shared_mutex> table(tableLock_);
+
+    size_t total = 0;
+    for(size_t i = 0; i < shards_.size(); ++i) {
+        total += shards_[i]->ops.load(std::memory_order_relaxed);
+    }
+    size_t average = total / shards_.size();
+
+    for(size_t i = 0; i < shards_.size(); ++i) {
+        size_t ops = shards_[i]->ops.load(std::memory_order_relaxed);
+        if(ops > 2 * average && shards_[i]->tree.size() >= 2 && split(i)) {
+            //both halves inherit half the heat and are not split again this round
+            shards_[i]->ops.store(ops / 2, std::memory_order_relaxed);
+            shards_[i + 1]->ops.store(ops / 2, std::memory_order_relaxed);
+            ++i;
+        }
+    }
+
+    size_t i = 0;
+    while(i + 1 < shards_.size()) {
+        Shard* a = shards_[i];
+        Shard* b = shards_[i + 1];
+        bool cold = a->ops.load(std::memory_order_relaxed) + b->ops.load(std::memory_order_relaxed) <= average;
+        if(cold && a->tree.size() + b->tree.size() <= maxShardSize_ / 4) {
+            merge(i);
+        }
+        else {
+            ++i;
+        }
+    }
+
+    for(size_t j = 0; j < shards_.size(); ++j) {
+        shards_[j]->ops.store(0, std::memory_order_relaxed);
+    }
+}
+
+template<class Key, class Value>
+size_t ShardedAVLMap<Key, Value>::shardCount() const
+{
+    std::shared_lock<std::shared_mutex> table(tableLock_);
+    return shards_.size();
+}
+
+template<class Key, class Value>
+std::vector<size_t> ShardedAVLMap<Key, Value>::shardSizes() const
+{
+    std::shared_lock<std::shared_mutex> table(tableLock_);
+    std::vector<size_t> result;
+    for(size_t i = 0; i < shards_.size(); ++i) {
+        std::shared_lock<std::shared_mutex> lock(shards_[i]->lock);
+        result.push_back(shards_[i]->tree.size());
+    }
+    return result;
+}
+
+/**
+* The index of the shard that owns key. The caller holds tableLock_.
+*/
+template<class Key, class Value>
+size_t ShardedAVLMap<Key, Value>::route(const Key& key) const
+{
+    //first bound greater than key
+    size_t lo = 0;
+    size_t hi = bounds_.size();
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(key < bounds_[mid]) {
+            hi = mid;
+        }
+        else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
+
+/**
+* Splits the shard owning key if it is still too large once the table is
+* held exclusively; another thread may have split it first.
+*/
+template<class Key, class Value>
+void ShardedAVLMap<Key, Value>::splitShard(const Key& key)
+{
+    std::unique_lock<std::shared_mutex> table(tableLock_);
+    size_t i = route(key);
+    if(shards_[i]->tree.size() > maxShardSize_) {
+        split(i);
+    }
+}
+
+/**
+* Merges the shard owning key into its smaller neighbour if it is still
+* sparse and the result stays at or under half of maxShardSize.
+*/
+template<class Key, class Value>
+void ShardedAVLMap<Key, Value>::mergeShard(const Key& key)
+{
+    std::unique_lock<std::shared_mutex> table(tableLock_);
+    size_t i = route(key);
+    if(shards_.size() < 2 || shards_[i]->tree.size() >= maxShardSize_ / 8) {
+        return;
+    }
+
+    size_t left = (i > 0) ? shards_[i - 1]->tree.size() : static_cast<size_t>(-1);
+    size_t right = (i + 1 < shards_.size()) ? shards_[i + 1]->tree.size() : static_cast<size_t>(-1);
+    size_t j = (left <= right) ? i - 1 : i;
+    if(shards_[j]->tree.size() + shards_[j + 1]->tree.size() <= maxShardSize_ / 2) {
+        merge(j);
+    }
+}
+
+/**
+* Splits shard i at its median key into shards i and i + 1. Returns false
+* if the shard has too few keys. The caller holds tableLock_ exclusively.
+*/
+template<class Key, class Value>
+bool ShardedAVLMap<Key, Value>::split(size_t i)
+{
+    AVLTree<Key, Value>& tree = shards_[i]->tree;
+    if(tree.size() < 2) {
+        return false;
+    }
+
+    typename AVLTree<Key, Value>::iterator it = tree.begin();
+    for(size_t n = tree.size() / 2; n > 0; --n) {
+        ++it;
+    }
+    Key median = it->first;
+
+    Shard* upper = new Shard;
+    tree.splitAt(median, upper->tree);
+    shards_.insert(shards_.begin() + i + 1, upper);
+    bounds_.insert(bounds_.begin() + i, median);
+    return true;
+}
+
+/**
+* Merges shard i + 1 into shard i. The caller holds tableLock_ exclusively.
+*/
+template<class Key, class Value>
+void ShardedAVLMap<Key, Value>::merge(size_t i)
+{
+    Shard* upper = shards_[i + 1];
+    shards_[i]->tree.concat(upper->tree);
+    shards_[i]->ops.fetch_add(upper->ops.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    shards_.erase(shards_.begin() + i + 1);
+    bounds_.erase(bounds_.begin() + i);
+    delete upper;
+}
+
+
+#endif
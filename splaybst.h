@@ -0,0 +1,344 @@
+#ifndef SPLAYBST_H
+#define SPLAYBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include "bst.h"
+
+/**
+* A splay tree built on the plain BST Node. Every find/insert/remove moves
+* the key it touched to the root, so a small working set of hot keys stays
+* within a few levels of the root no matter how large the tree grows.
+* Splaying is done top-down in a single pass, without recursion.
+*
+* Because lookups restructure the tree, the non-const find() and
+* operator[] splay; the const versions inherited from BinarySearchTree
+* still work but leave the shape alone.
+*/
+template <class Key, class Value>
+class SplayTree : public BinarySearchTree<Key, Value>
+{
+public:
+    explicit SplayTree(std::pmr::memory_resource* resource = NULL);
+    virtual void insert (const std::pair<const Key, Value> &new_item);
+    virtual void remove(const Key& key);
+
+    using BinarySearchTree<Key, Value>::find;
+    using BinarySearchTree<Key, Value>::operator[];
+    typename BinarySearchTree<Key, Value>::iterator find(const Key& key);
+    Value& operator[](const Key& key);
+protected:
+    virtual void removeNode(Node<Key, Value>* node) override;
+    void splayToRoot(Node<Key, Value>* node);
+    static Node<Key, Value>* splay(Node<Key, Value>* t, const Key& key);
+};
+
+template<class Key, class Value>
+SplayTree<Key, Value>::SplayTree(std::pmr::memory_resource* resource) :
+    BinarySearchTree<Key, Value>(resource)
+{
+
+}
+
+/**
+* Splays the root to key (or the last node on its search path) and
+* returns an iterator to it if the key is present.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+SplayTree<Key, Value>::find(const Key& key)
+{
+    //after the splay the key is either at the root or missing, with the
+    //root's child on the key's side empty, so the base find stops at once
+    this->root_ = splay(this->root_, key);
+    return BinarySearchTree<Key, Value>::find(key);
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key, splaying it to the root
+ */
+template<class Key, class Value>
+Value& SplayTree<Key, Value>::operator[](const Key& key)
+{
+    this->root_ = splay(this->root_, key);
+    if(this->root_ == NULL || this->root_->getKey() < key || key < this->root_->getKey()) {
+        throw std::out_of_range("Invalid key");
+    }
+    return this->root_->getValue();
+}
+
+/*
+ * Recall: If key is already in the tree, you should
+ * overwrite the current value with the updated value.
+ */
+template<class Key, class Value>
+void SplayTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+{
+    const Key& key = new_item.first;
+    Node<Key, Value>* root = splay(this->root_, key);
+    this->root_ = root;
+
+    //tree is empty (adding to root)
+    if(root == NULL) {
+        this->root_ = new (this->allocateNode(sizeof(Node<Key, Value>))) Node<Key, Value>(key, new_item.second, NULL);
+        this->noteInsert(this->root_);
+        return;
+    }
+
+    if(!(key < root->getKey()) && !(root->getKey() < key)) { //update value
+        root->setValue(new_item.second);
+        return;
+    }
+
+    //the new node becomes the root and the old root's side is split off
+    Node<Key, Value>* node = new (this->allocateNode(sizeof(Node<Key, Value>))) Node<Key, Value>(key, new_item.second, NULL);
+    if(key < root->getKey()) {
+        node->setLeft(root->getLeft());
+        node->setRight(root);
+        root->setLeft(NULL);
+    }
+    else {
+        node->setRight(root->getRight());
+        node->setLeft(root);
+        root->setRight(NULL);
+    }
+    root->setParent(node);
+    if(node->getLeft() != NULL) {
+        node->getLeft()->setParent(node);
+    }
+    if(node->getRight() != NULL) {
+        node->getRight()->setParent(node);
+    }
+    this->root_ = node;
+    this->noteInsert(node);
+}
+
+/**
+* Splays the key to the root, then joins its two subtrees by splaying
+* the largest key of the left subtree, which leaves it without a right child.
+*/
+template<class Key, class Value>
+void SplayTree<Key, Value>::remove(const Key& key)
+{
+    Node<Key, Value>* node = splay(this->root_, key);
+    this->root_ = node;
+
+    if(node == NULL || node->getKey() < key || key < node->getKey()) {
+        return;
+    }
+    this->noteRemove(node);
+
+    Node<Key, Value>* left = node->getLeft();
+    Node<Key, Value>* right = node->getRight();
+    if(left == NULL) {
+        this->root_ = right;
+    }
+    else {
+        left->setParent(NULL);
+        left = splay(left, key);
+        left->setRight(right);
+        if(right != NULL) {
+            right->setParent(left);
+        }
+        this->root_ = left;
+    }
+    if(this->root_ != NULL) {
+        this->root_->setParent(NULL);
+    }
+    this->destroyNode(node);
+}
+
+/**
+* Removing a node from the middle of the tree splays that node itself to
+* the root through its parent links, so erase(iterator) needs no second
+* search, then joins its subtrees the way remove() does.
+*/
+template<class Key, class Value>
+void SplayTree<Key, Value>::removeNode(Node<Key, Value>* node)
+{
+    splayToRoot(node);
+    this->noteRemove(node);
+
+    Node<Key, Value>* left = node->getLeft();
+    Node<Key, Value>* right = node->getRight();
+    if(left == NULL) {
+        this->root_ = right;
+    }
+    else {
+        //the largest key on the left has no right child once splayed up
+        left->setParent(NULL);
+        this->root_ = left;
+        Node<Key, Value>* max = left;
+        while(max->getRight() != NULL) {
+            max = max->getRight();
+        }
+        splayToRoot(max);
+        max->setRight(right);
+        if(right != NULL) {
+            right->setParent(max);
+        }
+    }
+    if(this->root_ != NULL) {
+        this->root_->setParent(NULL);
+    }
+    this->destroyNode(node);
+}
+
+/**
+* Bottom-up splay: rotates node up its parent links (zig, zig-zig or
+* zig-zag at each step) until it is the root of the tree.
+*/
+template<class Key, class Value>
+void SplayTree<Key, Value>::splayToRoot(Node<Key, Value>* node)
+{
+    while(node->getParent() != NULL) {
+        Node<Key, Value>* parent = node->getParent();
+        Node<Key, Value>* grand = parent->getParent();
+        bool isLeft = parent->getLeft() == node;
+        if(grand == NULL) { //zig
+            if(isLeft) {
+                this->rotateRight(parent);
+            }
+            else {
+                this->rotateLeft(parent);
+            }
+        }
+        else if(isLeft == (grand->getLeft() == parent)) { //zig-zig
+            if(isLeft) {
+                this->rotateRight(grand);
+                this->rotateRight(parent);
+            }
+            else {
+                this->rotateLeft(grand);
+                this->rotateLeft(parent);
+            }
+        }
+        else { //zig-zag
+            if(isLeft) {
+                this->rotateRight(parent);
+                this->rotateLeft(grand);
+            }
+            else {
+                this->rotateLeft(parent);
+                this->rotateRight(grand);
+            }
+        }
+    }
+}
+
+/**
+* Top-down splay of the subtree rooted at t. Nodes passed on the way down
+* are hung off a left tree (keys smaller than key) and a right tree (keys
+* larger), which are reassembled under the final node. Returns the new
+* subtree root, whose parent is left for the caller to set.
+*/
+template<class Key, class Value>
+Node<Key, Value>* SplayTree<Key, Value>::splay(Node<Key, Value>* t, const Key& key)
+{
+    if(t == NULL) {
+        return NULL;
+    }
+
+    Node<Key, Value>* leftRoot = NULL;  //tree of smaller keys
+    Node<Key, Value>* leftMax = NULL;   //its largest node, where the next one hangs
+    Node<Key, Value>* rightRoot = NULL; //tree of larger keys
+    Node<Key, Value>* rightMin = NULL;  //its smallest node
+
+    while(true) {
+        if(key < t->getKey()) {
+            Node<Key, Value>* child = t->getLeft();
+            if(child == NULL) {
+                break;
+            }
+            if(key < child->getKey()) { //zig-zig: rotate right first
+                t->setLeft(child->getRight());
+                if(t->getLeft() != NULL) {
+                    t->getLeft()->setParent(t);
+                }
+                child->setRight(t);
+                t->setParent(child);
+                t = child;
+                if(t->getLeft() == NULL) {
+                    break;
+                }
+            }
+            //link t into the right tree
+            if(rightMin == NULL) {
+                rightRoot = t;
+            }
+            else {
+                rightMin->setLeft(t);
+                t->setParent(rightMin);
+            }
+            rightMin = t;
+            t = t->getLeft();
+        }
+        else if(t->getKey() < key) {
+            Node<Key, Value>* child = t->getRight();
+            if(child == NULL) {
+                break;
+            }
+            if(child->getKey() < key) { //zig-zig: rotate left first
+                t->setRight(child->getLeft());
+                if(t->getRight() != NULL) {
+                    t->getRight()->setParent(t);
+                }
+                child->setLeft(t);
+                t->setParent(child);
+                t = child;
+                if(t->getRight() == NULL) {
+                    break;
+                }
+            }
+            //link t into the left tree
+            if(leftMax == NULL) {
+                leftRoot = t;
+            }
+            else {
+                leftMax->setRight(t);
+                t->setParent(leftMax);
+            }
+            leftMax = t;
+            t = t->getRight();
+        }
+        else {
+            break;
+        }
+    }
+
+    //reassemble: t's subtrees go to the inner edges of the side trees
+    if(leftMax == NULL) {
+        leftRoot = t->getLeft();
+    }
+    else {
+        leftMax->setRight(t->getLeft());
+        if(t->getLeft() != NULL) {
+            t->getLeft()->setParent(leftMax);
+        }
+    }
+    if(rightMin == NULL) {
+        rightRoot = t->getRight();
+    }
+    else {
+        rightMin->setLeft(t->getRight());
+        if(t->getRight() != NULL) {
+            t->getRight()->setParent(rightMin);
+        }
+    }
+
+    t->setLeft(leftRoot);
+    t->setRight(rightRoot);
+    if(leftRoot != NULL) {
+        leftRoot->setParent(t);
+    }
+    if(rightRoot != NULL) {
+        rightRoot->setParent(t);
+    }
+    t->setParent(NULL);
+    return t;
+}
+
+
+#endif
@@ -0,0 +1,326 @@
+#ifndef STATICMAP_H
+#define STATICMAP_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <stdexcept>
+#include <utility>
+
+/**
+* A read-only ordered map of N items, built entirely by the compiler when
+* declared constexpr:
+*
+*     static constexpr auto codes = makeStaticMap<int, const char*>({
+*         {404, "Not Found"}, {200, "OK"}, {500, "Internal Server Error"} });
+*     static_assert(codes[200][0] == 'O', "");
+*
+* The items live in one array inside the object, so a constexpr instance
+* is laid out in read-only data with no constructor to run at startup and
+* no heap. The array holds the balanced search tree over the keys in
+* breadth-first (Eytzinger) order: the children of slot i are slots 2i
+* and 2i + 1. A lookup needs no pointers, and the top levels, which every
+* lookup reads, share the first cache lines.
+*
+* Keys and values must be literal types for a constexpr build, and keys
+* must be distinct. Building sorts with an insertion sort, which is
+* O(N^2) compile-time steps, so this is meant for tables of up to a few
+* thousand items.
+*/
+template <class Key, class Value, size_t N>
+class StaticMap
+{
+    static_assert(N > 0, "A StaticMap needs at least one item");
+
+public:
+    /**
+    * An iterator over the items in key order. Items cannot be changed.
+    */
+    class iterator
+    {
+    public:
+        constexpr iterator();
+
+        constexpr const std::pair<const Key, Value>& operator*() const;
+        constexpr const std::pair<const Key, Value>* operator->() const;
+
+        constexpr bool operator==(const iterator& rhs) const;
+        constexpr bool operator!=(const iterator& rhs) const;
+
+        constexpr iterator& operator++();
+
+    protected:
+        friend class StaticMap<Key, Value, N>;
+        constexpr iterator(const StaticMap<Key, Value, N>* map, size_t slot);
+
+        const StaticMap<Key, Value, N>* map_;
+        size_t slot_; //1-based Eytzinger slot, 0 at the end
+    };
+
+public:
+    constexpr StaticMap(const std::pair<Key, Value> (&items)[N]);
+
+    constexpr iterator begin() const;
+    constexpr iterator end() const;
+    constexpr iterator find(const Key& key) const;
+    constexpr iterator lowerBound(const Key& key) const;
+    constexpr const Value& operator[](const Key& key) const;
+    constexpr size_t size() const;
+    constexpr bool empty() const;
+
+protected:
+    /**
+    * Where each slot's item comes from in the constructor's argument.
+    */
+    struct Layout
+    {
+        size_t source[N];
+    };
+
+    template<size_t... I>
+    constexpr StaticMap(const std::pair<Key, Value> (&items)[N], const Layout& layout, std::index_sequence<I...>);
+
+    // Add helper functions here
+    static constexpr Layout layout(const std::pair<Key, Value> (&items)[N]);
+    static constexpr void place(Layout& layout, const size_t (&order)[N], size_t slot, size_t& next);
+    constexpr size_t lowerBoundSlot(const Key& key) const;
+
+protected:
+    std::pair<const Key, Value> items_[N]; //items_[i - 1] is slot i
+};
+
+/**
+* Builds a StaticMap from a braced list, deducing its size:
+* makeStaticMap<Key, Value>({{k1, v1}, {k2, v2}}).
+*/
+template <class Key, class Value, size_t N>
+constexpr StaticMap<Key, Value, N> makeStaticMap(const std::pair<Key, Value> (&items)[N])
+{
+    return StaticMap<Key, Value, N>(items);
+}
+
+/*
+  -------------------------------------------------
+  Begin implementations for the StaticMap::iterator class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value, size_t N>
+constexpr StaticMap<Key, Value, N>::iterator::iterator() :
+    map_(NULL), slot_(0)
+{
+
+}
+
+template<class Key, class Value, size_t N>
+constexpr StaticMap<Key, Value, N>::iterator::iterator(const StaticMap<Key, Value, N>* map, size_t slot) :
+    map_(map), slot_(slot)
+{
+
+}
+
+template<class Key, class Value, size_t N>
+constexpr const std::pair<const Key, Value>& StaticMap<Key, Value, N>::iterator::operator*() const
+{
+    return map_->items_[slot_ - 1];
+}
+
+template<class Key, class Value, size_t N>
+constexpr const std::pair<const Key, Value>* StaticMap<Key, Value, N>::iterator::operator->() const
+{
+    return &(map_->items_[slot_ - 1]);
+}
+
+template<class Key, class Value, size_t N>
+constexpr bool StaticMap<Key, Value, N>::iterator::operator==(const iterator& rhs) const
+{
+    return slot_ == rhs.slot_;
+}
+
+template<class Key, class Value, size_t N>
+constexpr bool StaticMap<Key, Value, N>::iterator::operator!=(const iterator& rhs) const
+{
+    return slot_ != rhs.slot_;
+}
+
+/**
+* The in-order successor in the implicit tree: the leftmost slot of the
+* right subtree, or else the parent of the first ancestor that is a left
+* child. Climbing past the root lands on slot 0, the end.
+*/
+template<class Key, class Value, size_t N>
+constexpr typename StaticMap<Key, Value, N>::iterator& StaticMap<Key, Value, N>::iterator::operator++()
+{
+    if(2 * slot_ + 1 <= N) {
+        slot_ = 2 * slot_ + 1;
+        while(2 * slot_ <= N) {
+            slot_ = 2 * slot_;
+        }
+    }
+    else {
+        while(slot_ & 1) { //climb while coming from the right
+            slot_ >>= 1;
+        }
+        slot_ >>= 1;
+    }
+    return *this;
+}
+
+/*
+  -------------------------------------------------
+  End implementations for the StaticMap::iterator class.
+  -------------------------------------------------
+*/
+
+/*
+  -------------------------------------------------
+  Begin implementations for the StaticMap class.
+  -------------------------------------------------
+*/
+
+/**
+* Throws std::invalid_argument on a repeated key, which in a constexpr
+* build is a compile error.
+*/
+template<class Key, class Value, size_t N>
+constexpr StaticMap<Key, Value, N>::StaticMap(const std::pair<Key, Value> (&items)[N]) :
+    StaticMap(items, layout(items), std::make_index_sequence<N>())
+{
+
+}
+
+template<class Key, class Value, size_t N>
+template<size_t... I>
+constexpr StaticMap<Key, Value, N>::StaticMap(const std::pair<Key, Value> (&items)[N], const Layout& layout,
+    std::index_sequence<I...>) :
+    items_{ std::pair<const Key, Value>(items[layout.source[I]].first, items[layout.source[I]].second)... }
+{
+
+}
+
+template<class Key, class Value, size_t N>
+constexpr typename StaticMap<Key, Value, N>::iterator StaticMap<Key, Value, N>::begin() const
+{
+    size_t slot = 1;
+    while(2 * slot <= N) {
+        slot = 2 * slot;
+    }
+    return iterator(this, slot);
+}
+
+template<class Key, class Value, size_t N>
+constexpr typename StaticMap<Key, Value, N>::iterator StaticMap<Key, Value, N>::end() const
+{
+    return iterator(this, 0);
+}
+
+template<class Key, class Value, size_t N>
+constexpr typename StaticMap<Key, Value, N>::iterator StaticMap<Key, Value, N>::find(const Key& key) const
+{
+    size_t slot = lowerBoundSlot(key);
+    if(slot == 0 || key < items_[slot - 1].first) {
+        return end();
+    }
+    return iterator(this, slot);
+}
+
+/**
+* The first item whose key is not less than key, or end().
+*/
+template<class Key, class Value, size_t N>
+constexpr typename StaticMap<Key, Value, N>::iterator StaticMap<Key, Value, N>::lowerBound(const Key& key) const
+{
+    return iterator(this, lowerBoundSlot(key));
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value, size_t N>
+constexpr const Value& StaticMap<Key, Value, N>::operator[](const Key& key) const
+{
+    size_t slot = lowerBoundSlot(key);
+    if(slot == 0 || key < items_[slot - 1].first) throw std::out_of_range("Invalid key");
+    return items_[slot - 1].second;
+}
+
+template<class Key, class Value, size_t N>
+constexpr size_t StaticMap<Key, Value, N>::size() const
+{
+    return N;
+}
+
+template<class Key, class Value, size_t N>
+constexpr bool StaticMap<Key, Value, N>::empty() const
+{
+    return false;
+}
+
+/**
+* Sorts the argument's indices by key, then hands them out to the slots
+* in in-order, so slot i holds the key a balanced tree would put there.
+*/
+template<class Key, class Value, size_t N>
+constexpr typename StaticMap<Key, Value, N>::Layout StaticMap<Key, Value, N>::layout(
+    const std::pair<Key, Value> (&items)[N])
+{
+    size_t order[N] = {};
+    for(size_t i = 0; i < N; ++i) {
+        size_t j = i;
+        while(j > 0 && items[i].first < items[order[j - 1]].first) {
+            order[j] = order[j - 1];
+            --j;
+        }
+        order[j] = i;
+    }
+    for(size_t i = 1; i < N; ++i) {
+        if(!(items[order[i - 1]].first < items[order[i]].first)) {
+            throw std::invalid_argument("Duplicate key");
+        }
+    }
+
+    Layout result = {};
+    size_t next = 0;
+    place(result, order, 1, next);
+    return result;
+}
+
+template<class Key, class Value, size_t N>
+constexpr void StaticMap<Key, Value, N>::place(Layout& layout, const size_t (&order)[N], size_t slot, size_t& next)
+{
+    if(slot > N) {
+        return;
+    }
+    place(layout, order, 2 * slot, next);
+    layout.source[slot - 1] = order[next++];
+    place(layout, order, 2 * slot + 1, next);
+}
+
+/**
+* Descends without branching on the comparison: every step goes to slot
+* 2i or 2i + 1. The bits of the final slot record the turns taken, and
+* dropping the trailing right turns plus one more gives the last slot at
+* which the search went left, which is the lower bound. 0 if there is none.
+*/
+template<class Key, class Value, size_t N>
+constexpr size_t StaticMap<Key, Value, N>::lowerBoundSlot(const Key& key) const
+{
+    size_t slot = 1;
+    while(slot <= N) {
+        slot = 2 * slot + (items_[slot - 1].first < key ? 1 : 0);
+    }
+    while(slot & 1) {
+        slot >>= 1;
+    }
+    return slot >> 1;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the StaticMap class.
+  -----------------------------------------------
+*/
+
+
+#endif
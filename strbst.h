@@ -0,0 +1,379 @@
+#ifndef STRBST_H
+#define STRBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <stdint.h>
+#include "avlbst.h"
+
+/**
+* An AVLNode for std::string keys that keeps 8 bytes of its key inline,
+* packed big-endian so that comparing two of them as integers orders them
+* the same way as comparing the bytes. Most comparisons on the search path
+* are decided by this word without touching the string's heap buffer.
+*/
+template <typename Value>
+class StringNode : public AVLNode<std::string, Value>
+{
+public:
+    // Constructor/destructor.
+    StringNode(const std::string& key, const Value& value, StringNode<Value>* parent);
+    virtual ~StringNode();
+
+    // Getter/setter for the packed key bytes.
+    uint64_t getPrefix() const;
+    void setPrefix(uint64_t prefix);
+
+    // Getters for parent, left, and right, returning StringNodes.
+    virtual StringNode<Value>* getParent() const override;
+    virtual StringNode<Value>* getLeft() const override;
+    virtual StringNode<Value>* getRight() const override;
+
+protected:
+    uint64_t prefix_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the StringNode class.
+  -------------------------------------------------
+*/
+
+/**
+* The prefix is filled in by the tree, which knows where in the key it starts.
+*/
+template<class Value>
+StringNode<Value>::StringNode(const std::string& key, const Value& value, StringNode<Value> *parent) :
+    AVLNode<std::string, Value>(key, value, parent), prefix_(0)
+{
+
+}
+
+/**
+* A destructor which does nothing.
+*/
+template<class Value>
+StringNode<Value>::~StringNode()
+{
+
+}
+
+/**
+* A getter for the packed key bytes.
+*/
+template<class Value>
+uint64_t StringNode<Value>::getPrefix() const
+{
+    return prefix_;
+}
+
+/**
+* A setter for the packed key bytes.
+*/
+template<class Value>
+void StringNode<Value>::setPrefix(uint64_t prefix)
+{
+    prefix_ = prefix;
+}
+
+/**
+* An overridden function for getting the parent since a static_cast is necessary to make sure
+* that our node is a StringNode.
+*/
+template<class Value>
+StringNode<Value> *StringNode<Value>::getParent() const
+{
+    return static_cast<StringNode<Value>*>(this->parent_);
+}
+
+/**
+* Overridden for the same reasons as above.
+*/
+template<class Value>
+StringNode<Value> *StringNode<Value>::getLeft() const
+{
+    return static_cast<StringNode<Value>*>(this->left_);
+}
+
+/**
+* Overridden for the same reasons as above.
+*/
+template<class Value>
+StringNode<Value> *StringNode<Value>::getRight() const
+{
+    return static_cast<StringNode<Value>*>(this->right_);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the StringNode class.
+  -----------------------------------------------
+*/
+
+
+/**
+* An AVLTree with std::string keys whose lookups mostly compare inline
+* prefixes instead of strings.
+*
+* URL- and path-like keys tend to share a long leading run ("https://www.",
+* "/home/"), which would make a prefix taken from byte 0 useless. So the
+* tree tracks the length of the prefix shared by every key it holds and
+* packs the 8 bytes right after it. A query that does not share that
+* prefix misses without descending at all. When an insert shortens the
+* shared prefix, every node's word is repacked. That costs O(n), but the
+* shared prefix only ever shrinks.
+*/
+template <class Value>
+class StringAVLTree : public AVLTree<std::string, Value>
+{
+public:
+    explicit StringAVLTree(std::pmr::memory_resource* resource = NULL);
+    virtual size_t splitAt(const std::string& key, AVLTree<std::string, Value>& upper) override;
+    virtual void concat(AVLTree<std::string, Value>& upper) override;
+protected:
+    virtual Node<std::string, Value>* internalFind(const std::string& key) const override;
+    virtual AVLNode<std::string, Value>* createNode(const std::string& key, const Value& value,
+        AVLNode<std::string, Value>* parent) override;
+    virtual AVLNode<std::string, Value>* adoptNode(AVLNode<std::string, Value>* node) override;
+    virtual size_t nodeBytes() const override;
+    virtual AVLNode<std::string, Value>* constructNode(void* where, const std::string& key, const Value& value,
+        AVLNode<std::string, Value>* parent) override;
+    virtual void bulkLoaded() override;
+
+    // Add helper functions here
+    StringNode<Value>* descend(const std::string& key) const;
+    void share(const std::string& key);
+    uint64_t pack(const std::string& key) const;
+    void repack(StringNode<Value>* node);
+
+protected:
+    size_t shared_; //length of the prefix every key in the tree starts with
+};
+
+template<class Value>
+StringAVLTree<Value>::StringAVLTree(std::pmr::memory_resource* resource) :
+    AVLTree<std::string, Value>(resource), shared_(0)
+{
+
+}
+
+/**
+* Every key upper gets shares this tree's prefix and was packed for it.
+*/
+template<class Value>
+size_t StringAVLTree<Value>::splitAt(const std::string& key, AVLTree<std::string, Value>& upper)
+{
+    size_t moved = AVLTree<std::string, Value>::splitAt(key, upper);
+    static_cast<StringAVLTree<Value>&>(upper).shared_ = shared_;
+    return moved;
+}
+
+/**
+* The two halves were packed for their own shared prefixes. Unless both
+* are the one the joined keys share, every node is repacked, which is
+* O(n) where the join alone is O(log n).
+*/
+template<class Value>
+void StringAVLTree<Value>::concat(AVLTree<std::string, Value>& upper)
+{
+    bool hadNodes = this->root_ != NULL;
+    size_t linked = this->size_ + this->deadCount_;
+    AVLTree<std::string, Value>::concat(upper);
+    if(this->size_ + this->deadCount_ == linked) {
+        return;
+    }
+
+    //the outermost keys, tombstones included, share what all keys share
+    Node<std::string, Value>* first = this->root_;
+    Node<std::string, Value>* last = this->root_;
+    while(first->getLeft() != NULL) {
+        first = first->getLeft();
+    }
+    while(last->getRight() != NULL) {
+        last = last->getRight();
+    }
+    const std::string& lo = first->getKey();
+    const std::string& hi = last->getKey();
+    size_t common = 0;
+    while(common < lo.size() && common < hi.size() && lo[common] == hi[common]) {
+        ++common;
+    }
+
+    size_t theirs = static_cast<StringAVLTree<Value>&>(upper).shared_;
+    size_t shared = std::min(common, theirs);
+    if(hadNodes) {
+        shared = std::min(shared, shared_);
+    }
+    bool stale = shared != theirs || (hadNodes && shared != shared_);
+    shared_ = shared;
+    if(stale) {
+        repack(static_cast<StringNode<Value>*>(this->root_));
+    }
+}
+
+/**
+* Consults the filter, if there is one, before descending.
+*/
+template<class Value>
+Node<std::string, Value>* StringAVLTree<Value>::internalFind(const std::string& key) const
+{
+    if(this->filterRejects(key)) {
+        return NULL;
+    }
+    StringNode<Value>* node = descend(key);
+    this->filterChecked(node);
+    return node;
+}
+
+/**
+* Compares packed words on the way down and only falls back to comparing
+* the strings themselves when two words are equal.
+*/
+template<class Value>
+StringNode<Value>* StringAVLTree<Value>::descend(const std::string& key) const
+{
+    StringNode<Value>* temp = static_cast<StringNode<Value>*>(this->root_);
+    if(temp == NULL) {
+        return NULL;
+    }
+
+    //every key starts with the shared prefix, so a key that doesn't is absent
+    if(key.size() < shared_ || std::memcmp(key.data(), temp->getKey().data(), shared_) != 0) {
+        return NULL;
+    }
+
+    uint64_t prefix = pack(key);
+    while(temp != NULL) {
+        if(prefix < temp->getPrefix()) {
+            temp = temp->getLeft();
+        }
+        else if(temp->getPrefix() < prefix) {
+            temp = temp->getRight();
+        }
+        else {
+            int diff = key.compare(temp->getKey());
+            if(diff == 0) {
+                return temp->isDeleted() ? NULL : temp;
+            }
+            temp = (diff < 0) ? temp->getLeft() : temp->getRight();
+        }
+    }
+    return NULL;
+}
+
+template<class Value>
+AVLNode<std::string, Value>* StringAVLTree<Value>::createNode(const std::string& key, const Value& value,
+    AVLNode<std::string, Value>* parent)
+{
+    share(key);
+    StringNode<Value>* node = new (this->allocateNode(sizeof(StringNode<Value>)))
+        StringNode<Value>(key, value, static_cast<StringNode<Value>*>(parent));
+    node->setPrefix(pack(key));
+    return node;
+}
+
+/**
+* The node's word was packed for the shared prefix of the tree it came
+* from, so it is packed again for this one.
+*/
+template<class Value>
+AVLNode<std::string, Value>* StringAVLTree<Value>::adoptNode(AVLNode<std::string, Value>* node)
+{
+    share(node->getKey());
+    static_cast<StringNode<Value>*>(node)->setPrefix(pack(node->getKey()));
+    return node;
+}
+
+template<class Value>
+size_t StringAVLTree<Value>::nodeBytes() const
+{
+    return sizeof(StringNode<Value>);
+}
+
+/**
+* Prefixes are left for bulkLoaded, which knows the shared prefix of the
+* whole set.
+*/
+template<class Value>
+AVLNode<std::string, Value>* StringAVLTree<Value>::constructNode(void* where, const std::string& key,
+    const Value& value, AVLNode<std::string, Value>* parent)
+{
+    return new (where) StringNode<Value>(key, value, static_cast<StringNode<Value>*>(parent));
+}
+
+/**
+* The keys are sorted, so what the smallest and largest share is what
+* all of them share.
+*/
+template<class Value>
+void StringAVLTree<Value>::bulkLoaded()
+{
+    if(this->root_ == NULL) {
+        return;
+    }
+    const std::string& first = this->min_->getKey();
+    const std::string& last = this->max_->getKey();
+    size_t common = 0;
+    while(common < first.size() && common < last.size() && first[common] == last[common]) {
+        ++common;
+    }
+    shared_ = common;
+    repack(static_cast<StringNode<Value>*>(this->root_));
+}
+
+/**
+* Shrinks the shared prefix to what a new key has in common with the
+* rest of the tree, repacking every node if it changed.
+*/
+template<class Value>
+void StringAVLTree<Value>::share(const std::string& key)
+{
+    StringNode<Value>* root = static_cast<StringNode<Value>*>(this->root_);
+    if(root == NULL) {
+        shared_ = key.size();
+        return;
+    }
+    const std::string& other = root->getKey();
+    size_t common = 0;
+    while(common < shared_ && common < key.size() && key[common] == other[common]) {
+        ++common;
+    }
+    if(common < shared_) {
+        shared_ = common;
+        repack(root);
+    }
+}
+
+/**
+* Packs the 8 bytes after the shared prefix big-endian, zero padded
+* past the end of the key.
+*/
+template<class Value>
+uint64_t StringAVLTree<Value>::pack(const std::string& key) const
+{
+    uint64_t result = 0;
+    for(size_t i = 0; i < 8; ++i) {
+        size_t pos = shared_ + i;
+        unsigned char byte = (pos < key.size()) ? static_cast<unsigned char>(key[pos]) : 0;
+        result = (result << 8) | byte;
+    }
+    return result;
+}
+
+template<class Value>
+void StringAVLTree<Value>::repack(StringNode<Value>* node)
+{
+    if(node == NULL) {
+        return;
+    }
+    node->setPrefix(pack(node->getKey()));
+    repack(node->getLeft());
+    repack(node->getRight());
+}
+
+
+#endif
@@ -0,0 +1,353 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+* A fixed set of worker threads, each with its own task deque. A worker
+* pushes and pops tasks at the back of its own deque, so nested forks run
+* depth first and stay cache warm. An idle worker steals from the front
+* of someone else's deque, which holds the oldest and so usually the
+* largest pieces of work.
+*
+* Work is submitted through a TaskGroup. On a worker, wait() runs queued
+* tasks instead of blocking, so a task may fork and wait on its own
+* children without tying up the worker. A thread outside the pool only
+* yields while it waits: helping there would let it nest stolen tasks on
+* its stack without bound.
+*/
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(size_t threads = std::thread::hardware_concurrency());
+    WorkStealingPool(const WorkStealingPool& other) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool& other) = delete;
+    ~WorkStealingPool();
+
+    size_t size() const;
+    static WorkStealingPool& shared();
+
+    /**
+    * A set of tasks that can be waited on together. The first exception
+    * thrown by any of them is rethrown from wait().
+    */
+    class TaskGroup
+    {
+    public:
+        TaskGroup(WorkStealingPool& pool);
+        TaskGroup(const TaskGroup& other) = delete;
+        TaskGroup& operator=(const TaskGroup& other) = delete;
+        ~TaskGroup();
+
+        void run(std::function<void()> task);
+        void wait();
+
+    protected:
+        friend class WorkStealingPool;
+        void finish(std::exception_ptr error);
+
+        WorkStealingPool& pool_;
+        std::atomic<size_t> pending_;
+        std::mutex errorLock_;
+        std::exception_ptr error_;
+    };
+
+protected:
+    struct Task
+    {
+        std::function<void()> fn;
+        TaskGroup* group;
+    };
+
+    struct Worker
+    {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    // Add helper functions here
+    void push(const Task& task);
+    bool runOne();
+    bool popOwn(Task& task);
+    bool steal(Task& task);
+    void run(Task& task);
+    void loop(size_t index);
+    static int& currentIndex();
+
+protected:
+    std::vector<Worker*> workers_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> queued_; //tasks sitting in any deque
+    std::atomic<size_t> next_; //round robin for pushes from outside the pool
+    std::atomic<bool> stop_;
+    std::mutex sleepLock_;
+    std::condition_variable wake_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the WorkStealingPool class.
+  -------------------------------------------------
+*/
+
+/**
+* Starts threads workers, or one if threads is 0.
+*/
+inline WorkStealingPool::WorkStealingPool(size_t threads) :
+    queued_(0), next_(0), stop_(false)
+{
+    if(threads == 0) {
+        threads = 1;
+    }
+    for(size_t i = 0; i < threads; ++i) {
+        workers_.push_back(new Worker);
+    }
+    for(size_t i = 0; i < threads; ++i) {
+        threads_.push_back(std::thread(&WorkStealingPool::loop, this, i));
+    }
+}
+
+inline WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepLock_);
+        stop_.store(true);
+    }
+    wake_.notify_all();
+    for(size_t i = 0; i < threads_.size(); ++i) {
+        threads_[i].join();
+    }
+    for(size_t i = 0; i < workers_.size(); ++i) {
+        delete workers_[i];
+    }
+}
+
+inline size_t WorkStealingPool::size() const
+{
+    return workers_.size();
+}
+
+/**
+* A process-wide pool with one worker per hardware thread, started on first use.
+*/
+inline WorkStealingPool& WorkStealingPool::shared()
+{
+    static WorkStealingPool pool;
+    return pool;
+}
+
+/**
+* The index of the worker running on this thread, or -1 off the pool.
+*/
+inline int& WorkStealingPool::currentIndex()
+{
+    static thread_local int index = -1;
+    return index;
+}
+
+/**
+* Queues on the calling worker's own deque, or round robin from outside.
+*/
+inline void WorkStealingPool::push(const Task& task)
+{
+    int self = currentIndex();
+    size_t index = (self >= 0) ? static_cast<size_t>(self) : next_.fetch_add(1) % workers_.size();
+    {
+        std::lock_guard<std::mutex> lock(workers_[index]->lock);
+        workers_[index]->tasks.push_back(task);
+    }
+    queued_.fetch_add(1);
+    {
+        //a worker about to sleep has checked queued_ under this lock
+        std::lock_guard<std::mutex> lock(sleepLock_);
+    }
+    wake_.notify_one();
+}
+
+inline bool WorkStealingPool::popOwn(Task& task)
+{
+    int self = currentIndex();
+    if(self < 0) {
+        return false;
+    }
+    Worker* worker = workers_[self];
+    std::lock_guard<std::mutex> lock(worker->lock);
+    if(worker->tasks.empty()) {
+        return false;
+    }
+    task = worker->tasks.back();
+    worker->tasks.pop_back();
+    return true;
+}
+
+/**
+* Takes the oldest task of another worker, trying each once.
+*/
+inline bool WorkStealingPool::steal(Task& task)
+{
+    int self = currentIndex();
+    size_t start = (self >= 0) ? static_cast<size_t>(self) + 1 : 0;
+    for(size_t n = 0; n < workers_.size(); ++n) {
+        Worker* victim = workers_[(start + n) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim->lock);
+        if(!victim->tasks.empty()) {
+            task = victim->tasks.front();
+            victim->tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void WorkStealingPool::run(Task& task)
+{
+    queued_.fetch_sub(1);
+    std::exception_ptr error;
+    try {
+        task.fn();
+    }
+    catch(...) {
+        error = std::current_exception();
+    }
+    task.group->finish(error);
+}
+
+/**
+* Runs one queued task, preferring this worker's own. Returns false if
+* there was nothing to run.
+*/
+inline bool WorkStealingPool::runOne()
+{
+    Task task;
+    if(popOwn(task) || steal(task)) {
+        run(task);
+        return true;
+    }
+    return false;
+}
+
+inline void WorkStealingPool::loop(size_t index)
+{
+    currentIndex() = static_cast<int>(index);
+    while(true) {
+        if(runOne()) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepLock_);
+        wake_.wait(lock, [this] { return stop_.load() || queued_.load() > 0; });
+        if(stop_.load()) {
+            return;
+        }
+    }
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the WorkStealingPool class.
+  -----------------------------------------------
+*/
+
+/*
+  -------------------------------------------------
+  Begin implementations for the TaskGroup class.
+  -------------------------------------------------
+*/
+
+inline WorkStealingPool::TaskGroup::TaskGroup(WorkStealingPool& pool) :
+    pool_(pool), pending_(0)
+{
+
+}
+
+/**
+* Waits for stragglers so no task outlives the group it reports to.
+*/
+inline WorkStealingPool::TaskGroup::~TaskGroup()
+{
+    while(pending_.load() > 0) {
+        if(currentIndex() < 0 || !pool_.runOne()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+inline void WorkStealingPool::TaskGroup::run(std::function<void()> task)
+{
+    pending_.fetch_add(1);
+    Task t;
+    t.fn = task;
+    t.group = this;
+    pool_.push(t);
+}
+
+/**
+* On a worker, runs queued tasks, this group's or any other, until every
+* task of this group has finished.
+*/
+inline void WorkStealingPool::TaskGroup::wait()
+{
+    while(pending_.load() > 0) {
+        if(currentIndex() < 0 || !pool_.runOne()) {
+            std::this_thread::yield();
+        }
+    }
+    std::lock_guard<std::mutex> lock(errorLock_);
+    if(error_) {
+        std::exception_ptr error = error_;
+        error_ = std::exception_ptr();
+        std::rethrow_exception(error);
+    }
+}
+
+inline void WorkStealingPool::TaskGroup::finish(std::exception_ptr error)
+{
+    if(error) {
+        std::lock_guard<std::mutex> lock(errorLock_);
+        if(!error_) {
+            error_ = error;
+        }
+    }
+    pending_.fetch_sub(1);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the TaskGroup class.
+  -----------------------------------------------
+*/
+
+/**
+* A stable merge sort of [first, last) on pool: halves are sorted as
+* separate tasks down to grain elements, then merged in place. The top
+* merges are sequential, so this scales until they dominate.
+*/
+template <typename RandomIt, typename Less>
+void parallelStableSort(RandomIt first, RandomIt last, Less less, WorkStealingPool& pool, size_t grain = 1 << 16)
+{
+    size_t count = static_cast<size_t>(last - first);
+    if(count <= grain) {
+        std::stable_sort(first, last, less);
+        return;
+    }
+    RandomIt middle = first + count / 2;
+    {
+        WorkStealingPool::TaskGroup group(pool);
+        group.run([first, middle, &less, &pool, grain] { parallelStableSort(first, middle, less, pool, grain); });
+        parallelStableSort(middle, last, less, pool, grain);
+        group.wait();
+    }
+    std::inplace_merge(first, middle, last, less);
+}
+
+
+#endif